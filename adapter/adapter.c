@@ -0,0 +1,287 @@
+#include "adapter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../proto/parrot_schema.h"
+
+#define ADAPTER_TIMER_TICK_MS 100
+
+static void adapter_begin(adapter *a, parrot_builder *builder, const uint32_t device, const uint16_t command,
+                          const uint16_t serial) {
+    uint16_t size = 0;
+    void *buf = udp_io_slot(&a->io, &size);
+    parrot_builder_begin(builder, buf, size, device, command, serial);
+}
+
+static void adapter_finish(adapter *a, parrot_builder *builder, const struct sockaddr_in *to) {
+    udp_io_commit(&a->io, parrot_builder_finish(builder, parrot_true), to);
+}
+
+static void adapter_send(adapter *a, const struct sockaddr_in *to, const uint32_t device, const uint16_t command,
+                         const uint16_t serial, const void *payload, const uint16_t len) {
+    parrot_builder builder;
+    adapter_begin(a, &builder, device, command, serial);
+    if (len != 0) {
+        parrot_builder_put_payload(&builder, payload, len);
+    }
+    adapter_finish(a, &builder, to);
+}
+
+static void adapter_send_status(adapter *a, const struct sockaddr_in *to, const uint32_t device,
+                                const uint16_t command, const uint16_t serial, const int64_t code,
+                                const char *message) {
+    // the register response has the same fields as the status notify, but both optional
+    const parrot_status_notify fields = {code, {message, -1}};
+    parrot_builder builder;
+    adapter_begin(a, &builder, device, command, serial);
+    parrot_schema_build(&parrot_schema_status_notify, &fields, PARROT_FIELD(1) | PARROT_FIELD(2), &builder);
+    adapter_finish(a, &builder, to);
+}
+
+static uint16_t adapter_next_serial(adapter *a) {
+    a->serial = (uint16_t) (a->serial % 0x7FFF + 1);
+    return a->serial;
+}
+
+static uint16_t session_next_serial(session_table *sessions, const uint32_t id) {
+    // per device, so a device sees consecutive serials (its jitter buffer orders audio by them)
+    sessions->serial[id] = (uint16_t) (sessions->serial[id] % 0x7FFF + 1);
+    return sessions->serial[id];
+}
+
+static void on_register_req(adapter *a, const parrot_message *msg, const struct sockaddr_in *from) {
+    const uint64_t now = event_loop_now_ms(a->loop);
+    int is_new = 0;
+    const uint32_t id = session_table_add(&a->sessions, msg->device, now, &is_new);
+    if (id == SESSION_NONE) {
+        a->stats.rejected++;
+        adapter_send_status(a, from, msg->device, 0x02, msg->serial, 1, "too many devices");
+        return;
+    }
+
+    a->stats.registered++;
+    a->sessions.addr[id] = *from;
+    if (is_new) {
+        timer_wheel_arm(&a->timers, &a->expiry[id], a->session_timeout_ms);
+    }
+
+    parrot_register_req fields;
+    uint64_t present = 0;
+    if (parrot_schema_decode(&parrot_schema_register_req, msg->payload_data, msg->payload_len, &fields, &present)
+        == kSchemaOk && (present & PARROT_FIELD(3)) && fields.ao_volume >= 0 && fields.ao_volume <= 100) {
+        a->sessions.volume[id] = (uint8_t) fields.ao_volume;
+    }
+
+    const parrot_register_res response = {0, {NULL, 0}};
+    parrot_builder builder;
+    adapter_begin(a, &builder, msg->device, 0x02, msg->serial);
+    parrot_schema_build(&parrot_schema_register_res, &response, PARROT_FIELD(1), &builder);
+    adapter_finish(a, &builder, from);
+
+    // status 3: success (online)
+    adapter_send_status(a, from, msg->device, 0x40, session_next_serial(&a->sessions, id), 3, "online");
+}
+
+static void on_keep_alive_req(adapter *a, const parrot_message *msg, const struct sockaddr_in *from) {
+    const uint32_t id = session_table_find(&a->sessions, msg->device);
+    if (id == SESSION_NONE) {
+        // status 0: offline, the device has to register again
+        a->stats.unknown++;
+        adapter_send_status(a, from, msg->device, 0x40, adapter_next_serial(a), 0, "not registered");
+        return;
+    }
+
+    session_table_touch(&a->sessions, id, event_loop_now_ms(a->loop));
+    a->sessions.addr[id] = *from;
+    adapter_send(a, from, msg->device, 0x04, msg->serial, NULL, 0);
+}
+
+static void on_unregister_req(adapter *a, const parrot_message *msg, const struct sockaddr_in *from) {
+    const uint32_t id = session_table_find(&a->sessions, msg->device);
+    if (id != SESSION_NONE) {
+        a->stats.unregistered++;
+        adapter_remove_session(a, id);
+    }
+
+    adapter_send(a, from, msg->device, 0x06, msg->serial, NULL, 0);
+}
+
+static void on_volume_report(adapter *a, const parrot_message *msg, const struct sockaddr_in *from) {
+    const uint32_t id = session_table_find(&a->sessions, msg->device);
+    if (id == SESSION_NONE) {
+        a->stats.unknown++;
+        return;
+    }
+
+    session_table_touch(&a->sessions, id, event_loop_now_ms(a->loop));
+    a->sessions.addr[id] = *from;
+
+    parrot_volume fields;
+    if (parrot_schema_decode(&parrot_schema_volume_report, msg->payload_data, msg->payload_len, &fields, NULL)
+        != kSchemaOk) {
+        a->stats.corrupted++;
+        return;
+    }
+
+    // audio device 1 is playback
+    if (fields.audio_dev_id == 1 && fields.volume >= 0 && fields.volume <= 100) {
+        a->sessions.volume[id] = (uint8_t) fields.volume;
+    }
+}
+
+static void adapter_on_datagram(void *user_data, const void *data, const uint16_t length,
+                                const struct sockaddr_in *from) {
+    adapter *a = user_data;
+
+    parrot_message msg;
+    if (parrot_message_parse(&msg, data, length) != kParrotOk || msg.device == 0) {
+        // client-to-server messages must contain the device code
+        a->stats.corrupted++;
+        return;
+    }
+
+    switch (msg.command) {
+        case 0x01: // Register request
+            on_register_req(a, &msg, from);
+            break;
+        case 0x03: // Keep-alive request
+            on_keep_alive_req(a, &msg, from);
+            break;
+        case 0x05: // Unregister request
+            on_unregister_req(a, &msg, from);
+            break;
+        case 0x45: // Volume report
+            on_volume_report(a, &msg, from);
+            break;
+        default:
+            break;
+    }
+}
+
+static void adapter_on_readable(event_loop *loop, const int fd, const uint32_t events, void *user_data) {
+    (void) loop;
+    (void) fd;
+    (void) events;
+
+    adapter *a = user_data;
+    udp_io_receive(&a->io, adapter_on_datagram, a);
+}
+
+static void adapter_on_wheel_timer(event_loop *loop, void *user_data) {
+    (void) loop;
+
+    adapter_expire(user_data);
+}
+
+static void adapter_on_session_timer(timer_wheel_node *node, void *user_data) {
+    adapter *a = user_data;
+    const uint32_t id = (uint32_t) (node - a->expiry);
+
+    const uint64_t now = event_loop_now_ms(a->loop);
+    const uint64_t deadline = a->sessions.last_seen_ms[id] + a->session_timeout_ms;
+    if (deadline <= now) {
+        a->stats.expired++;
+        session_table_remove(&a->sessions, id);
+        return;
+    }
+
+    // seen since the timer was armed
+    timer_wheel_arm(&a->timers, node, (uint32_t) (deadline - now));
+}
+
+static void adapter_on_iteration(event_loop *loop, void *user_data) {
+    (void) loop;
+
+    adapter *a = user_data;
+    udp_io_flush(&a->io);
+}
+
+int adapter_init(adapter *a, event_loop *loop, const int sock, const udp_io_backend backend,
+                 const uint32_t max_sessions, const uint32_t session_timeout_ms) {
+    memset(a, 0, sizeof(*a));
+    a->loop = loop;
+    a->session_timeout_ms = session_timeout_ms;
+    a->wheel_timer = -1;
+
+    a->expiry = calloc(max_sessions, sizeof(timer_wheel_node));
+    if (a->expiry == NULL || session_table_init(&a->sessions, max_sessions) != 0) {
+        fprintf(stderr, "Failed to allocate %u sessions\n", max_sessions);
+        free(a->expiry);
+        return -1;
+    }
+    timer_wheel_init(&a->timers, ADAPTER_TIMER_TICK_MS, event_loop_now_ms(loop), adapter_on_session_timer, a);
+
+    if (udp_io_init(&a->io, sock, backend) != 0) {
+        session_table_destroy(&a->sessions);
+        free(a->expiry);
+        return -1;
+    }
+
+    a->wheel_timer = event_loop_add_timer(loop, adapter_on_wheel_timer, a);
+    if (a->wheel_timer < 0
+        || event_loop_add_fd(loop, udp_io_fd(&a->io), EVENT_READ, adapter_on_readable, a) != 0) {
+        adapter_destroy(a);
+        return -1;
+    }
+
+    event_loop_set_timer(loop, a->wheel_timer, ADAPTER_TIMER_TICK_MS, ADAPTER_TIMER_TICK_MS);
+    event_loop_set_iteration_callback(loop, adapter_on_iteration, a);
+
+    // catch datagrams that arrived before the descriptor was watched (edge-triggered)
+    udp_io_receive(&a->io, adapter_on_datagram, a);
+    return 0;
+}
+
+void adapter_destroy(adapter *a) {
+    if (a->loop != NULL) {
+        event_loop_del_fd(a->loop, udp_io_fd(&a->io));
+        event_loop_del_timer(a->loop, a->wheel_timer);
+        event_loop_set_iteration_callback(a->loop, NULL, NULL);
+    }
+
+    udp_io_flush(&a->io);
+    udp_io_destroy(&a->io);
+    session_table_destroy(&a->sessions);
+    free(a->expiry);
+    a->expiry = NULL;
+    a->loop = NULL;
+    a->wheel_timer = -1;
+}
+
+void adapter_notify(adapter *a, const uint32_t id, const uint16_t command, const void *payload,
+                    const uint16_t len) {
+    if (id >= a->sessions.capacity || a->sessions.device[id] == 0) {
+        return;
+    }
+
+    a->stats.notifications++;
+    adapter_send(a, &a->sessions.addr[id], a->sessions.device[id], command, session_next_serial(&a->sessions, id),
+                 payload, len);
+}
+
+uint32_t adapter_broadcast(adapter *a, const uint16_t command, const void *payload, const uint16_t len) {
+    uint32_t count = 0;
+    for (uint32_t id = session_table_first(&a->sessions); id != SESSION_NONE;
+         id = session_table_next(&a->sessions, id)) {
+        adapter_notify(a, id, command, payload, len);
+        ++count;
+    }
+    return count;
+}
+
+uint32_t adapter_expire(adapter *a) {
+    const uint64_t expired = a->stats.expired;
+    timer_wheel_advance(&a->timers, event_loop_now_ms(a->loop));
+    return (uint32_t) (a->stats.expired - expired);
+}
+
+void adapter_remove_session(adapter *a, const uint32_t id) {
+    if (id >= a->sessions.capacity || a->sessions.device[id] == 0) {
+        return;
+    }
+
+    timer_wheel_cancel(&a->timers, &a->expiry[id]);
+    session_table_remove(&a->sessions, id);
+}
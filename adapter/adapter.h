@@ -0,0 +1,93 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#include "../net/event_loop.h"
+#include "../net/timer_wheel.h"
+#include "../net/udp_io.h"
+#include "session_table.h"
+
+typedef struct adapter_stats {
+    uint64_t corrupted;     // datagrams that failed to parse
+    uint64_t registered;    // register requests accepted
+    uint64_t rejected;      // register requests rejected (session table full)
+    uint64_t unregistered;  // sessions removed by unregister requests
+    uint64_t expired;       // sessions removed for silence
+    uint64_t unknown;       // requests from devices without a session
+    uint64_t notifications; // 0x40-0x44 notifications sent
+} adapter_stats;
+
+/**
+ * @brief Adapter side of the Simple Protocol: serves devices on one UDP socket.
+ *
+ * Devices register (0x01), keep alive (0x03), unregister (0x05) and report
+ * volume (0x45). Each device has a session holding its address, last-seen
+ * time and volume; sessions silent for longer than the timeout expire.
+ *
+ * Each session has an expiry timer on a timer wheel. Traffic only updates
+ * the last-seen time; when the timer fires it either removes the session
+ * or re-arms itself for the remaining time, so expiry costs O(1) per
+ * session and timeout period regardless of traffic.
+ */
+typedef struct adapter {
+    event_loop *loop;
+    udp_io io;
+    session_table sessions;
+    uint32_t session_timeout_ms;
+    timer_wheel timers;
+    timer_wheel_node *expiry;   // expiry timer of each session, indexed by session id
+    int wheel_timer;
+    uint16_t serial;        // serial of notifications to devices without a session
+    adapter_stats stats;
+} adapter;
+
+/**
+ * @brief Set up the adapter on a bound UDP socket and register it with an event loop
+ * @param a [out] adapter to be initialized
+ * @param loop [in] event loop driving the adapter
+ * @param sock [in] non-blocking UDP socket
+ * @param backend [in] preferred socket I/O backend
+ * @param max_sessions [in] maximum number of registered devices
+ * @param session_timeout_ms [in] sessions silent for longer than this expire
+ * @return 0 for success, -1 for failure
+ */
+int adapter_init(adapter *a, event_loop *loop, int sock, udp_io_backend backend, uint32_t max_sessions,
+                 uint32_t session_timeout_ms);
+
+/**
+ * @brief Unregister from the event loop and release resources. The socket is not closed.
+ */
+void adapter_destroy(adapter *a);
+
+/**
+ * @brief Send a notification to one session
+ * @param id [in] session id
+ * @param command [in] command (0x40 - 0x44)
+ * @param payload [in] payload data, NULL if none
+ * @param len [in] payload length
+ */
+void adapter_notify(adapter *a, uint32_t id, uint16_t command, const void *payload, uint16_t len);
+
+/**
+ * @brief Send a notification to every session
+ * @return Number of sessions notified
+ */
+uint32_t adapter_broadcast(adapter *a, uint16_t command, const void *payload, uint16_t len);
+
+/**
+ * @brief Remove sessions silent for longer than the session timeout
+ * @return Number of sessions expired
+ */
+uint32_t adapter_expire(adapter *a);
+
+/**
+ * @brief Remove a session and cancel its expiry timer
+ */
+void adapter_remove_session(adapter *a, uint32_t id);
+
+#if __cplusplus
+}
+#endif
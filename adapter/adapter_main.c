@@ -0,0 +1,428 @@
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../proto/c_string.h"
+#include "../proto/parrot_schema.h"
+#include "../net/event_loop.h"
+#include "../net/udp_io.h"
+#include "../net/udp_socket.h"
+#include "../net/worker.h"
+#include "adapter.h"
+
+#define ADAPTER_SOCKET_BUFFER (8 * 1024 * 1024)
+#define CONTROL_LINE_SIZE 1024
+#define ADAPTER_ARENA_SIZE 4096
+
+typedef struct line_reader {
+    char buf[CONTROL_LINE_SIZE];
+    size_t len;
+} line_reader;
+
+/**
+ * @brief One shard of the adapter: a SO_REUSEPORT socket, its event loop and the sessions it serves.
+ *
+ * The kernel hashes each datagram's 4-tuple onto one socket of the port, so
+ * a device keeps talking to the same worker and its session lives in that
+ * worker's table only. Control lines from stdin reach every worker through
+ * its own pipe; closing the pipe stops the worker.
+ */
+typedef struct adapter_worker {
+    worker thread;
+    int sock;
+    int control[2];         // read end watched by the worker, write end used by the main thread
+    event_loop loop;
+    adapter server;
+    line_reader control_lines;
+    c_arena arena;          // payloads of one control line
+} adapter_worker;
+
+static uint16_t port = 18029;
+static uint32_t max_sessions = 65536;
+static uint32_t session_timeout_s = 90;
+static udp_io_backend io_backend = kUdpIoBatch;
+static uint32_t worker_count = 1;
+static int cpus[WORKER_MAX_COUNT];
+static int cpu_count = 0;
+static int incoming_cpu = 0;
+
+static event_loop loop;
+static adapter_worker *workers = NULL;
+static line_reader stdin_lines;
+
+void on_interrupt(const int sig) {
+    (void)sig;
+
+    event_loop_stop(&loop);
+}
+
+static void usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --port PORT         UDP port to serve devices on (default 18029)\n");
+    printf("  --max-sessions N    maximum number of registered devices (default 65536)\n");
+    printf("  --timeout SECONDS   expire devices silent for this long (default 90)\n");
+    printf("  --io-uring          receive and send with io_uring (falls back to recvmmsg/sendmmsg)\n");
+    printf("  --workers N         serve on N threads with a SO_REUSEPORT socket each, 0 for one per CPU (default 1)\n");
+    printf("  --cpus LIST         pin worker i to the i-th CPU of LIST, e.g. 0,2,4-7\n");
+    printf("  --incoming-cpu      steer datagrams to the worker pinned to the receiving CPU (SO_INCOMING_CPU)\n");
+    printf("\n");
+    printf("Notifications are read from stdin, one per line. DEVICE is a device code or 'all':\n");
+    printf("  status DEVICE CODE MESSAGE   online status notify (0x40)\n");
+    printf("  audio DEVICE BYTES           one synthetic audio frame (0x41)\n");
+    printf("  play DEVICE                  start play notify (0x42)\n");
+    printf("  stop DEVICE                  stop play notify (0x43)\n");
+    printf("  volume DEVICE VALUE          volume notify (0x44)\n");
+    printf("  stats                        print session count and counters\n");
+}
+
+static void print_stats(const char *label, const uint32_t sessions, const adapter_stats *stats) {
+    printf("%ssessions=%u registered=%llu rejected=%llu unregistered=%llu expired=%llu unknown=%llu "
+           "corrupted=%llu notifications=%llu\n",
+           label, sessions,
+           (unsigned long long) stats->registered, (unsigned long long) stats->rejected,
+           (unsigned long long) stats->unregistered, (unsigned long long) stats->expired,
+           (unsigned long long) stats->unknown, (unsigned long long) stats->corrupted,
+           (unsigned long long) stats->notifications);
+}
+
+static void notify(adapter_worker *w, const char *target, const uint16_t command, const void *payload,
+                   const uint16_t len) {
+    if (strcmp(target, "all") == 0) {
+        const uint32_t n = adapter_broadcast(&w->server, command, payload, len);
+        printf("worker %u: notify 0x%02x sent to %u devices\n", w->thread.index, command, n);
+        return;
+    }
+
+    // every worker gets the line, only the one holding the session sends
+    const uint32_t device = (uint32_t) strtoul(target, NULL, 0);
+    const uint32_t id = session_table_find(&w->server.sessions, device);
+    if (id == SESSION_NONE) {
+        if (worker_count == 1) {
+            printf("device %s is not registered\n", target);
+        }
+        return;
+    }
+    adapter_notify(&w->server, id, command, payload, len);
+}
+
+static void handle_control_line(char *line, void *user_data) {
+    adapter_worker *w = user_data;
+
+    char command[16] = "";
+    char target[32] = "";
+    int offset = 0;
+    if (sscanf(line, "%15s %31s %n", command, target, &offset) < 1) {
+        return;
+    }
+    const char *args = offset > 0 ? line + offset : "";
+
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+    c_string_attach_arena(&payload, &w->arena);
+
+    if (strcmp(command, "stats") == 0) {
+        char label[32];
+        snprintf(label, sizeof(label), "worker %u: ", w->thread.index);
+        print_stats(label, w->server.sessions.count, &w->server.stats);
+    } else if (strcmp(command, "status") == 0) {
+        int code = 0;
+        int message_offset = 0;
+        sscanf(args, "%d %n", &code, &message_offset);
+        const parrot_status_notify fields = {code, {args + message_offset, -1}};
+        if (parrot_schema_encode(&parrot_schema_status_notify, &fields, PARROT_FIELD(1) | PARROT_FIELD(2), &payload)
+            != kSchemaOk) {
+            printf("status needs a code and a message\n");
+        } else {
+            notify(w, target, 0x40, payload.data, (uint16_t) payload.length);
+        }
+    } else if (strcmp(command, "audio") == 0) {
+        char frame[400];
+        int bytes = (int) strtol(args, NULL, 10);
+        if (bytes <= 0 || bytes > (int) sizeof(frame)) bytes = 80;
+        memset(frame, 0, sizeof(frame));
+        parrot_audio_notify fields;
+        fields.frame_count = 1;
+        fields.frames[0].data = frame;
+        fields.frames[0].length = (int16_t) bytes;
+        parrot_schema_encode(&parrot_schema_audio_notify, &fields, PARROT_FIELD(1), &payload);
+        notify(w, target, 0x41, payload.data, (uint16_t) payload.length);
+    } else if (strcmp(command, "play") == 0) {
+        notify(w, target, 0x42, NULL, 0);
+    } else if (strcmp(command, "stop") == 0) {
+        notify(w, target, 0x43, NULL, 0);
+    } else if (strcmp(command, "volume") == 0) {
+        // audio device 1 is playback
+        const parrot_volume fields = {1, strtol(args, NULL, 10)};
+        parrot_schema_encode(&parrot_schema_volume_notify, &fields, PARROT_FIELD(1) | PARROT_FIELD(2), &payload);
+        notify(w, target, 0x44, payload.data, (uint16_t) payload.length);
+    } else {
+        printf("unknown command: %s\n", command);
+    }
+
+    c_string_hard_clear(&payload);
+    c_arena_reset(&w->arena);
+}
+
+/**
+ * @brief Read what's available from fd and pass every complete line to on_line
+ * @return 0 at end of file, 1 otherwise
+ */
+static int read_lines(const int fd, line_reader *reader, void (*on_line)(char *line, void *user_data),
+                      void *user_data) {
+    while (1) {
+        const ssize_t n = read(fd, reader->buf + reader->len, sizeof(reader->buf) - 1 - reader->len);
+        if (n == 0) {
+            return 0;
+        }
+        if (n < 0) {
+            return 1;
+        }
+
+        reader->len += (size_t) n;
+        reader->buf[reader->len] = '\0';
+
+        char *line = reader->buf;
+        char *eol;
+        while ((eol = strchr(line, '\n')) != NULL) {
+            *eol = '\0';
+            on_line(line, user_data);
+            line = eol + 1;
+        }
+
+        reader->len = strlen(line);
+        memmove(reader->buf, line, reader->len);
+        if (reader->len == sizeof(reader->buf) - 1) {
+            // overlong line
+            reader->len = 0;
+        }
+    }
+}
+
+static void on_worker_control_readable(event_loop *l, const int fd, const uint32_t events, void *user_data) {
+    (void) events;
+
+    adapter_worker *w = user_data;
+    if (read_lines(fd, &w->control_lines, handle_control_line, w) == 0) {
+        // the main thread closed the pipe: shut down
+        event_loop_del_fd(l, fd);
+        event_loop_stop(l);
+    }
+}
+
+static void forward_control_line(char *line, void *user_data) {
+    (void) user_data;
+
+    char buf[CONTROL_LINE_SIZE + 1];
+    const int n = snprintf(buf, sizeof(buf), "%s\n", line);
+
+    // lines are shorter than PIPE_BUF, so each write is atomic
+    for (uint32_t i = 0; i < worker_count; i++) {
+        if (write(workers[i].control[1], buf, (size_t) n) != n) {
+            fprintf(stderr, "worker %u: control line dropped\n", i);
+        }
+    }
+}
+
+static void on_stdin_readable(event_loop *l, const int fd, const uint32_t events, void *user_data) {
+    (void) events;
+    (void) user_data;
+
+    if (read_lines(fd, &stdin_lines, forward_control_line, NULL) == 0) {
+        event_loop_del_fd(l, fd);
+    }
+}
+
+static void run_worker(void *arg) {
+    adapter_worker *w = arg;
+    event_loop_run(&w->loop);
+}
+
+static void close_worker_fds(adapter_worker *w) {
+    if (w->control[0] >= 0) close(w->control[0]);
+    if (w->control[1] >= 0) close(w->control[1]);
+    if (w->sock >= 0) close(w->sock);
+}
+
+static int setup_worker(adapter_worker *w, const uint32_t index) {
+    w->sock = -1;
+    w->control[0] = -1;
+    w->control[1] = -1;
+    w->thread.index = index;
+    w->thread.cpu = cpu_count > 0 ? cpus[index % (uint32_t) cpu_count] : -1;
+
+    w->sock = udp_socket_bind(port, ADAPTER_SOCKET_BUFFER, UDP_SOCKET_REUSEPORT);
+    if (w->sock < 0) {
+        fprintf(stderr, "Failed to create UDP socket\n");
+        return -1;
+    }
+    if (incoming_cpu && w->thread.cpu >= 0) {
+        udp_socket_set_incoming_cpu(w->sock, w->thread.cpu);
+    }
+
+    if (pipe2(w->control, O_NONBLOCK | O_CLOEXEC) != 0) {
+        perror("pipe2");
+        close_worker_fds(w);
+        return -1;
+    }
+
+    if (event_loop_init(&w->loop) != 0) {
+        fprintf(stderr, "Failed to create event loop\n");
+        close_worker_fds(w);
+        return -1;
+    }
+
+    if (adapter_init(&w->server, &w->loop, w->sock, io_backend, max_sessions, session_timeout_s * 1000) != 0) {
+        fprintf(stderr, "Failed to set up adapter\n");
+        event_loop_destroy(&w->loop);
+        close_worker_fds(w);
+        return -1;
+    }
+
+    if (event_loop_add_fd(&w->loop, w->control[0], EVENT_READ, on_worker_control_readable, w) != 0) {
+        fprintf(stderr, "Failed to set up event loop\n");
+        adapter_destroy(&w->server);
+        event_loop_destroy(&w->loop);
+        close_worker_fds(w);
+        return -1;
+    }
+
+    // without the arena, payloads over the inline size go to the heap
+    c_arena_init(&w->arena, ADAPTER_ARENA_SIZE);
+    return 0;
+}
+
+int main(const int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"port", required_argument, NULL, 'p'},
+        {"max-sessions", required_argument, NULL, 'm'},
+        {"timeout", required_argument, NULL, 't'},
+        {"io-uring", no_argument, NULL, 'u'},
+        {"workers", required_argument, NULL, 'w'},
+        {"cpus", required_argument, NULL, 'c'},
+        {"incoming-cpu", no_argument, NULL, 'i'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:m:t:uw:c:ih", options, NULL)) != -1) {
+        switch (opt) {
+            case 'p':
+                port = (uint16_t) strtol(optarg, NULL, 10);
+                break;
+            case 'm':
+                max_sessions = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                session_timeout_s = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'u':
+                io_backend = kUdpIoUring;
+                break;
+            case 'w':
+                worker_count = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                cpu_count = worker_parse_cpu_list(optarg, cpus, WORKER_MAX_COUNT);
+                if (cpu_count <= 0) {
+                    fprintf(stderr, "bad cpu list: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                incoming_cpu = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (worker_count == 0) worker_count = worker_cpu_count();
+    if (worker_count > WORKER_MAX_COUNT) worker_count = WORKER_MAX_COUNT;
+
+    if (event_loop_init(&loop) != 0) {
+        fprintf(stderr, "Failed to create event loop\n");
+        return 1;
+    }
+
+    // every worker can hold max_sessions: the hash doesn't split devices evenly
+    workers = calloc(worker_count, sizeof(adapter_worker));
+    if (workers == NULL) {
+        fprintf(stderr, "Failed to allocate workers\n");
+        return 1;
+    }
+
+    int exit_value = 0;
+    uint32_t ready = 0;
+    while (ready < worker_count) {
+        if (setup_worker(&workers[ready], ready) != 0) {
+            exit_value = 1;
+            break;
+        }
+        ++ready;
+    }
+
+    uint32_t started = 0;
+    while (exit_value == 0 && started < ready) {
+        adapter_worker *w = &workers[started];
+        if (worker_start(&w->thread, started, w->thread.cpu, run_worker, w) != 0) {
+            exit_value = 1;
+            break;
+        }
+        ++started;
+    }
+
+    if (exit_value == 0) {
+        if (udp_socket_set_nonblock(STDIN_FILENO) != 0
+            || event_loop_add_fd(&loop, STDIN_FILENO, EVENT_READ, on_stdin_readable, NULL) != 0) {
+            fprintf(stderr, "stdin control unavailable\n");
+        }
+
+        printf("adapter serving on udp port %u (%s), %u workers, up to %u devices per worker\n", port,
+               udp_io_backend_name(&workers[0].server.io), worker_count, max_sessions);
+
+        event_loop_run(&loop);
+    }
+
+    // closing the control pipes stops the workers
+    adapter_stats total;
+    memset(&total, 0, sizeof(total));
+    uint32_t sessions = 0;
+    for (uint32_t i = 0; i < ready; i++) {
+        adapter_worker *w = &workers[i];
+        close(w->control[1]);
+        w->control[1] = -1;
+        if (i < started) worker_join(&w->thread);
+
+        sessions += w->server.sessions.count;
+        total.corrupted += w->server.stats.corrupted;
+        total.registered += w->server.stats.registered;
+        total.rejected += w->server.stats.rejected;
+        total.unregistered += w->server.stats.unregistered;
+        total.expired += w->server.stats.expired;
+        total.unknown += w->server.stats.unknown;
+        total.notifications += w->server.stats.notifications;
+
+        adapter_destroy(&w->server);
+        event_loop_destroy(&w->loop);
+        close_worker_fds(w);
+        c_arena_destroy(&w->arena);
+    }
+
+    if (exit_value == 0) {
+        print_stats("", sessions, &total);
+    }
+    free(workers);
+    event_loop_destroy(&loop);
+    return exit_value;
+}
@@ -0,0 +1,182 @@
+#include "session_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t session_hash(const uint32_t device) {
+    // murmur3 finalizer, so the masked slot depends on the high bits of the code too
+    uint32_t h = device;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+int session_table_init(session_table *table, const uint32_t capacity) {
+    memset(table, 0, sizeof(*table));
+    if (capacity == 0 || capacity >= SESSION_NONE / 2) {
+        return -1;
+    }
+
+    // index load factor stays at or below 1/2
+    uint32_t index_size = 16;
+    while (index_size < capacity * 2) {
+        index_size <<= 1;
+    }
+
+    table->capacity = capacity;
+    table->index_mask = index_size - 1;
+    table->index_keys = calloc(index_size, sizeof(uint32_t));
+    table->index_ids = calloc(index_size, sizeof(uint32_t));
+    table->device = calloc(capacity, sizeof(uint32_t));
+    table->addr = calloc(capacity, sizeof(struct sockaddr_in));
+    table->last_seen_ms = calloc(capacity, sizeof(uint64_t));
+    table->volume = calloc(capacity, sizeof(uint8_t));
+    table->serial = calloc(capacity, sizeof(uint16_t));
+    table->prev = calloc(capacity, sizeof(uint32_t));
+    table->next = calloc(capacity, sizeof(uint32_t));
+    if (table->index_keys == NULL || table->index_ids == NULL || table->device == NULL || table->addr == NULL
+        || table->last_seen_ms == NULL || table->volume == NULL || table->serial == NULL || table->prev == NULL || table->next == NULL) {
+        session_table_destroy(table);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < capacity; i++) {
+        table->next[i] = i + 1 < capacity ? i + 1 : SESSION_NONE;
+    }
+    table->free_head = 0;
+    table->head = SESSION_NONE;
+    table->tail = SESSION_NONE;
+    return 0;
+}
+
+void session_table_destroy(session_table *table) {
+    free(table->index_keys);
+    free(table->index_ids);
+    free(table->device);
+    free(table->addr);
+    free(table->last_seen_ms);
+    free(table->volume);
+    free(table->serial);
+    free(table->prev);
+    free(table->next);
+    memset(table, 0, sizeof(*table));
+}
+
+uint32_t session_table_find(const session_table *table, const uint32_t device) {
+    if (device == 0) {
+        return SESSION_NONE;
+    }
+
+    uint32_t slot = session_hash(device) & table->index_mask;
+    while (1) {
+        const uint32_t key = table->index_keys[slot];
+        if (key == device) {
+            return table->index_ids[slot];
+        }
+        if (key == 0) {
+            return SESSION_NONE;
+        }
+        slot = (slot + 1) & table->index_mask;
+    }
+}
+
+static void session_list_unlink(session_table *table, const uint32_t id) {
+    const uint32_t prev = table->prev[id];
+    const uint32_t next = table->next[id];
+
+    if (prev != SESSION_NONE) table->next[prev] = next;
+    else table->head = next;
+
+    if (next != SESSION_NONE) table->prev[next] = prev;
+    else table->tail = prev;
+}
+
+static void session_list_append(session_table *table, const uint32_t id) {
+    table->prev[id] = table->tail;
+    table->next[id] = SESSION_NONE;
+    if (table->tail != SESSION_NONE) table->next[table->tail] = id;
+    else table->head = id;
+    table->tail = id;
+}
+
+uint32_t session_table_add(session_table *table, const uint32_t device, const uint64_t now_ms, int *is_new) {
+    if (is_new != NULL) {
+        *is_new = 0;
+    }
+    if (device == 0) {
+        return SESSION_NONE;
+    }
+
+    uint32_t slot = session_hash(device) & table->index_mask;
+    while (table->index_keys[slot] != 0) {
+        if (table->index_keys[slot] == device) {
+            const uint32_t id = table->index_ids[slot];
+            session_table_touch(table, id, now_ms);
+            return id;
+        }
+        slot = (slot + 1) & table->index_mask;
+    }
+
+    const uint32_t id = table->free_head;
+    if (id == SESSION_NONE) {
+        return SESSION_NONE;
+    }
+    table->free_head = table->next[id];
+
+    table->index_keys[slot] = device;
+    table->index_ids[slot] = id;
+
+    table->device[id] = device;
+    memset(&table->addr[id], 0, sizeof(table->addr[id]));
+    table->last_seen_ms[id] = now_ms;
+    table->volume[id] = 100;
+    table->serial[id] = 0;
+    session_list_append(table, id);
+    table->count++;
+    if (is_new != NULL) {
+        *is_new = 1;
+    }
+    return id;
+}
+
+static void session_index_remove(session_table *table, const uint32_t device) {
+    uint32_t slot = session_hash(device) & table->index_mask;
+    while (table->index_keys[slot] != device) {
+        if (table->index_keys[slot] == 0) {
+            return;
+        }
+        slot = (slot + 1) & table->index_mask;
+    }
+
+    // backward-shift deletion: move later entries of the probe run into the hole
+    uint32_t hole = slot;
+    uint32_t next = (hole + 1) & table->index_mask;
+    while (table->index_keys[next] != 0) {
+        const uint32_t home = session_hash(table->index_keys[next]) & table->index_mask;
+        // the entry may fill the hole unless its home lies cyclically in (hole, next]
+        if (((next - home) & table->index_mask) >= ((next - hole) & table->index_mask)) {
+            table->index_keys[hole] = table->index_keys[next];
+            table->index_ids[hole] = table->index_ids[next];
+            hole = next;
+        }
+        next = (next + 1) & table->index_mask;
+    }
+    table->index_keys[hole] = 0;
+}
+
+void session_table_remove(session_table *table, const uint32_t id) {
+    if (id >= table->capacity || table->device[id] == 0) {
+        return;
+    }
+
+    session_index_remove(table, table->device[id]);
+    session_list_unlink(table, id);
+
+    table->device[id] = 0;
+    table->next[id] = table->free_head;
+    table->free_head = id;
+    table->count--;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <netinet/in.h>
+
+#define SESSION_NONE 0xFFFFFFFFu
+
+/**
+ * @brief Device sessions of the adapter, stored as a struct of arrays.
+ *
+ * All storage is allocated once for a fixed maximum number of sessions;
+ * adding or removing a session never allocates. A session is identified by
+ * its index (id) into the arrays. Device codes map to ids through an
+ * open-addressing index with linear probing and backward-shift deletion.
+ *
+ * Active sessions are chained on a list for iteration; expiry is
+ * scheduled by the owner (see adapter.c).
+ */
+typedef struct session_table {
+    uint32_t capacity;
+    uint32_t count;
+
+    // device code -> session id
+    uint32_t index_mask;
+    uint32_t *index_keys;
+    uint32_t *index_ids;
+
+    // per-session fields, indexed by session id
+    uint32_t *device;               // 0 for unused ids
+    struct sockaddr_in *addr;
+    uint64_t *last_seen_ms;
+    uint8_t *volume;
+    uint16_t *serial;               // serial of the last notification sent
+
+    // active sessions in creation order; unused ids are chained on next[] from free_head
+    uint32_t *prev;
+    uint32_t *next;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t free_head;
+} session_table;
+
+/**
+ * @brief Allocate storage for at most capacity sessions
+ * @return 0 for success, -1 for failure
+ */
+int session_table_init(session_table *table, uint32_t capacity);
+
+/**
+ * @brief Release storage
+ */
+void session_table_destroy(session_table *table);
+
+/**
+ * @return Session id of a device, SESSION_NONE if it has no session
+ */
+uint32_t session_table_find(const session_table *table, uint32_t device);
+
+/**
+ * @brief Get the session of a device, creating it if needed, and mark it as seen now
+ * @param is_new [out] set to non-zero if the session was created, may be NULL
+ * @return Session id, SESSION_NONE if device is 0 or the table is full
+ */
+uint32_t session_table_add(session_table *table, uint32_t device, uint64_t now_ms, int *is_new);
+
+/**
+ * @brief Mark a session as seen now
+ */
+static inline void session_table_touch(session_table *table, const uint32_t id, const uint64_t now_ms) {
+    table->last_seen_ms[id] = now_ms;
+}
+
+/**
+ * @brief Remove a session
+ */
+void session_table_remove(session_table *table, uint32_t id);
+
+/**
+ * @return Id of the first active session, SESSION_NONE if the table is empty
+ */
+static inline uint32_t session_table_first(const session_table *table) {
+    return table->head;
+}
+
+/**
+ * @return Id of the active session after the given one, SESSION_NONE at the end
+ */
+static inline uint32_t session_table_next(const session_table *table, const uint32_t id) {
+    return table->next[id];
+}
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../net/udp_io.h"
+
+/**
+ * @brief Benchmark body: run the measured operation iterations times
+ * @return A value derived from the results, so that the work can't be optimized away
+ */
+typedef uint64_t (*bench_fn)(const void *ctx, uint64_t iterations);
+
+/**
+ * @brief How long and how often each microbenchmark runs
+ */
+typedef struct bench_options {
+    uint32_t time_ms;       // target duration of one repetition
+    uint32_t repeat;        // repetitions, the fastest is reported
+    const char *filter;     // run only benchmarks whose name contains this, NULL for all
+} bench_options;
+
+/**
+ * @brief Result of one microbenchmark
+ */
+typedef struct bench_result {
+    const char *name;       // operation, e.g. "message_parse"
+    const char *variant;    // input, e.g. "audio_6x80/checksum"
+    uint32_t bytes;         // input or output size of one operation, 0 if not meaningful
+    uint64_t iterations;    // operations of the fastest repetition
+    double ns_per_op;
+} bench_result;
+
+/**
+ * @brief Result of the loopback benchmark
+ */
+typedef struct bench_loopback_result {
+    const char *backend;
+    uint32_t devices;
+    uint32_t window;        // requests in flight
+    uint64_t sent;
+    uint64_t received;
+    double seconds;
+    double messages_per_s;
+    double p50_us;
+    double p99_us;
+    double max_us;
+} bench_loopback_result;
+
+/**
+ * @brief Loopback benchmark settings
+ */
+typedef struct bench_loopback_options {
+    uint64_t messages;
+    uint32_t devices;
+    uint32_t window;
+    udp_io_backend backend;
+} bench_loopback_options;
+
+/**
+ * @brief Writes results as one JSON document, so that runs can be compared by tools
+ */
+typedef struct bench_report {
+    FILE *out;
+    uint32_t count;
+} bench_report;
+
+/**
+ * @return Monotonic time in nanoseconds
+ */
+uint64_t bench_now_ns(void);
+
+/**
+ * @brief Time a benchmark body and report it
+ *
+ * The iteration count is calibrated so that one repetition takes about
+ * options->time_ms; the fastest of options->repeat repetitions is reported.
+ *
+ * @return 0 if the benchmark ran, 1 if the filter skipped it
+ */
+int bench_run(bench_report *report, const bench_options *options, const char *name, const char *variant,
+              uint32_t bytes, bench_fn fn, const void *ctx);
+
+/**
+ * @brief Run all microbenchmarks of the protocol core
+ * @return 0 for success, -1 for failure
+ */
+int bench_micro(bench_report *report, const bench_options *options);
+
+/**
+ * @brief Measure request/response round trips against an adapter on 127.0.0.1
+ * @return 0 for success, -1 for failure
+ */
+int bench_loopback(const bench_loopback_options *options, bench_loopback_result *result);
+
+void bench_report_begin(bench_report *report, FILE *out);
+void bench_report_micro(bench_report *report, const bench_result *result);
+void bench_report_loopback(bench_report *report, const bench_loopback_result *result);
+void bench_report_end(bench_report *report);
+
+#if __cplusplus
+}
+#endif
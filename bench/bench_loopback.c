@@ -0,0 +1,295 @@
+#include "bench.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "../adapter/adapter.h"
+#include "../net/event_loop.h"
+#include "../net/udp_socket.h"
+#include "../net/worker.h"
+#include "../proto/parrot_builder.h"
+#include "../proto/parrot_message.h"
+
+#define LOOPBACK_SOCKET_BUFFER (4 * 1024 * 1024)
+#define LOOPBACK_DEVICE_BASE 0x20000000u
+#define LOOPBACK_TIMEOUT_MS 1000
+#define LOOPBACK_SERIALS 0x8000
+
+/**
+ * @brief The adapter under test, on its own thread and event loop
+ */
+typedef struct loopback_server {
+    worker thread;
+    int sock;
+    int control[2];     // closing the write end stops the server
+    event_loop loop;
+    adapter server;
+} loopback_server;
+
+/**
+ * @brief The device side: one connected socket sending for all devices
+ */
+typedef struct loopback_client {
+    int sock;
+    udp_io io;
+    uint64_t sent_ns[LOOPBACK_SERIALS];   // send time by serial, 0 when not in flight
+    uint32_t *latency_ns;
+    uint64_t received;
+    uint64_t in_flight;
+    uint32_t registered;
+} loopback_client;
+
+static void on_server_control_readable(event_loop *loop, const int fd, const uint32_t events, void *user_data) {
+    (void) events;
+    (void) user_data;
+
+    char buf[16];
+    if (read(fd, buf, sizeof(buf)) <= 0) {
+        event_loop_del_fd(loop, fd);
+        event_loop_stop(loop);
+    }
+}
+
+static void run_server(void *arg) {
+    loopback_server *s = arg;
+    event_loop_run(&s->loop);
+}
+
+static void close_server_fds(loopback_server *s) {
+    if (s->control[0] >= 0) close(s->control[0]);
+    if (s->control[1] >= 0) close(s->control[1]);
+    if (s->sock >= 0) close(s->sock);
+}
+
+static int start_server(loopback_server *s, const uint32_t devices, const udp_io_backend backend,
+                        uint16_t *port) {
+    memset(s, 0, sizeof(*s));
+    s->control[0] = -1;
+    s->control[1] = -1;
+
+    s->sock = udp_socket_bind(0, LOOPBACK_SOCKET_BUFFER, 0);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (s->sock < 0 || getsockname(s->sock, (struct sockaddr *) &addr, &addr_len) != 0) {
+        fprintf(stderr, "Failed to create UDP socket\n");
+        close_server_fds(s);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+
+    if (pipe2(s->control, O_NONBLOCK | O_CLOEXEC) != 0) {
+        perror("pipe2");
+        close_server_fds(s);
+        return -1;
+    }
+
+    if (event_loop_init(&s->loop) != 0) {
+        fprintf(stderr, "Failed to create event loop\n");
+        close_server_fds(s);
+        return -1;
+    }
+
+    if (adapter_init(&s->server, &s->loop, s->sock, backend, devices, 60 * 1000) != 0
+        || event_loop_add_fd(&s->loop, s->control[0], EVENT_READ, on_server_control_readable, s) != 0) {
+        fprintf(stderr, "Failed to set up adapter\n");
+        event_loop_destroy(&s->loop);
+        close_server_fds(s);
+        return -1;
+    }
+
+    if (worker_start(&s->thread, 0, -1, run_server, s) != 0) {
+        adapter_destroy(&s->server);
+        event_loop_destroy(&s->loop);
+        close_server_fds(s);
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_server(loopback_server *s) {
+    close(s->control[1]);
+    s->control[1] = -1;
+    worker_join(&s->thread);
+
+    adapter_destroy(&s->server);
+    event_loop_destroy(&s->loop);
+    close_server_fds(s);
+}
+
+static void on_client_datagram(void *user_data, const void *data, const uint16_t length,
+                               const struct sockaddr_in *from) {
+    (void) from;
+
+    loopback_client *c = user_data;
+    parrot_message msg;
+    if (parrot_message_parse(&msg, data, length) != kParrotOk) {
+        return;
+    }
+
+    if (msg.command == 0x02) {
+        c->registered++;
+        return;
+    }
+    if (msg.command != 0x04 || msg.serial >= LOOPBACK_SERIALS || c->sent_ns[msg.serial] == 0) {
+        return;
+    }
+
+    const uint64_t elapsed = bench_now_ns() - c->sent_ns[msg.serial];
+    c->sent_ns[msg.serial] = 0;
+    c->latency_ns[c->received++] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t) elapsed;
+    c->in_flight--;
+}
+
+/**
+ * @brief Wait for datagrams and handle them
+ * @return 0 if any arrived, -1 on timeout or error
+ */
+static int client_receive(loopback_client *c, const int timeout_ms) {
+    struct pollfd pfd = {udp_io_fd(&c->io), POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return -1;
+    }
+    return udp_io_receive(&c->io, on_client_datagram, c) < 0 ? -1 : 0;
+}
+
+static void client_send(loopback_client *c, const uint32_t device, const uint16_t command, const uint16_t serial) {
+    uint16_t size = 0;
+    void *slot = udp_io_slot(&c->io, &size);
+    parrot_builder b;
+    parrot_builder_begin(&b, slot, size, device, command, serial);
+    udp_io_commit(&c->io, parrot_builder_finish(&b, parrot_true), NULL);
+}
+
+static int register_devices(loopback_client *c, const uint32_t devices) {
+    for (uint32_t i = 0; i < devices; i++) {
+        client_send(c, LOOPBACK_DEVICE_BASE + i, 0x01, (uint16_t) (i % 0x7FFF + 1));
+        if ((i & 31) == 31) {
+            udp_io_flush(&c->io);
+        }
+    }
+    udp_io_flush(&c->io);
+
+    while (c->registered < devices) {
+        if (client_receive(c, LOOPBACK_TIMEOUT_MS) != 0) {
+            fprintf(stderr, "loopback: %u of %u devices registered\n", c->registered, devices);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    const uint32_t x = *(const uint32_t *) a;
+    const uint32_t y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint32_t *sorted, const uint64_t count, const double p) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t i = (uint64_t) (p * (double) count);
+    if (i >= count) i = count - 1;
+    return sorted[i] / 1000.0;
+}
+
+/**
+ * @brief Keep window keep-alive requests in flight until all are answered, or one timeout passes without replies
+ */
+static void run_keep_alives(loopback_client *c, const bench_loopback_options *options, bench_loopback_result *result) {
+    uint64_t sent = 0;
+    uint16_t serial = 0;
+    const uint64_t start = bench_now_ns();
+
+    while (c->received < options->messages) {
+        while (c->in_flight < options->window && sent < options->messages) {
+            serial = (uint16_t) (serial % 0x7FFF + 1);
+            if (c->sent_ns[serial] != 0) {
+                // still unanswered from a full serial cycle ago: count it as lost
+                c->sent_ns[serial] = 0;
+                c->in_flight--;
+            }
+            client_send(c, LOOPBACK_DEVICE_BASE + (uint32_t) (sent % options->devices), 0x03, serial);
+            c->sent_ns[serial] = bench_now_ns();
+            c->in_flight++;
+            sent++;
+        }
+        udp_io_flush(&c->io);
+
+        if (client_receive(c, LOOPBACK_TIMEOUT_MS) != 0) {
+            fprintf(stderr, "loopback: no replies for %d ms, %llu of %llu answered\n", LOOPBACK_TIMEOUT_MS,
+                    (unsigned long long) c->received, (unsigned long long) sent);
+            break;
+        }
+    }
+
+    result->seconds = (double) (bench_now_ns() - start) / 1e9;
+    result->sent = sent;
+    result->received = c->received;
+}
+
+static int client_init(loopback_client *c, const uint16_t port, const bench_loopback_options *options) {
+    c->sock = udp_socket_bind(0, LOOPBACK_SOCKET_BUFFER, 0);
+    if (c->sock < 0 || udp_socket_connect(c->sock, "127.0.0.1", port) != 0) {
+        if (c->sock >= 0) close(c->sock);
+        return -1;
+    }
+
+    c->latency_ns = malloc(options->messages * sizeof(uint32_t));
+    if (c->latency_ns == NULL || udp_io_init(&c->io, c->sock, options->backend) != 0) {
+        free(c->latency_ns);
+        close(c->sock);
+        return -1;
+    }
+    return 0;
+}
+
+static void client_destroy(loopback_client *c) {
+    udp_io_destroy(&c->io);
+    close(c->sock);
+    free(c->latency_ns);
+}
+
+int bench_loopback(const bench_loopback_options *options, bench_loopback_result *result) {
+    memset(result, 0, sizeof(*result));
+    result->devices = options->devices;
+    result->window = options->window;
+
+    loopback_server server;
+    uint16_t port = 0;
+    if (start_server(&server, options->devices, options->backend, &port) != 0) {
+        return -1;
+    }
+    result->backend = udp_io_backend_name(&server.server.io);
+
+    // the serial table is too large for the stack
+    loopback_client *c = calloc(1, sizeof(loopback_client));
+    if (c == NULL || client_init(c, port, options) != 0) {
+        fprintf(stderr, "Failed to set up the loopback client\n");
+        free(c);
+        stop_server(&server);
+        return -1;
+    }
+
+    int ret = -1;
+    if (register_devices(c, options->devices) == 0) {
+        run_keep_alives(c, options, result);
+
+        qsort(c->latency_ns, c->received, sizeof(uint32_t), compare_u32);
+        result->messages_per_s = result->seconds > 0 ? (double) c->received / result->seconds : 0;
+        result->p50_us = percentile_us(c->latency_ns, c->received, 0.50);
+        result->p99_us = percentile_us(c->latency_ns, c->received, 0.99);
+        result->max_us = c->received != 0 ? c->latency_ns[c->received - 1] / 1000.0 : 0;
+        ret = result->received == result->sent ? 0 : -1;
+    }
+
+    client_destroy(c);
+    free(c);
+    stop_server(&server);
+    return ret;
+}
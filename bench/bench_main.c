@@ -0,0 +1,209 @@
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../proto/parrot_checksum.h"
+#include "bench.h"
+
+// results of benchmark bodies end up here, so that the compiler can't drop the work
+static volatile uint64_t bench_sink;
+
+static bench_options options = {100, 3, NULL};
+static bench_loopback_options loopback_options = {200000, 64, 32, kUdpIoBatch};
+static int run_micro = 1;
+static int run_loopback = 1;
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+int bench_run(bench_report *report, const bench_options *opts, const char *name, const char *variant,
+              const uint32_t bytes, const bench_fn fn, const void *ctx) {
+    char full_name[128];
+    snprintf(full_name, sizeof(full_name), "%s/%s", name, variant);
+    if (opts->filter != NULL && strstr(full_name, opts->filter) == NULL) {
+        return 1;
+    }
+
+    // calibrate: double the iterations until a run takes a tenth of the target, then scale
+    const uint64_t target_ns = (uint64_t) opts->time_ms * 1000000u;
+    uint64_t iterations = 16;
+    uint64_t elapsed = 0;
+    for (;;) {
+        const uint64_t start = bench_now_ns();
+        bench_sink += fn(ctx, iterations);
+        elapsed = bench_now_ns() - start;
+        if (elapsed >= target_ns / 10 || iterations >= (1ull << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+    if (elapsed > 0 && elapsed < target_ns) {
+        iterations = (uint64_t) ((double) iterations * (double) target_ns / (double) elapsed);
+    }
+
+    // the fastest repetition is the one least disturbed by the rest of the system
+    double best = 0;
+    for (uint32_t r = 0; r < opts->repeat || r == 0; r++) {
+        const uint64_t start = bench_now_ns();
+        bench_sink += fn(ctx, iterations);
+        const double ns_per_op = (double) (bench_now_ns() - start) / (double) iterations;
+        if (r == 0 || ns_per_op < best) {
+            best = ns_per_op;
+        }
+    }
+
+    const bench_result result = {name, variant, bytes, iterations, best};
+    bench_report_micro(report, &result);
+    return 0;
+}
+
+void bench_report_begin(bench_report *report, FILE *out) {
+    report->out = out;
+    report->count = 0;
+#ifdef __OPTIMIZE__
+    const char *optimized = "true";
+#else
+    const char *optimized = "false";
+#endif
+    // numbers of unoptimized builds aren't comparable with release builds
+    fprintf(out, "{\n  \"format\": 1,\n  \"optimized\": %s,\n  \"checksum\": \"%s\",\n  \"time_ms\": %u,\n"
+                 "  \"repeat\": %u,\n  \"results\": [",
+            optimized, parrot_checksum_name(), options.time_ms, options.repeat);
+}
+
+static void bench_report_next(bench_report *report) {
+    fprintf(report->out, report->count == 0 ? "\n    " : ",\n    ");
+    report->count++;
+}
+
+void bench_report_micro(bench_report *report, const bench_result *result) {
+    bench_report_next(report);
+    fprintf(report->out, "{\"kind\": \"micro\", \"name\": \"%s\", \"variant\": \"%s\", \"bytes\": %u, "
+                         "\"iterations\": %llu, \"ns_per_op\": %.2f",
+            result->name, result->variant, result->bytes, (unsigned long long) result->iterations,
+            result->ns_per_op);
+    if (result->bytes != 0 && result->ns_per_op > 0) {
+        fprintf(report->out, ", \"mb_per_s\": %.1f", (double) result->bytes * 1000.0 / result->ns_per_op);
+    }
+    fprintf(report->out, "}");
+    fflush(report->out);
+}
+
+void bench_report_loopback(bench_report *report, const bench_loopback_result *result) {
+    bench_report_next(report);
+    fprintf(report->out, "{\"kind\": \"loopback\", \"name\": \"keep_alive_round_trip\", \"backend\": \"%s\", "
+                         "\"devices\": %u, \"window\": %u, \"sent\": %llu, \"received\": %llu, "
+                         "\"seconds\": %.3f, \"messages_per_s\": %.0f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+                         "\"max_us\": %.1f}",
+            result->backend != NULL ? result->backend : "none", result->devices, result->window,
+            (unsigned long long) result->sent, (unsigned long long) result->received, result->seconds,
+            result->messages_per_s, result->p50_us, result->p99_us, result->max_us);
+    fflush(report->out);
+}
+
+void bench_report_end(bench_report *report) {
+    fprintf(report->out, "\n  ]\n}\n");
+    fflush(report->out);
+}
+
+static void usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Runs the protocol microbenchmarks and a loopback round-trip benchmark, results as JSON on stdout.\n");
+    printf("  --time-ms MS        target duration of one microbenchmark repetition (default 100)\n");
+    printf("  --repeat N          repetitions per microbenchmark, the fastest is reported (default 3)\n");
+    printf("  --filter TEXT       run only microbenchmarks whose name/variant contains TEXT\n");
+    printf("  --no-micro          skip the microbenchmarks\n");
+    printf("  --no-loopback       skip the loopback benchmark\n");
+    printf("  --messages N        loopback keep-alive requests to send (default 200000)\n");
+    printf("  --devices N         loopback devices registered with the adapter (default 64)\n");
+    printf("  --window N          loopback requests in flight (default 32)\n");
+    printf("  --io-uring          loopback over io_uring (falls back to recvmmsg/sendmmsg)\n");
+}
+
+int main(const int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"time-ms", required_argument, NULL, 't'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"filter", required_argument, NULL, 'f'},
+        {"no-micro", no_argument, NULL, 'M'},
+        {"no-loopback", no_argument, NULL, 'L'},
+        {"messages", required_argument, NULL, 'n'},
+        {"devices", required_argument, NULL, 'd'},
+        {"window", required_argument, NULL, 'w'},
+        {"io-uring", no_argument, NULL, 'u'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:r:f:MLn:d:w:uh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                options.time_ms = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                options.repeat = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                options.filter = optarg;
+                break;
+            case 'M':
+                run_micro = 0;
+                break;
+            case 'L':
+                run_loopback = 0;
+                break;
+            case 'n':
+                loopback_options.messages = strtoull(optarg, NULL, 10);
+                break;
+            case 'd':
+                loopback_options.devices = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                loopback_options.window = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'u':
+                loopback_options.backend = kUdpIoUring;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (options.time_ms == 0) options.time_ms = 1;
+    if (loopback_options.devices == 0) loopback_options.devices = 1;
+    if (loopback_options.window == 0) loopback_options.window = 1;
+    // serials identify requests in flight
+    if (loopback_options.window > 0x4000) loopback_options.window = 0x4000;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int exit_value = 0;
+    bench_report report;
+    bench_report_begin(&report, stdout);
+
+    if (run_micro && bench_micro(&report, &options) != 0) {
+        exit_value = 1;
+    }
+
+    if (run_loopback && loopback_options.messages != 0) {
+        bench_loopback_result result;
+        if (bench_loopback(&loopback_options, &result) != 0) {
+            exit_value = 1;
+        }
+        if (result.received != 0) {
+            bench_report_loopback(&report, &result);
+        }
+    }
+
+    bench_report_end(&report);
+    return exit_value;
+}
@@ -0,0 +1,394 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../proto/c_string.h"
+#include "../proto/parrot_checksum.h"
+#include "../proto/parrot_message.h"
+#include "../proto/parrot_payload.h"
+
+#define BENCH_FIELDS_MAX 8
+#define BENCH_BATCH_SIZE 32
+#define BENCH_PACKET_SIZE 600
+
+static const char opus_frame[80] =
+    "\x78\x9f\x0e\x33\x51\xc2\x8a\x17\x60\x05\xde\x4b\x92\x3c\xa8\x71\x0f\xe6\x29\x54"
+    "\x8d\xb0\x46\x1a\xf3\x6e\x05\x97\xcc\x38\x62\xa1\x5d\x0b\xe8\x74\x23\x9a\x4f\xd6"
+    "\x11\x80\x3e\xc5\x67\x2b\xf9\x5a\x06\xbd\x72\x48\x1f\xa4\xe3\x35\x8b\x50\xce\x19"
+    "\x66\xdb\x24\x7f\x03\xaa\x58\x91\x3d\xe0\x2c\x85\x47\xbe\x12\x69\xf4\x0d\x9e\x31";
+
+/**
+ * @brief One payload field: a string if data is set, otherwise an integer
+ */
+typedef struct bench_field {
+    uint8_t key;
+    const char *data;
+    int16_t length;
+    int64_t value;
+} bench_field;
+
+/**
+ * @brief A payload as the client and the adapter send it
+ */
+typedef struct bench_payload {
+    const char *name;
+    uint16_t command;
+    uint8_t field_count;
+    bench_field fields[BENCH_FIELDS_MAX];
+} bench_payload;
+
+#define BENCH_AUDIO_FRAME {1, opus_frame, sizeof(opus_frame), 0}
+
+// sizes seen on the wire: no payload, short requests and notifications, audio up to the 500-byte limit
+static const bench_payload corpus[] = {
+    {"keep_alive", 0x03, 0, {{0}}},
+    {"register", 0x01, 3, {{1, "192.168.10.27", -1, 0}, {2, "parrot-lite 2.3.1", -1, 0}, {3, NULL, 0, 72}}},
+    {"status", 0x40, 2, {{1, NULL, 0, 1}, {2, "online", -1, 0}}},
+    {"volume", 0x45, 2, {{1, NULL, 0, 1}, {2, NULL, 0, 80}}},
+    {"audio_1x80", 0x41, 1, {BENCH_AUDIO_FRAME}},
+    {"audio_6x80", 0x41, 6, {BENCH_AUDIO_FRAME, BENCH_AUDIO_FRAME, BENCH_AUDIO_FRAME,
+                             BENCH_AUDIO_FRAME, BENCH_AUDIO_FRAME, BENCH_AUDIO_FRAME}},
+};
+
+#define BENCH_CORPUS_SIZE (sizeof(corpus) / sizeof(corpus[0]))
+
+/**
+ * @brief A corpus entry encoded, with and without checksum
+ */
+typedef struct bench_packet {
+    const bench_payload *payload;
+    parrot_message msg;
+    uint8_t payload_bytes[BENCH_PACKET_SIZE];
+    uint8_t bytes[2][BENCH_PACKET_SIZE];    // indexed by add_checksum
+    uint16_t length[2];
+} bench_packet;
+
+typedef struct bench_message_ctx {
+    const bench_packet *packet;
+    parrot_bool checksum;
+} bench_message_ctx;
+
+typedef struct bench_batch_ctx {
+    const void *bufs[BENCH_BATCH_SIZE];
+    uint16_t lens[BENCH_BATCH_SIZE];
+    parrot_message_batch *batch;
+} bench_batch_ctx;
+
+typedef struct bench_string_ctx {
+    const char *data;
+    uint32_t length;
+    uint32_t repeat;
+    c_arena *arena;
+} bench_string_ctx;
+
+static void encode_payload(c_string *out, const bench_payload *payload) {
+    for (uint8_t i = 0; i < payload->field_count; i++) {
+        const bench_field *field = &payload->fields[i];
+        if (field->data != NULL) {
+            parrot_payload_put_string(out, field->key, field->data, field->length);
+        } else {
+            parrot_payload_put_integer(out, field->key, field->value);
+        }
+    }
+}
+
+static int build_packet(bench_packet *packet, const bench_payload *payload) {
+    memset(packet, 0, sizeof(*packet));
+    packet->payload = payload;
+
+    c_string encoded;
+    memset(&encoded, 0, sizeof(encoded));
+    encode_payload(&encoded, payload);
+    if (encoded.length > sizeof(packet->payload_bytes)) {
+        c_string_hard_clear(&encoded);
+        return -1;
+    }
+    if (encoded.length != 0) {
+        memcpy(packet->payload_bytes, encoded.data, encoded.length);
+    }
+
+    packet->msg.device = 0x1000002A;
+    packet->msg.command = payload->command;
+    packet->msg.serial = 300;
+    packet->msg.payload_len = (uint16_t) encoded.length;
+    packet->msg.payload_data = packet->payload_bytes;
+    c_string_hard_clear(&encoded);
+
+    for (int checksum = 0; checksum < 2; checksum++) {
+        if (parrot_message_serialize(packet->bytes[checksum], BENCH_PACKET_SIZE, &packet->msg,
+                                     (parrot_bool) checksum, &packet->length[checksum]) != kParrotOk) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t bench_message_parse(const void *ctx, const uint64_t iterations) {
+    const bench_message_ctx *c = ctx;
+    const uint8_t *bytes = c->packet->bytes[c->checksum];
+    const uint16_t length = c->packet->length[c->checksum];
+
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        parrot_message msg;
+        sink += parrot_message_parse(&msg, bytes, length) + msg.serial + msg.payload_len;
+    }
+    return sink;
+}
+
+static uint64_t bench_message_serialize(const void *ctx, const uint64_t iterations) {
+    const bench_message_ctx *c = ctx;
+    uint8_t buf[BENCH_PACKET_SIZE];
+
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint16_t length = 0;
+        parrot_message_serialize(buf, sizeof(buf), &c->packet->msg, c->checksum, &length);
+        sink += length + buf[length - 1];
+    }
+    return sink;
+}
+
+static uint64_t bench_message_parse_batch(const void *ctx, const uint64_t iterations) {
+    const bench_batch_ctx *c = ctx;
+
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += parrot_message_parse_batch(c->bufs, c->lens, BENCH_BATCH_SIZE, c->batch) + c->batch->serial[i & 7];
+    }
+    return sink;
+}
+
+static uint64_t bench_checksum(const void *ctx, const uint64_t iterations) {
+    const bench_packet *packet = ctx;
+
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += parrot_checksum(packet->bytes[0], packet->length[0]);
+    }
+    return sink;
+}
+
+static uint64_t bench_payload_put(const void *ctx, const uint64_t iterations) {
+    const bench_payload *payload = ctx;
+
+    c_string out;
+    memset(&out, 0, sizeof(out));
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        c_string_soft_clear(&out);
+        encode_payload(&out, payload);
+        sink += out.length;
+    }
+    c_string_hard_clear(&out);
+    return sink;
+}
+
+static uint64_t bench_payload_parse_entry(const void *ctx, const uint64_t iterations) {
+    const bench_packet *packet = ctx;
+
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        payload_parse parse;
+        payload_entry entry;
+        parrot_payload_parse_init(&parse, packet->payload_bytes, packet->msg.payload_len);
+        while (parrot_payload_parse_entry(&entry, &parse) != 0) {
+            sink += entry.key + (entry.is_string ? entry.value.str.length : (uint64_t) entry.value.i64);
+        }
+    }
+    return sink;
+}
+
+static void bench_visit_integer(void *user_data, const uint8_t field_index, const int64_t value) {
+    *(uint64_t *) user_data += field_index + (uint64_t) value;
+}
+
+static void bench_visit_string(void *user_data, const uint8_t field_index, const char *data, const int16_t length) {
+    (void) data;
+    *(uint64_t *) user_data += field_index + (uint64_t) length;
+}
+
+static uint64_t bench_payload_visit(const void *ctx, const uint64_t iterations) {
+    const bench_packet *packet = ctx;
+    const parrot_payload_callbacks callbacks = {bench_visit_integer, bench_visit_string, NULL};
+
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        parrot_payload_visit(packet->payload_bytes, packet->msg.payload_len, PARROT_ALL_FIELDS, &callbacks, &sink);
+    }
+    return sink;
+}
+
+static uint64_t bench_payload_index(const void *ctx, const uint64_t iterations) {
+    const bench_packet *packet = ctx;
+
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        payload_index index;
+        parrot_payload_index_build(&index, packet->payload_bytes, packet->msg.payload_len);
+        // then read every field, as a handler would
+        for (uint64_t present = index.present; present != 0; present &= present - 1) {
+            const uint8_t key = (uint8_t) __builtin_ctzll(present);
+            for (const payload_index_entry *entry = parrot_payload_index_find(&index, key); entry != NULL;
+                 entry = parrot_payload_index_next(&index, entry)) {
+                sink += key + (entry->is_string ? entry->value.string.length : (uint64_t) entry->value.integer);
+            }
+        }
+    }
+    return sink;
+}
+
+static uint64_t bench_c_string_assign(const void *ctx, const uint64_t iterations) {
+    const bench_string_ctx *c = ctx;
+
+    c_string str;
+    memset(&str, 0, sizeof(str));
+    c_string_attach_arena(&str, c->arena);
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        c_string_assign(&str, c->data, (int) c->length);
+        sink += str.length + (uint8_t) str.data[0];
+        if (c->arena != NULL) {
+            c_string_soft_clear(&str);
+            c_arena_reset(c->arena);
+        }
+    }
+    c_string_hard_clear(&str);
+    return sink;
+}
+
+static uint64_t bench_c_string_append(const void *ctx, const uint64_t iterations) {
+    const bench_string_ctx *c = ctx;
+
+    c_string str;
+    memset(&str, 0, sizeof(str));
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        c_string_soft_clear(&str);
+        for (uint32_t j = 0; j < c->repeat; j++) {
+            c_string_append(&str, c->data, (int) c->length);
+        }
+        sink += str.length;
+    }
+    c_string_hard_clear(&str);
+    return sink;
+}
+
+static uint64_t bench_c_string_append_raw(const void *ctx, const uint64_t iterations) {
+    const bench_string_ctx *c = ctx;
+
+    c_string str;
+    memset(&str, 0, sizeof(str));
+    uint64_t sink = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        c_string_soft_clear(&str);
+        for (uint32_t j = 0; j < c->repeat; j++) {
+            c_string_append_raw(&str, c->data, c->length);
+        }
+        sink += str.length;
+    }
+    c_string_hard_clear(&str);
+    return sink;
+}
+
+static void bench_messages(bench_report *report, const bench_options *options, const bench_packet *packets) {
+    static const char *const checksum_names[2] = {"plain", "checksum"};
+
+    for (uint32_t i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        for (int checksum = 0; checksum < 2; checksum++) {
+            char variant[64];
+            snprintf(variant, sizeof(variant), "%s/%s", packets[i].payload->name, checksum_names[checksum]);
+            const bench_message_ctx ctx = {&packets[i], (parrot_bool) checksum};
+            bench_run(report, options, "message_parse", variant, packets[i].length[checksum],
+                      bench_message_parse, &ctx);
+            bench_run(report, options, "message_serialize", variant, packets[i].length[checksum],
+                      bench_message_serialize, &ctx);
+        }
+    }
+
+    for (uint32_t i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        bench_run(report, options, "checksum", packets[i].payload->name, packets[i].length[0], bench_checksum,
+                  &packets[i]);
+    }
+}
+
+static int bench_batch(bench_report *report, const bench_options *options, const bench_packet *packets) {
+    parrot_message_batch batch;
+    if (parrot_message_batch_init(&batch, BENCH_BATCH_SIZE) != 0) {
+        fprintf(stderr, "Failed to allocate a parse batch\n");
+        return -1;
+    }
+
+    // a receive batch mixing the corpus, half with checksum
+    bench_batch_ctx ctx;
+    ctx.batch = &batch;
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < BENCH_BATCH_SIZE; i++) {
+        const bench_packet *packet = &packets[i % BENCH_CORPUS_SIZE];
+        const int checksum = (int) (i / BENCH_CORPUS_SIZE) & 1;
+        ctx.bufs[i] = packet->bytes[checksum];
+        ctx.lens[i] = packet->length[checksum];
+        bytes += ctx.lens[i];
+    }
+    bench_run(report, options, "message_parse_batch", "mix_32", bytes, bench_message_parse_batch, &ctx);
+
+    parrot_message_batch_destroy(&batch);
+    return 0;
+}
+
+static void bench_payloads(bench_report *report, const bench_options *options, const bench_packet *packets) {
+    for (uint32_t i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        if (packets[i].msg.payload_len == 0) {
+            continue;
+        }
+        bench_run(report, options, "payload_put", corpus[i].name, packets[i].msg.payload_len, bench_payload_put,
+                  &corpus[i]);
+        bench_run(report, options, "payload_parse_entry", corpus[i].name, packets[i].msg.payload_len,
+                  bench_payload_parse_entry, &packets[i]);
+        bench_run(report, options, "payload_visit", corpus[i].name, packets[i].msg.payload_len,
+                  bench_payload_visit, &packets[i]);
+        bench_run(report, options, "payload_index", corpus[i].name, packets[i].msg.payload_len,
+                  bench_payload_index, &packets[i]);
+    }
+}
+
+static void bench_strings(bench_report *report, const bench_options *options) {
+    static const char text[] = "Meeting room 4B, east wing; speaker array with two amplifiers "
+                               "and a ceiling microphone, installed in the spring.";
+
+    c_arena arena;
+    const int have_arena = c_arena_init(&arena, 4096) == 0;
+
+    const bench_string_ctx inline_ctx = {text, 24, 1, NULL};
+    const bench_string_ctx heap_ctx = {text, 100, 1, NULL};
+    const bench_string_ctx arena_ctx = {text, 100, 1, &arena};
+    const bench_string_ctx chunks_ctx = {text, 20, 24, NULL};
+
+    bench_run(report, options, "c_string_assign", "inline_24", 24, bench_c_string_assign, &inline_ctx);
+    bench_run(report, options, "c_string_assign", "heap_100", 100, bench_c_string_assign, &heap_ctx);
+    if (have_arena) {
+        bench_run(report, options, "c_string_assign", "arena_100", 100, bench_c_string_assign, &arena_ctx);
+        c_arena_destroy(&arena);
+    }
+    bench_run(report, options, "c_string_append", "24x20", 24 * 20, bench_c_string_append, &chunks_ctx);
+    bench_run(report, options, "c_string_append_raw", "24x20", 24 * 20, bench_c_string_append_raw, &chunks_ctx);
+}
+
+int bench_micro(bench_report *report, const bench_options *options) {
+    static bench_packet packets[BENCH_CORPUS_SIZE];
+    for (uint32_t i = 0; i < BENCH_CORPUS_SIZE; i++) {
+        if (build_packet(&packets[i], &corpus[i]) != 0) {
+            fprintf(stderr, "Failed to encode %s\n", corpus[i].name);
+            return -1;
+        }
+    }
+
+    bench_messages(report, options, packets);
+    if (bench_batch(report, options, packets) != 0) {
+        return -1;
+    }
+    bench_payloads(report, options, packets);
+    bench_strings(report, options);
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "audio_ring.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define AUDIO_RING_MIN_CAPACITY 4096
+
+static long futex(uint32_t *word, const int op, const uint32_t value, const struct timespec *timeout) {
+    // not FUTEX_PRIVATE_FLAG: the word is shared between processes
+    return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+static uint32_t record_size(const uint16_t length) {
+    return (AUDIO_RING_RECORD_HEADER_SIZE + (uint32_t) length + 7u) & ~7u;
+}
+
+static int audio_ring_map(audio_ring *ring, const int fd, const size_t size) {
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    ring->header = addr;
+    ring->data = (uint8_t *) addr + AUDIO_RING_HEADER_SIZE;
+    return 0;
+}
+
+int audio_ring_create(audio_ring *ring, const char *name, const uint32_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    if (capacity > 0x40000000u || strlen(name) >= sizeof(ring->name)) {
+        return -1;
+    }
+
+    uint32_t size = AUDIO_RING_MIN_CAPACITY;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    const int fd = shm_open(name, O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0660);
+    if (fd < 0) {
+        perror(name);
+        return -1;
+    }
+
+    const size_t total = AUDIO_RING_HEADER_SIZE + (size_t) size;
+    if (ftruncate(fd, (off_t) total) != 0 || audio_ring_map(ring, fd, total) != 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    close(fd);
+
+    audio_ring_header *h = ring->header;
+    h->version = AUDIO_RING_VERSION;
+    h->header_size = AUDIO_RING_HEADER_SIZE;
+    h->capacity = size;
+    // magic last: a consumer that sees it sees an initialized header
+    __atomic_store_n(&h->magic, AUDIO_RING_MAGIC, __ATOMIC_RELEASE);
+
+    ring->capacity = size;
+    ring->mask = size - 1;
+    ring->is_producer = 1;
+    strcpy(ring->name, name);
+    return 0;
+}
+
+int audio_ring_open(audio_ring *ring, const char *name) {
+    memset(ring, 0, sizeof(*ring));
+
+    const int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        perror(name);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < AUDIO_RING_HEADER_SIZE + AUDIO_RING_MIN_CAPACITY
+        || audio_ring_map(ring, fd, (size_t) st.st_size) != 0) {
+        fprintf(stderr, "%s: not an audio ring\n", name);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    const audio_ring_header *h = ring->header;
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != AUDIO_RING_MAGIC || h->version != AUDIO_RING_VERSION
+        || h->header_size != AUDIO_RING_HEADER_SIZE
+        || (uint64_t) AUDIO_RING_HEADER_SIZE + h->capacity > (uint64_t) st.st_size
+        || (h->capacity & (h->capacity - 1)) != 0) {
+        fprintf(stderr, "%s: bad audio ring header\n", name);
+        munmap(ring->header, (size_t) st.st_size);
+        ring->header = NULL;
+        return -1;
+    }
+
+    ring->data = (uint8_t *) ring->header + h->header_size;
+    ring->capacity = h->capacity;
+    ring->mask = h->capacity - 1;
+    ring->position = __atomic_load_n(&h->read_pos, __ATOMIC_ACQUIRE);
+    ring->limit = ring->position;
+    return 0;
+}
+
+void audio_ring_close(audio_ring *ring) {
+    if (ring->header == NULL) {
+        return;
+    }
+
+    munmap(ring->header, AUDIO_RING_HEADER_SIZE + (size_t) ring->capacity);
+    if (ring->is_producer) {
+        shm_unlink(ring->name);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+void *audio_ring_reserve(audio_ring *ring, const uint8_t type, const uint32_t device, const uint16_t serial,
+                         const uint16_t length) {
+    audio_ring_header *h = ring->header;
+    const uint32_t size = record_size(length);
+    uint64_t position = ring->position;
+    const uint32_t offset = (uint32_t) position & ring->mask;
+    const uint32_t room = ring->capacity - offset;
+
+    // a record that doesn't fit before the end of the data area starts over at offset 0
+    const uint64_t needed = size <= room ? size : (uint64_t) room + size;
+    if (position + needed - ring->limit > ring->capacity) {
+        ring->limit = __atomic_load_n(&h->read_pos, __ATOMIC_ACQUIRE);
+        if (position + needed - ring->limit > ring->capacity) {
+            __atomic_store_n(&h->dropped, h->dropped + 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+    }
+
+    if (size > room) {
+        // room may be 8 bytes only: a pad record has its size and type, and nothing beyond room
+        audio_ring_record *pad = (audio_ring_record *) (ring->data + offset);
+        memset(pad, 0, room < AUDIO_RING_RECORD_HEADER_SIZE ? room : AUDIO_RING_RECORD_HEADER_SIZE);
+        pad->size = room;
+        pad->type = AUDIO_RING_PAD;
+        position += room;
+    }
+
+    audio_ring_record *record = (audio_ring_record *) (ring->data + ((uint32_t) position & ring->mask));
+    record->size = size;
+    record->type = type;
+    record->reserved0 = 0;
+    record->serial = serial;
+    record->device = device;
+    record->length = length;
+    record->reserved1 = 0;
+
+    ring->pending = position + size;
+    return record->payload;
+}
+
+void audio_ring_publish(audio_ring *ring) {
+    audio_ring_header *h = ring->header;
+    ring->position = ring->pending;
+    __atomic_store_n(&h->write_pos, ring->position, __ATOMIC_RELEASE);
+
+    // pairs with the fence in audio_ring_wait(): either the consumer sees the record or we see it waiting
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&h->waiting, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&h->waiting, 0, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&h->wake_seq, 1, __ATOMIC_SEQ_CST);
+        futex(&h->wake_seq, FUTEX_WAKE, INT_MAX, NULL);
+    }
+}
+
+int audio_ring_write(audio_ring *ring, const uint8_t type, const uint32_t device, const uint16_t serial,
+                     const void *payload, const uint16_t length) {
+    if (record_size(length) > ring->capacity) {
+        __atomic_store_n(&ring->header->dropped, ring->header->dropped + 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    void *dst = audio_ring_reserve(ring, type, device, serial, length);
+    if (dst == NULL) {
+        return -1;
+    }
+
+    if (length != 0) {
+        memcpy(dst, payload, length);
+    }
+    audio_ring_publish(ring);
+    return 0;
+}
+
+const audio_ring_record *audio_ring_peek(audio_ring *ring) {
+    while (1) {
+        if (ring->position == ring->limit) {
+            ring->limit = __atomic_load_n(&ring->header->write_pos, __ATOMIC_ACQUIRE);
+            if (ring->position == ring->limit) {
+                return NULL;
+            }
+        }
+
+        const audio_ring_record *record = (const audio_ring_record *) (ring->data + ((uint32_t) ring->position
+                                                                                      & ring->mask));
+        if (record->type != AUDIO_RING_PAD) {
+            return record;
+        }
+        audio_ring_consume(ring, record);
+    }
+}
+
+void audio_ring_consume(audio_ring *ring, const audio_ring_record *record) {
+    ring->position += record->size;
+    __atomic_store_n(&ring->header->read_pos, ring->position, __ATOMIC_RELEASE);
+}
+
+int audio_ring_wait(audio_ring *ring, const int timeout_ms) {
+    audio_ring_header *h = ring->header;
+    const uint32_t seq = __atomic_load_n(&h->wake_seq, __ATOMIC_ACQUIRE);
+
+    __atomic_store_n(&h->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&h->write_pos, __ATOMIC_ACQUIRE) != ring->position) {
+        __atomic_store_n(&h->waiting, 0, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long) (timeout_ms % 1000) * 1000000;
+    // returns at once if the producer bumped wake_seq since we read it
+    futex(&h->wake_seq, FUTEX_WAIT, seq, timeout_ms >= 0 ? &timeout : NULL);
+
+    __atomic_store_n(&h->waiting, 0, __ATOMIC_RELAXED);
+    return __atomic_load_n(&h->write_pos, __ATOMIC_ACQUIRE) != ring->position;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+/**
+ * Shared-memory audio ring
+ * ========================
+ *
+ * The client publishes played-out audio frames and start/stop events into a
+ * POSIX shared memory object (shm_open name, e.g. "/parrot-audio"). A player
+ * process maps the object and reads records in place: no copy and no system
+ * call per record. It sleeps on a futex word when the ring is empty.
+ *
+ * There is one producer (the client) and one consumer. All integers are
+ * native-endian, and positions are byte counts that only ever grow. The
+ * ring never blocks the producer: a record that doesn't fit is dropped and
+ * counted in the header.
+ *
+ * Header (AUDIO_RING_HEADER_SIZE bytes, fields on separate cache lines):
+ *
+ * | Offset | Type     | Field       | Written by | Remarks                                          |
+ * |--------|----------|-------------|------------|--------------------------------------------------|
+ * | 0      | uint32   | magic       | producer   | AUDIO_RING_MAGIC                                 |
+ * | 4      | uint32   | version     | producer   | AUDIO_RING_VERSION                               |
+ * | 8      | uint32   | header_size | producer   | offset of the data area                          |
+ * | 12     | uint32   | capacity    | producer   | size of the data area, a power of two            |
+ * | 64     | uint64   | write_pos   | producer   | bytes published; release-stored after a record   |
+ * | 72     | uint32   | wake_seq    | producer   | futex word, bumped when waking the consumer      |
+ * | 80     | uint64   | dropped     | producer   | records dropped because the ring was full        |
+ * | 128    | uint64   | read_pos    | consumer   | bytes consumed; release-stored after a record    |
+ * | 136    | uint32   | waiting     | consumer   | 1 while the consumer is (about to be) asleep     |
+ *
+ * Data area: records laid out back to back at (position % capacity). A
+ * record never wraps; when the space left before the end of the data area
+ * is too small, the producer fills it with an AUDIO_RING_PAD record and
+ * continues at offset 0. Records are 8-byte aligned. A pad record may be
+ * only 8 bytes long: then it has just its size and type (offsets 0-7), and
+ * the consumer must read nothing else of it.
+ *
+ * | Offset | Type     | Field   | Remarks                                               |
+ * |--------|----------|---------|-------------------------------------------------------|
+ * | 0      | uint32   | size    | record size including this header, a multiple of 8    |
+ * | 4      | uint8    | type    | AUDIO_RING_FRAME / _LOST / _START / _STOP / _PAD      |
+ * | 5      | uint8    | -       | reserved, 0                                           |
+ * | 6      | uint16   | serial  | message serial                                        |
+ * | 8      | uint32   | device  | device code                                           |
+ * | 12     | uint16   | length  | payload length (Opus frame for AUDIO_RING_FRAME)      |
+ * | 14     | uint16   | -       | reserved, 0                                           |
+ * | 16     | uint8[]  | payload | length bytes                                          |
+ *
+ * Waiting: the consumer reads wake_seq, stores waiting = 1, and re-checks
+ * write_pos. If nothing is new, it calls FUTEX_WAIT on wake_seq with the
+ * value it read. After publishing, the producer checks waiting; if it is
+ * set, the producer clears it, increments wake_seq and calls FUTEX_WAKE.
+ * Both sides order these steps with sequentially consistent fences. See
+ * audio_ring_wait().
+ */
+
+#define AUDIO_RING_MAGIC 0x474E5250u    // "PRNG"
+#define AUDIO_RING_VERSION 1
+#define AUDIO_RING_HEADER_SIZE 192
+#define AUDIO_RING_RECORD_HEADER_SIZE 16
+
+#define AUDIO_RING_FRAME 0x41   // Opus frame (audio notify)
+#define AUDIO_RING_START 0x42   // start play notify
+#define AUDIO_RING_STOP  0x43   // stop play notify
+#define AUDIO_RING_LOST  0x01   // frame missing at playout time, to be concealed
+#define AUDIO_RING_PAD   0xFF   // filler up to the end of the data area, skipped
+
+typedef struct audio_ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t capacity;
+    uint8_t pad0[48];
+
+    uint64_t write_pos;
+    uint32_t wake_seq;
+    uint32_t reserved0;
+    uint64_t dropped;
+    uint8_t pad1[40];
+
+    uint64_t read_pos;
+    uint32_t waiting;
+    uint8_t pad2[52];
+} audio_ring_header;
+
+typedef struct audio_ring_record {
+    uint32_t size;
+    uint8_t type;
+    uint8_t reserved0;
+    uint16_t serial;
+    uint32_t device;
+    uint16_t length;
+    uint16_t reserved1;
+    uint8_t payload[];
+} audio_ring_record;
+
+/**
+ * @brief A mapping of the ring, either side
+ */
+typedef struct audio_ring {
+    audio_ring_header *header;
+    uint8_t *data;
+    uint32_t capacity;
+    uint32_t mask;
+    uint64_t position;      // producer: next write position, consumer: next read position
+    uint64_t limit;         // producer: cached read_pos, consumer: cached write_pos
+    uint64_t pending;       // producer: end of the reserved record
+    uint8_t is_producer;
+    char name[64];
+} audio_ring;
+
+/**
+ * @brief Producer: create (or replace) the shared memory object and map it
+ * @param name [in] shm_open name, starting with '/'
+ * @param capacity [in] data area size in bytes, rounded up to a power of two (at least 4096)
+ * @return 0 for success, -1 for failure
+ */
+int audio_ring_create(audio_ring *ring, const char *name, uint32_t capacity);
+
+/**
+ * @brief Consumer: map an existing ring
+ * @return 0 for success, -1 for failure (missing object, bad magic or version)
+ */
+int audio_ring_open(audio_ring *ring, const char *name);
+
+/**
+ * @brief Unmap the ring. The producer also removes the shared memory object.
+ */
+void audio_ring_close(audio_ring *ring);
+
+/**
+ * @brief Producer: start a record in place
+ * @return Payload area of length bytes to fill, NULL if the ring is full (the record is dropped and counted)
+ */
+void *audio_ring_reserve(audio_ring *ring, uint8_t type, uint32_t device, uint16_t serial, uint16_t length);
+
+/**
+ * @brief Producer: make the record started by audio_ring_reserve() visible, waking the consumer if it sleeps
+ */
+void audio_ring_publish(audio_ring *ring);
+
+/**
+ * @brief Producer: copy a record into the ring and publish it
+ * @return 0 for success, -1 if the ring is full
+ */
+int audio_ring_write(audio_ring *ring, uint8_t type, uint32_t device, uint16_t serial, const void *payload,
+                     uint16_t length);
+
+/**
+ * @brief Consumer: get the oldest record. It stays valid until audio_ring_consume().
+ * @return Record, NULL if the ring is empty
+ */
+const audio_ring_record *audio_ring_peek(audio_ring *ring);
+
+/**
+ * @brief Consumer: release the record returned by audio_ring_peek()
+ */
+void audio_ring_consume(audio_ring *ring, const audio_ring_record *record);
+
+/**
+ * @brief Consumer: sleep until a record is published
+ * @param timeout_ms [in] maximum time to sleep, negative for no limit
+ * @return 1 if records are available, 0 on timeout or interruption
+ */
+int audio_ring_wait(audio_ring *ring, int timeout_ms);
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,99 @@
+#include "client_metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// label values of parse errors, by parrot_error
+static const char *const error_labels[CLIENT_METRICS_ERRORS] = {
+    "ok", "too_short", "bad_magic", "bad_version", "bad_reserved", "checksum_mismatch", "too_long",
+    "payload_too_long", "buffer_too_small",
+};
+
+static void write_commands(FILE *out, const char *name, const char *help, const uint64_t counts[]) {
+    metrics_write_family(out, name, "counter", help);
+    for (uint32_t i = 0; i < CLIENT_METRICS_COMMANDS; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        char labels[32];
+        if (i == 0) {
+            snprintf(labels, sizeof(labels), "command=\"other\"");
+        } else {
+            snprintf(labels, sizeof(labels), "command=\"0x%02x\"", i);
+        }
+        metrics_write_sample(out, name, labels, counts[i]);
+    }
+}
+
+static void write_counter(FILE *out, const char *name, const char *help, const uint64_t value) {
+    metrics_write_family(out, name, "counter", help);
+    metrics_write_sample(out, name, NULL, value);
+}
+
+void client_metrics_render(FILE *out, const client_metrics *const metrics[], const uint32_t count) {
+    // the histograms are too large for the stack of a small thread
+    client_metrics *total = calloc(1, sizeof(client_metrics));
+    if (total == NULL) {
+        return;
+    }
+
+    for (uint32_t w = 0; w < count; w++) {
+        const client_metrics *m = metrics[w];
+        for (uint32_t i = 0; i < CLIENT_METRICS_COMMANDS; i++) {
+            total->rx_messages[i] += metrics_load(&m->rx_messages[i]);
+            total->tx_messages[i] += metrics_load(&m->tx_messages[i]);
+        }
+        for (uint32_t i = 0; i < CLIENT_METRICS_ERRORS; i++) {
+            total->parse_errors[i] += metrics_load(&m->parse_errors[i]);
+        }
+        total->rx_bytes += metrics_load(&m->rx_bytes);
+        total->tx_bytes += metrics_load(&m->tx_bytes);
+        total->unroutable += metrics_load(&m->unroutable);
+        total->audio_frames += metrics_load(&m->audio_frames);
+        total->audio_queue_full += metrics_load(&m->audio_queue_full);
+        total->retransmits += metrics_load(&m->retransmits);
+        total->unmatched_responses += metrics_load(&m->unmatched_responses);
+        total->server_lost += metrics_load(&m->server_lost);
+        metrics_histogram_merge(&total->handle_ns, &m->handle_ns);
+        metrics_histogram_merge(&total->audio_interarrival_ns, &m->audio_interarrival_ns);
+        metrics_histogram_merge(&total->audio_latency_ns, &m->audio_latency_ns);
+        metrics_histogram_merge(&total->rtt_ns, &m->rtt_ns);
+    }
+
+    write_commands(out, "parrot_client_rx_messages_total", "Messages received, by command.", total->rx_messages);
+    write_commands(out, "parrot_client_tx_messages_total", "Messages sent, by command.", total->tx_messages);
+    write_counter(out, "parrot_client_rx_bytes_total", "Bytes of the datagrams received.", total->rx_bytes);
+    write_counter(out, "parrot_client_tx_bytes_total", "Bytes of the datagrams sent.", total->tx_bytes);
+
+    metrics_write_family(out, "parrot_client_parse_errors_total", "counter",
+                         "Datagrams dropped as corrupted, by error.");
+    for (uint32_t i = 1; i < CLIENT_METRICS_ERRORS; i++) {
+        char labels[48];
+        snprintf(labels, sizeof(labels), "error=\"%s\"", error_labels[i]);
+        metrics_write_sample(out, "parrot_client_parse_errors_total", labels, total->parse_errors[i]);
+    }
+
+    write_counter(out, "parrot_client_unroutable_total", "Messages for a device that isn't hosted.",
+                  total->unroutable);
+    write_counter(out, "parrot_client_audio_frames_total", "Opus frames received.", total->audio_frames);
+    write_counter(out, "parrot_client_audio_queue_full_total",
+                  "Frames dropped because the playback thread fell behind.", total->audio_queue_full);
+    write_counter(out, "parrot_client_retransmits_total", "Requests sent again after a timeout.",
+                  total->retransmits);
+    write_counter(out, "parrot_client_unmatched_responses_total",
+                  "Responses matching no pending request, e.g. late responses to retransmitted ones.",
+                  total->unmatched_responses);
+    write_counter(out, "parrot_client_server_lost_total",
+                  "Devices that registered again after unanswered keep-alives.", total->server_lost);
+
+    metrics_write_histogram(out, "parrot_client_handle_seconds", "Time to parse and dispatch a received datagram.",
+                            &total->handle_ns, 1e-9);
+    metrics_write_histogram(out, "parrot_client_audio_interarrival_seconds",
+                            "Time between audio notifications of a device.", &total->audio_interarrival_ns, 1e-9);
+    metrics_write_histogram(out, "parrot_client_audio_latency_seconds",
+                            "One-way latency of audio stamped by parrot-sim on the same host.",
+                            &total->audio_latency_ns, 1e-9);
+    metrics_write_histogram(out, "parrot_client_rtt_seconds", "Round-trip time from a request to its response.",
+                            &total->rtt_ns, 1e-9);
+    free(total);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../proto/parrot_message.h"
+#include "../net/metrics.h"
+
+#define CLIENT_METRICS_COMMANDS 0x80                        // counted by command; command 0 counts the others
+#define CLIENT_METRICS_ERRORS (kParrotBufferTooSmall + 1)   // counted by parrot_error
+
+/**
+ * @brief Counters and histograms of one client worker, written by the worker thread only
+ */
+typedef struct client_metrics {
+    uint64_t rx_messages[CLIENT_METRICS_COMMANDS];
+    uint64_t tx_messages[CLIENT_METRICS_COMMANDS];
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint64_t parse_errors[CLIENT_METRICS_ERRORS];
+    uint64_t unroutable;
+    uint64_t audio_frames;
+    uint64_t audio_queue_full;          // frames dropped because the playback thread fell behind
+    uint64_t retransmits;               // requests sent again after a timeout
+    uint64_t unmatched_responses;       // responses to no pending request, e.g. to a retransmitted one
+    uint64_t server_lost;               // devices that registered again after unanswered keep-alives
+    metrics_histogram handle_ns;        // parsing and dispatching a received datagram
+    metrics_histogram audio_interarrival_ns;    // between audio notifications of a device
+    metrics_histogram audio_latency_ns; // one-way latency of messages stamped by parrot-sim
+    metrics_histogram rtt_ns;           // from a request to its response
+} client_metrics;
+
+/**
+ * @return Counter slot of a command
+ */
+static inline uint32_t client_metrics_command(const uint16_t command) {
+    return command < CLIENT_METRICS_COMMANDS ? command : 0;
+}
+
+/**
+ * @brief Count a message sent
+ */
+static inline void client_metrics_tx(client_metrics *m, const uint16_t command, const uint16_t length) {
+    metrics_add(&m->tx_messages[client_metrics_command(command)], 1);
+    metrics_add(&m->tx_bytes, length);
+}
+
+/**
+ * @brief Write the sum of the metrics of every worker in the Prometheus text format
+ */
+void client_metrics_render(FILE *out, const client_metrics *const metrics[], uint32_t count);
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,591 @@
+#include "client_worker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../proto/parrot_message.h"
+#include "../proto/parrot_schema.h"
+#include "../net/logger.h"
+#include "../net/udp_socket.h"
+#include "playback.h"
+
+#define DEFAULT_CLIENT_IP "192.168.124.130"
+#define TIMER_TICK_MS 10
+#define STARTUP_SPREAD_MS 1000
+#define REGISTER_RETRY_MAX_MS 60000
+#define KEEP_ALIVE_INTERVAL_MS 30000
+#define KEEP_ALIVE_JITTER_PERCENT 10
+#define KEEP_ALIVE_MAX_MISSES 3         // keep-alives timed out in a row before registering again
+#define ROUTINE_CHECK_MS 1000
+#define AUDIO_QUEUE_FRAMES 256
+
+static uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static void send_register_request(client_worker *w, device_session *session);
+static void send_keep_alive(client_worker *w, device_session *session);
+static void read_udp_messages(client_worker *w);
+static void routine_check(client_worker *w);
+
+static void on_socket_readable(event_loop *l, const int fd, const uint32_t events, void *user_data) {
+    (void) l;
+    (void) fd;
+    (void) events;
+
+    read_udp_messages(user_data);
+}
+
+static void on_wheel_timer(event_loop *l, void *user_data) {
+    client_worker *w = user_data;
+
+    timer_wheel_advance(&w->timers, event_loop_now_ms(l));
+}
+
+static void on_device_timer(timer_wheel_node *node, void *user_data) {
+    client_worker *w = user_data;
+
+    device_session *session = timer_wheel_entry(node, device_session, timer);
+    const rtt_estimator *rtt = &w->transactions.rtt;
+    if (session->is_logged_in) {
+        if (transaction_table_find(&w->transactions, session->device, session->serial) == NULL) {
+            // the keep-alive interval is over
+            send_keep_alive(w, session);
+            timer_wheel_arm(&w->timers, &session->timer, rtt_estimator_timeout(rtt, 0, KEEP_ALIVE_INTERVAL_MS));
+            return;
+        }
+
+        // the keep-alive timed out: retry with a doubled timeout
+        if (++session->keep_alive_misses < KEEP_ALIVE_MAX_MISSES) {
+            metrics_add(&w->metrics.retransmits, 1);
+            send_keep_alive(w, session);
+            timer_wheel_arm(&w->timers, &session->timer,
+                            rtt_estimator_timeout(rtt, session->keep_alive_misses, KEEP_ALIVE_INTERVAL_MS));
+            return;
+        }
+
+        // fail over within a few RTOs rather than keep-alive intervals
+        LOG_WARN("[%08x] %u keep-alives unanswered, registering again", session->device,
+                 session->keep_alive_misses);
+        metrics_add(&w->metrics.server_lost, 1);
+        session->is_logged_in = parrot_false;
+        session->keep_alive_misses = 0;
+        session->register_attempts = 0;
+    }
+
+    // jittered exponential backoff from the RTO: in [rto, 2 rto] << attempts, so devices don't retry in lockstep
+    if (session->register_attempts != 0) {
+        metrics_add(&w->metrics.retransmits, 1);
+    }
+    send_register_request(w, session);
+    timer_wheel_arm(&w->timers, &session->timer,
+                    timer_wheel_backoff(&w->timers, 2 * rtt->rto_ms, REGISTER_RETRY_MAX_MS,
+                                        session->register_attempts));
+    if (session->register_attempts < 16) {
+        ++session->register_attempts;
+    }
+}
+
+static void on_routine_timer(event_loop *l, void *user_data) {
+    (void) l;
+
+    routine_check(user_data);
+}
+
+static void queue_audio(client_worker *w, const uint8_t type, const uint32_t device, const uint16_t serial,
+                        const uint8_t *data, const uint16_t length) {
+    // never wait for the playback thread: drop the frame if it's behind
+    audio_frame *frame = spsc_queue_reserve(&w->audio_queue);
+    if (frame == NULL) {
+        metrics_add(&w->metrics.audio_queue_full, 1);
+        return;
+    }
+
+    frame->type = type;
+    frame->device = device;
+    frame->serial = serial;
+    frame->length = length;
+    if (length != 0) {
+        memcpy(frame->data, data, length);
+    }
+    spsc_queue_publish(&w->audio_queue);
+}
+
+void client_worker_playout(client_worker *w) {
+    for (uint32_t i = 0; i < w->playing_count; i++) {
+        jitter_buffer *jb = w->playing[i];
+
+        uint16_t serial = 0;
+        const uint8_t *data = NULL;
+        uint16_t length = 0;
+        const jitter_buffer_result result = jitter_buffer_pop(jb, &serial, &data, &length);
+        if (result == kJitterFrame) {
+            queue_audio(w, AUDIO_RING_FRAME, jb->device, serial, data, length);
+        } else if (result == kJitterLost) {
+            queue_audio(w, AUDIO_RING_LOST, jb->device, serial, NULL, 0);
+        }
+    }
+}
+
+static void on_playout_timer(event_loop *l, void *user_data) {
+    (void) l;
+
+    client_worker_playout(user_data);
+}
+
+static void on_loop_iteration(event_loop *l, void *user_data) {
+    (void) l;
+
+    client_worker *w = user_data;
+    // send everything queued while dispatching this iteration's events
+    udp_io_flush(&w->io);
+}
+
+int client_worker_init(client_worker *w, const uint32_t index, const client_worker_options *options) {
+    w->thread.index = index;
+
+    // event loop
+    if (event_loop_init(&w->loop) != 0) {
+        fprintf(stderr, "Failed to create event loop\n");
+        return -1;
+    }
+
+    if (spsc_queue_init(&w->audio_queue, AUDIO_QUEUE_FRAMES, sizeof(audio_frame)) != 0) {
+        fprintf(stderr, "Failed to allocate audio queue\n");
+        return -1;
+    }
+
+    if (transaction_table_init(&w->transactions, w->devices.count) != 0) {
+        fprintf(stderr, "Failed to allocate transaction table\n");
+        return -1;
+    }
+
+    timer_wheel_init(&w->timers, TIMER_TICK_MS, event_loop_now_ms(&w->loop), on_device_timer, w);
+    w->timers.random ^= index * 0x9E3779B9u;
+    if (options->host == NULL) {
+        // datagrams come from the caller, and the worker sends nothing of its own
+        return 0;
+    }
+
+    // listen on udp
+    w->sock = udp_socket_bind((uint16_t) (CLIENT_LOCAL_PORT + index), 0, 0);
+    if (w->sock < 0) {
+        fprintf(stderr, "Failed to create UDP socket\n");
+        return -1;
+    }
+
+    if (udp_socket_connect(w->sock, options->host, options->port) < 0) {
+        fprintf(stderr, "Failed to connect UDP socket\n");
+        return -1;
+    }
+
+    if (udp_io_init(&w->io, w->sock, options->backend) != 0) {
+        fprintf(stderr, "Failed to set up UDP I/O\n");
+        return -1;
+    }
+
+    if (options->capture_path != NULL) {
+        if (udp_trace_writer_open(&w->capture, options->capture_path) != 0) {
+            fprintf(stderr, "Failed to create capture %s\n", options->capture_path);
+            return -1;
+        }
+        udp_io_set_capture(&w->io, &w->capture);
+    }
+
+    const int routine_timer = event_loop_add_timer(&w->loop, on_routine_timer, w);
+    const int wheel_timer = event_loop_add_timer(&w->loop, on_wheel_timer, w);
+    const int playout_timer = event_loop_add_timer(&w->loop, on_playout_timer, w);
+    if (routine_timer < 0 || wheel_timer < 0 || playout_timer < 0
+        || event_loop_add_fd(&w->loop, udp_io_fd(&w->io), EVENT_READ, on_socket_readable, w) != 0) {
+        fprintf(stderr, "Failed to set up event loop\n");
+        return -1;
+    }
+    event_loop_set_iteration_callback(&w->loop, on_loop_iteration, w);
+
+    // register every device, spread over the startup interval, then re-register until the server answers
+    const uint32_t capacity = device_table_capacity(&w->devices);
+    for (uint32_t i = 0; i < capacity; i++) {
+        device_session *session = device_table_at(&w->devices, i);
+        if (session != NULL) {
+            timer_wheel_arm(&w->timers, &session->timer, timer_wheel_jitter(&w->timers, STARTUP_SPREAD_MS, 100));
+        }
+    }
+    event_loop_set_timer(&w->loop, wheel_timer, TIMER_TICK_MS, TIMER_TICK_MS);
+    event_loop_set_timer(&w->loop, routine_timer, ROUTINE_CHECK_MS, ROUTINE_CHECK_MS); // periodic status check
+    event_loop_set_timer(&w->loop, playout_timer, AUDIO_FRAME_MS, AUDIO_FRAME_MS);
+    return 0;
+}
+
+void client_worker_run(void *arg) {
+    client_worker *w = arg;
+    event_loop_run(&w->loop);
+}
+
+static void print_histogram(const client_worker *w, const char *what, const metrics_histogram *h) {
+    const uint64_t count = metrics_histogram_count(h);
+    if (count != 0) {
+        printf("worker %u: %s: %llu samples, p50 <= %.1f us, p99 <= %.1f us\n", w->thread.index, what,
+               (unsigned long long) count, (double) metrics_histogram_quantile(h, 0.50) / 1000.0,
+               (double) metrics_histogram_quantile(h, 0.99) / 1000.0);
+    }
+}
+
+void client_worker_destroy(client_worker *w) {
+    event_loop_destroy(&w->loop);
+
+    const udp_batch_stats *stats = udp_io_stats(&w->io);
+    if (w->metrics.unroutable != 0) {
+        printf("worker %u: unroutable messages: %llu\n", w->thread.index, (unsigned long long) w->metrics.unroutable);
+    }
+    if (w->sock >= 0) {
+        printf("worker %u: udp batch: rx %.2f datagrams/call, tx %.2f datagrams/call, tx dropped %llu\n",
+               w->thread.index, udp_batch_avg_rx(stats), udp_batch_avg_tx(stats),
+               (unsigned long long) stats->tx_dropped);
+    }
+
+    if (w->playing_count != 0) {
+        jitter_buffer_stats total;
+        memset(&total, 0, sizeof(total));
+        for (uint32_t i = 0; i < w->playing_count; i++) {
+            const jitter_buffer_stats *jitter = &w->playing[i]->stats;
+            total.received += jitter->received;
+            total.played += jitter->played;
+            total.late += jitter->late;
+            total.lost += jitter->lost;
+            total.underruns += jitter->underruns;
+            total.discarded += jitter->discarded;
+        }
+        printf("worker %u: audio: received %llu played %llu late %llu lost %llu underruns %llu discarded %llu "
+               "queue full %llu\n", w->thread.index,
+               (unsigned long long) total.received, (unsigned long long) total.played,
+               (unsigned long long) total.late, (unsigned long long) total.lost,
+               (unsigned long long) total.underruns, (unsigned long long) total.discarded,
+               (unsigned long long) w->metrics.audio_queue_full);
+    }
+    print_histogram(w, "handling", &w->metrics.handle_ns);
+    print_histogram(w, "audio latency", &w->metrics.audio_latency_ns);
+    print_histogram(w, "rtt", &w->metrics.rtt_ns);
+    if (w->metrics.retransmits != 0 || w->metrics.unmatched_responses != 0 || w->metrics.server_lost != 0) {
+        printf("worker %u: requests: %llu retransmitted, %llu unmatched responses, %llu devices re-registered, "
+               "rto %u ms\n", w->thread.index, (unsigned long long) w->metrics.retransmits,
+               (unsigned long long) w->metrics.unmatched_responses, (unsigned long long) w->metrics.server_lost,
+               w->transactions.rtt.rto_ms);
+    }
+
+    udp_io_destroy(&w->io);
+    if (w->capture.map != NULL) {
+        if (w->capture.dropped != 0) {
+            printf("worker %u: capture: %llu datagrams dropped\n", w->thread.index,
+                   (unsigned long long) w->capture.dropped);
+        }
+        udp_trace_writer_close(&w->capture);
+    }
+    device_table_destroy(&w->devices);     // frees the jitter buffers
+    transaction_table_destroy(&w->transactions);
+    free(w->playing);
+    spsc_queue_destroy(&w->audio_queue);
+    if (w->sock >= 0) close(w->sock);
+}
+
+/**
+ * @brief Drop the pending request of a device, if any
+ */
+static void cancel_transaction(client_worker *w, const device_session *session) {
+    transaction *pending = transaction_table_find(&w->transactions, session->device, session->serial);
+    if (pending != NULL) {
+        transaction_table_remove(&w->transactions, pending);
+    }
+}
+
+/**
+ * @brief Take the next serial of a device for a request, and track the request until its response
+ * @return Serial of the request
+ */
+static uint16_t begin_transaction(client_worker *w, device_session *session, const uint16_t command) {
+    // a retransmission replaces the request it retries
+    cancel_transaction(w, session);
+    const uint16_t serial = device_session_next_serial(session);
+    transaction_table_insert(&w->transactions, session->device, serial, command, clock_ns());
+    return serial;
+}
+
+/**
+ * @brief Match a response to its pending request and take an RTT sample
+ * @param command [in] command of the request
+ * @return Whether the request was pending
+ */
+static int end_transaction(client_worker *w, const device_session *session, const uint16_t serial,
+                           const uint16_t command, const uint64_t now_ns) {
+    transaction *t = transaction_table_find(&w->transactions, session->device, serial);
+    if (t == NULL || t->command != command) {
+        metrics_add(&w->metrics.unmatched_responses, 1);
+        return 0;
+    }
+
+    const uint64_t rtt_ns = now_ns - t->sent_ns;
+    metrics_histogram_record(&w->metrics.rtt_ns, rtt_ns);
+    rtt_estimator_sample(&w->transactions.rtt, rtt_ns);
+    transaction_table_remove(&w->transactions, t);
+    return 1;
+}
+
+static void send_keep_alive(client_worker *w, device_session *session) {
+    if (session->keep_alive_req.length == 0) {
+        parrot_builder builder;
+        parrot_template_begin(&session->keep_alive_req, &builder, session->device, 0x03);
+        parrot_template_finish(&session->keep_alive_req, &builder, parrot_true);
+    }
+
+    uint16_t size = 0;
+    void *buf = udp_io_slot(&w->io, &size);
+    const uint16_t n = parrot_template_emit(&session->keep_alive_req, buf, size, begin_transaction(w, session, 0x03));
+    udp_io_commit(&w->io, n, NULL);
+    client_metrics_tx(&w->metrics, 0x03, n);
+}
+
+static void routine_check(client_worker *w) {
+    for (uint32_t i = 0; i < w->playing_count; i++) {
+        const jitter_buffer *jb = w->playing[i];
+        if (jb->playing || jb->count != 0) {
+            LOG_INFO("[%08x] jitter buffer depth=%u target=%u jitter=%ums late=%llu lost=%llu underruns=%llu",
+                     jb->device, jb->count, jb->target_depth, jitter_buffer_jitter_ms(jb), jb->stats.late,
+                     jb->stats.lost, jb->stats.underruns);
+        }
+    }
+}
+
+static jitter_buffer *session_jitter_buffer(client_worker *w, device_session *session) {
+    if (session->jitter != NULL) {
+        return session->jitter;
+    }
+
+    // allocated on the first frame: most devices never play audio
+    if (w->playing_count == w->playing_capacity) {
+        const uint32_t capacity = w->playing_capacity ? w->playing_capacity * 2 : 16;
+        jitter_buffer **playing = realloc(w->playing, capacity * sizeof(jitter_buffer *));
+        if (playing == NULL) {
+            return NULL;
+        }
+        w->playing = playing;
+        w->playing_capacity = capacity;
+    }
+
+    session->jitter = jitter_buffer_create(session->device);
+    if (session->jitter != NULL) {
+        w->playing[w->playing_count++] = session->jitter;
+    }
+    return session->jitter;
+}
+
+
+static void on_audio_notify(client_worker *w, device_session *session, const uint16_t serial, const void *payload,
+                            const uint16_t len, const uint64_t now_ns) {
+    parrot_audio_notify audio;
+    uint64_t present = 0;
+    const parrot_schema_result result = parrot_schema_decode(&parrot_schema_audio_notify, payload, len, &audio,
+                                                             &present);
+    if (result != kSchemaOk) {
+        LOG_WARN("[%08x] bad audio notify: %s", session->device, LOG_STR(parrot_schema_result_name(result), -1));
+        return;
+    }
+
+    if ((present & PARROT_FIELD(PARROT_AUDIO_SENT_AT_KEY)) && w->sock >= 0) {
+        // stamped by parrot-sim on this host: same monotonic clock (and not a replayed stamp of the past)
+        const int64_t latency_ns = (int64_t) now_ns - audio.sent_at_us * 1000;
+        metrics_histogram_record(&w->metrics.audio_latency_ns, latency_ns > 0 ? (uint64_t) latency_ns : 0);
+    }
+    if (session->last_audio_ns != 0) {
+        metrics_histogram_record(&w->metrics.audio_interarrival_ns, now_ns - session->last_audio_ns);
+    }
+    session->last_audio_ns = now_ns;
+
+    jitter_buffer *jb = session_jitter_buffer(w, session);
+    metrics_add(&w->metrics.audio_frames, audio.frame_count);
+    for (uint8_t i = 0; i < audio.frame_count; i++) {
+        ++session->audio_frame_count;
+
+        if (jb != NULL) {
+            jitter_buffer_put(jb, serial, i, audio.frames[i].data, (uint16_t) audio.frames[i].length,
+                              event_loop_now_ms(&w->loop));
+        }
+    }
+}
+
+static void on_volume_notify(device_session *session, const void *payload, const uint16_t len) {
+    parrot_volume fields;
+    const parrot_schema_result result = parrot_schema_decode(&parrot_schema_volume_notify, payload, len, &fields,
+                                                             NULL);
+    if (result != kSchemaOk) {
+        LOG_WARN("[%08x] bad volume notify: %s", session->device, LOG_STR(parrot_schema_result_name(result), -1));
+        return;
+    }
+
+    LOG_INFO("[%08x] volume notify id=%d value=%d", session->device, fields.audio_dev_id, fields.volume);
+    if (fields.audio_dev_id == 1 && fields.volume >= 0 && fields.volume <= 100) {
+        if (session->volume != fields.volume) {
+            session->volume = (uint8_t) fields.volume;
+            session->register_req.length = 0; // carries ao_volume
+        }
+    }
+}
+
+static void on_status_notify(const device_session *session, const void *payload, const uint16_t len) {
+    parrot_status_notify fields;
+    const parrot_schema_result result = parrot_schema_decode(&parrot_schema_status_notify, payload, len, &fields,
+                                                             NULL);
+    if (result != kSchemaOk) {
+        LOG_WARN("[%08x] bad online status notify: %s", session->device,
+                 LOG_STR(parrot_schema_result_name(result), -1));
+        return;
+    }
+
+    LOG_INFO("[%08x] online status=%d message=%s", session->device, fields.status,
+             LOG_STR(fields.message.data, fields.message.length));
+}
+
+static void on_register_res(client_worker *w, device_session *session, const uint16_t serial, const void *payload,
+                            const uint16_t len, const uint64_t now_ns) {
+    // both fields are optional: result 0 means success
+    parrot_register_res fields = {0, {"", 0}};
+    const parrot_schema_result result = parrot_schema_decode(&parrot_schema_register_res, payload, len, &fields,
+                                                             NULL);
+    if (result != kSchemaOk) {
+        LOG_WARN("[%08x] bad register response: %s", session->device,
+                 LOG_STR(parrot_schema_result_name(result), -1));
+        return;
+    }
+
+    LOG_INFO("[%08x] Register status=%d message=%s", session->device, fields.result,
+             LOG_STR(fields.message.data, fields.message.length));
+    end_transaction(w, session, serial, 0x01, now_ns);
+    if (!session->is_logged_in) {
+        // a late response to an earlier register request leaves the last one pending
+        cancel_transaction(w, session);
+        session->is_logged_in = parrot_true;
+        session->register_attempts = 0;
+        session->keep_alive_misses = 0;
+        timer_wheel_arm(&w->timers, &session->timer,
+                        timer_wheel_jitter(&w->timers, KEEP_ALIVE_INTERVAL_MS, KEEP_ALIVE_JITTER_PERCENT));
+    }
+}
+
+static void on_keep_alive_res(client_worker *w, device_session *session, const uint16_t serial,
+                              const uint64_t now_ns) {
+    // even a late response to a retried keep-alive shows the server is up
+    session->keep_alive_misses = 0;
+    if (end_transaction(w, session, serial, 0x03, now_ns) && session->is_logged_in) {
+        timer_wheel_arm(&w->timers, &session->timer,
+                        timer_wheel_jitter(&w->timers, KEEP_ALIVE_INTERVAL_MS, KEEP_ALIVE_JITTER_PERCENT));
+    }
+}
+
+static void dispatch_datagram(client_worker *w, const void *data, const uint16_t length, const uint64_t now_ns) {
+    client_metrics *metrics = &w->metrics;
+    metrics_add(&metrics->rx_bytes, length);
+
+    parrot_message msg;
+    const parrot_error error = parrot_message_parse(&msg, data, length);
+    if (error != kParrotOk) {
+        metrics_add(&metrics->parse_errors[error < CLIENT_METRICS_ERRORS ? error : 0], 1);
+        return;
+    }
+    metrics_add(&metrics->rx_messages[client_metrics_command(msg.command)], 1);
+
+    // the server may omit the device code, which is unambiguous only with a single device
+    device_session *session = NULL;
+    if (msg.device != 0) {
+        session = device_table_find(&w->devices, msg.device);
+    } else if (w->devices.count == 1) {
+        for (uint32_t i = 0; session == NULL; i++) {
+            session = device_table_at(&w->devices, i);
+        }
+    }
+
+    if (session == NULL) {
+        metrics_add(&metrics->unroutable, 1);
+        return;
+    }
+
+    // other notifications share the serial space of audio frames: not a lost frame
+    if (session->jitter != NULL && msg.command >= 0x40 && msg.command <= 0x44 && msg.command != 0x41) {
+        jitter_buffer_skip(session->jitter, msg.serial);
+    }
+
+    switch (msg.command) {
+        case 0x02: // Register response
+            on_register_res(w, session, msg.serial, msg.payload_data, msg.payload_len, now_ns);
+            break;
+        case 0x04: // Keep-alive response
+            on_keep_alive_res(w, session, msg.serial, now_ns);
+            break;
+        case 0x40:
+            on_status_notify(session, msg.payload_data, msg.payload_len);
+            break;
+        case 0x41:
+            on_audio_notify(w, session, msg.serial, msg.payload_data, msg.payload_len, now_ns);
+            break;
+        case 0x42:
+            LOG_INFO("[%08x] start play notify", session->device);
+            queue_audio(w, AUDIO_RING_START, session->device, msg.serial, NULL, 0);
+            break;
+        case 0x43:
+            LOG_INFO("[%08x] stop play notify", session->device);
+            queue_audio(w, AUDIO_RING_STOP, session->device, msg.serial, NULL, 0);
+            if (session->jitter != NULL) {
+                jitter_buffer_reset(session->jitter);
+            }
+            break;
+        case 0x44:
+            on_volume_notify(session, msg.payload_data, msg.payload_len);
+            break;
+        default:
+            break;
+    }
+}
+
+void client_worker_handle_datagram(client_worker *w, const void *data, const uint16_t length) {
+    const uint64_t start = clock_ns();
+    dispatch_datagram(w, data, length, start);
+    metrics_histogram_record(&w->metrics.handle_ns, clock_ns() - start);
+}
+
+static void on_udp_datagram(void *user_data, const void *data, const uint16_t length,
+                            const struct sockaddr_in *from) {
+    (void) from;
+
+    if (length > 0) {
+        client_worker_handle_datagram(user_data, data, length);
+    }
+}
+
+static void read_udp_messages(client_worker *w) {
+    udp_io_receive(&w->io, on_udp_datagram, w);
+}
+
+static void send_register_request(client_worker *w, device_session *session) {
+    if (session->register_req.length == 0) {
+        parrot_register_req fields;
+        fields.client_ip.data = session->client_ip[0] ? session->client_ip : DEFAULT_CLIENT_IP;
+        fields.client_ip.length = -1;
+        fields.client_version.data = "1.0.1";
+        fields.client_version.length = -1;
+        fields.ao_volume = session->volume;
+
+        parrot_builder builder;
+        parrot_template_begin(&session->register_req, &builder, session->device, 0x01);
+        parrot_schema_build(&parrot_schema_register_req, &fields,
+                            PARROT_FIELD(1) | PARROT_FIELD(2) | PARROT_FIELD(3), &builder);
+        parrot_template_finish(&session->register_req, &builder, parrot_true);
+    }
+
+    uint16_t size = 0;
+    void *buf = udp_io_slot(&w->io, &size);
+    const uint16_t n = parrot_template_emit(&session->register_req, buf, size, begin_transaction(w, session, 0x01));
+    udp_io_commit(&w->io, n, NULL);
+    client_metrics_tx(&w->metrics, 0x01, n);
+}
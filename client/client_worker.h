@@ -0,0 +1,97 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#include "../net/event_loop.h"
+#include "../net/spsc_queue.h"
+#include "../net/timer_wheel.h"
+#include "../net/udp_io.h"
+#include "../net/udp_trace.h"
+#include "../net/worker.h"
+#include "client_metrics.h"
+#include "device_table.h"
+#include "jitter_buffer.h"
+#include "transaction_table.h"
+
+#define CLIENT_LOCAL_PORT 9802
+
+/**
+ * @brief One shard of the hosted devices, served by its own thread.
+ *
+ * Devices are assigned to workers by a hash of the device code. Each worker
+ * has its own socket (on local port CLIENT_LOCAL_PORT + index), event loop,
+ * timer wheel and device table, so nothing is shared on the receive path.
+ *
+ * Requests are tracked until their response: they're retransmitted after a
+ * timeout computed from the measured RTT, and a device whose keep-alives go
+ * unanswered KEEP_ALIVE_MAX_MISSES times in a row registers again.
+ *
+ * Audio frames go through a jitter buffer per device; every AUDIO_FRAME_MS
+ * the worker plays them out into its queue to the playback thread.
+ */
+typedef struct client_worker {
+    worker thread;
+    int sock;
+    udp_io io;
+    event_loop loop;
+    timer_wheel timers;
+    device_table devices;
+    transaction_table transactions;     // requests waiting for their response
+    udp_trace_writer capture;   // open with client_worker_options.capture_path
+
+    spsc_queue audio_queue;     // audio_frame records for the playback thread
+    jitter_buffer **playing;    // jitter buffers of the devices that received audio
+    uint32_t playing_count;
+    uint32_t playing_capacity;
+    client_metrics metrics;     // read by the metrics server's thread
+} client_worker;
+
+typedef struct client_worker_options {
+    const char *host;           // server; NULL for a worker without socket and timers, fed by the caller
+    uint16_t port;
+    udp_io_backend backend;
+    const char *capture_path;   // trace of the worker's datagrams, NULL for none
+} client_worker_options;
+
+/**
+ * @brief Prepare a zeroed worker, so that client_worker_destroy() works at any point of its setup
+ */
+static inline void client_worker_reset(client_worker *w) {
+    w->sock = -1;
+    w->loop.epoll_fd = -1;
+}
+
+/**
+ * @brief Set up the socket, event loop and timers of a worker whose device table is filled
+ * @param w [in] worker, reset and with thread.cpu set
+ * @param index [in] worker index
+ * @return 0 for success, -1 for failure
+ */
+int client_worker_init(client_worker *w, uint32_t index, const client_worker_options *options);
+
+/**
+ * @brief Print the worker's statistics and release its resources
+ */
+void client_worker_destroy(client_worker *w);
+
+/**
+ * @brief Run the worker's event loop until it's stopped. A worker_function.
+ */
+void client_worker_run(void *arg);
+
+/**
+ * @brief Parse a datagram from the server and dispatch it to its device
+ */
+void client_worker_handle_datagram(client_worker *w, const void *data, uint16_t length);
+
+/**
+ * @brief Play out one AUDIO_FRAME_MS of every jitter buffer into the audio queue
+ */
+void client_worker_playout(client_worker *w);
+
+#if __cplusplus
+}
+#endif
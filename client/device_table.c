@@ -0,0 +1,180 @@
+#include "device_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t device_hash(const uint32_t device) {
+    // murmur3 finalizer: every bit of the code reaches the low bits the table masks, so codes
+    // that differ only in a vendor or batch prefix spread as well as sequential ones
+    uint32_t h = device;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int device_table_alloc(device_table *table, const uint32_t capacity) {
+    table->keys = calloc(capacity, sizeof(uint32_t));
+    table->sessions = calloc(capacity, sizeof(device_session));
+    if (table->keys == NULL || table->sessions == NULL) {
+        free(table->keys);
+        free(table->sessions);
+        table->keys = NULL;
+        table->sessions = NULL;
+        return -1;
+    }
+
+    table->mask = capacity - 1;
+    table->count = 0;
+    return 0;
+}
+
+int device_table_init(device_table *table, const uint32_t expected_count) {
+    memset(table, 0, sizeof(*table));
+
+    // keep the load factor at or below 1/2
+    uint32_t capacity = 16;
+    while (capacity < expected_count * 2) {
+        capacity <<= 1;
+    }
+
+    return device_table_alloc(table, capacity);
+}
+
+void device_table_destroy(device_table *table) {
+    for (uint32_t i = 0; table->keys != NULL && i <= table->mask; i++) {
+        if (table->keys[i] != 0) {
+            jitter_buffer_destroy(table->sessions[i].jitter);
+        }
+    }
+    free(table->keys);
+    free(table->sessions);
+    memset(table, 0, sizeof(*table));
+}
+
+device_session *device_table_find(const device_table *table, const uint32_t device) {
+    if (device == 0 || table->keys == NULL) {
+        return NULL;
+    }
+
+    uint32_t index = device_hash(device) & table->mask;
+    while (1) {
+        const uint32_t key = table->keys[index];
+        if (key == device) {
+            return &table->sessions[index];
+        }
+        if (key == 0) {
+            return NULL;
+        }
+        index = (index + 1) & table->mask;
+    }
+}
+
+static int device_table_grow(device_table *table) {
+    device_table old = *table;
+    if (device_table_alloc(table, (old.mask + 1) << 1) != 0) {
+        *table = old;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i <= old.mask; i++) {
+        if (old.keys[i] != 0) {
+            *device_table_insert(table, old.keys[i]) = old.sessions[i];
+        }
+    }
+
+    free(old.keys);
+    free(old.sessions);
+    return 0;
+}
+
+device_session *device_table_insert(device_table *table, const uint32_t device) {
+    if (device == 0) {
+        return NULL;
+    }
+
+    if ((table->count + 1) * 2 > table->mask + 1) {
+        device_session *existing = device_table_find(table, device);
+        if (existing != NULL) {
+            return existing;
+        }
+        if (device_table_grow(table) != 0) {
+            return NULL;
+        }
+    }
+
+    uint32_t index = device_hash(device) & table->mask;
+    while (table->keys[index] != 0) {
+        if (table->keys[index] == device) {
+            return &table->sessions[index];
+        }
+        index = (index + 1) & table->mask;
+    }
+
+    table->keys[index] = device;
+    table->count++;
+
+    device_session *session = &table->sessions[index];
+    memset(session, 0, sizeof(*session));
+    session->device = device;
+    session->volume = 100;
+    return session;
+}
+
+int device_table_load(device_table *table, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    int loaded = 0;
+    int line_no = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        ++line_no;
+
+        char code[32] = "";
+        char ip[DEVICE_CLIENT_IP_SIZE] = "";
+        int volume = -1;
+        const int n = sscanf(line, "%31s %15s %d", code, ip, &volume);
+        if (n < 1 || code[0] == '#') {
+            continue;
+        }
+
+        // not base 0: a leading zero is a decimal digit, not an octal prefix
+        const int base = code[0] == '0' && (code[1] == 'x' || code[1] == 'X') ? 16 : 10;
+        char *end = NULL;
+        const unsigned long device = strtoul(code, &end, base);
+        if (*end != '\0' || device == 0 || device > 0xFFFFFFFFul) {
+            fprintf(stderr, "%s:%d: bad device code '%s'\n", path, line_no, code);
+            continue;
+        }
+
+        const uint32_t count = table->count;
+        device_session *session = device_table_insert(table, (uint32_t) device);
+        if (session == NULL) {
+            fprintf(stderr, "%s:%d: out of memory\n", path, line_no);
+            fclose(fp);
+            return -1;
+        }
+        if (table->count == count) {
+            fprintf(stderr, "%s:%d: duplicate device code '%s', line ignored\n", path, line_no, code);
+            continue;
+        }
+
+        if (n >= 2) {
+            memcpy(session->client_ip, ip, sizeof(session->client_ip));
+        }
+        if (n >= 3 && volume >= 0 && volume <= 100) {
+            session->volume = (uint8_t) volume;
+        }
+        ++loaded;
+    }
+
+    fclose(fp);
+    return loaded;
+}
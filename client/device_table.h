@@ -0,0 +1,110 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../proto/c_string.h"
+#include "../proto/parrot_builder.h"
+#include "../net/timer_wheel.h"
+#include "jitter_buffer.h"
+
+#define DEVICE_CLIENT_IP_SIZE 16
+
+/**
+ * @brief State of one virtual device (speaker) hosted by the client
+ */
+typedef struct device_session {
+    uint32_t device;            // device code
+    uint16_t serial;            // serial of the last request sent
+    parrot_bool is_logged_in;
+    uint8_t volume;             // playback volume [0, 100]
+    uint8_t register_attempts;  // register requests sent without response
+    uint8_t keep_alive_misses;  // keep-alive requests in a row that timed out
+    timer_wheel_node timer;     // register retry while logged out, keep-alive or its timeout while logged in
+    uint32_t audio_frame_count;
+    uint64_t last_audio_ns;     // arrival of the last audio notify
+    jitter_buffer *jitter;      // allocated on the first audio frame
+    char client_ip[DEVICE_CLIENT_IP_SIZE];
+    parrot_template keep_alive_req;     // built on first use
+    parrot_template register_req;       // built on first use, cleared when the volume changes
+} device_session;
+
+/**
+ * @brief Open-addressing (linear probing) table of device sessions keyed by device code.
+ *
+ * Keys are stored apart from the sessions, so a lookup probes a dense array
+ * of 32-bit codes and touches one session only. Device code 0 marks an empty
+ * slot (messages without device code can't be routed by code anyway).
+ */
+typedef struct device_table {
+    uint32_t *keys;
+    device_session *sessions;
+    uint32_t mask;      // capacity - 1
+    uint32_t count;
+} device_table;
+
+/**
+ * @brief Allocate a table for the expected number of devices
+ * @return 0 for success, -1 for failure
+ */
+int device_table_init(device_table *table, uint32_t expected_count);
+
+/**
+ * @brief Release table storage and the jitter buffers of the sessions
+ */
+void device_table_destroy(device_table *table);
+
+/**
+ * @brief Find the session of a device
+ * @return Session, NULL if the device isn't in the table
+ */
+device_session *device_table_find(const device_table *table, uint32_t device);
+
+/**
+ * @brief Add a device, or get its session if it's already in the table.
+ *
+ * Adding may move sessions to grow the table, so session timers must not be armed before all devices are added.
+ *
+ * @return Session, NULL if device is 0 or the table is full
+ */
+device_session *device_table_insert(device_table *table, uint32_t device);
+
+/**
+ * @brief Load devices from a text file, one device per line: <device code> [client ip] [volume]
+ *
+ * Device codes are decimal (a leading zero doesn't make them octal) or 0x-prefixed hex. Empty lines and lines
+ * starting with '#' are skipped, and so are lines repeating a device code already loaded (with a warning).
+ *
+ * @return Number of distinct devices loaded, -1 for failure
+ */
+int device_table_load(device_table *table, const char *path);
+
+/**
+ * @return Capacity of the table; sessions are iterated by index over [0, capacity)
+ */
+static inline uint32_t device_table_capacity(const device_table *table) {
+    return table->mask + 1;
+}
+
+/**
+ * @return Session at a slot index, NULL if the slot is empty
+ */
+static inline device_session *device_table_at(const device_table *table, const uint32_t index) {
+    return table->keys[index] != 0 ? &table->sessions[index] : NULL;
+}
+
+/**
+ * @brief Advance the session serial. Serials are 15-bit and never 0 (0 means 'no serial' on the wire).
+ * @return The new serial
+ */
+static inline uint16_t device_session_next_serial(device_session *session) {
+    session->serial = (uint16_t) (session->serial % 0x7FFF + 1);
+    return session->serial;
+}
+
+#if __cplusplus
+}
+#endif
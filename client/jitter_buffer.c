@@ -0,0 +1,270 @@
+#include "jitter_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define JITTER_BUFFER_MASK (JITTER_BUFFER_CAPACITY - 1)
+#define JITTER_MAX_DEVIATION_MS 500     // cap on one transit difference, e.g. across a pause
+
+#define JITTER_SLOT_EMPTY 0
+#define JITTER_SLOT_FRAME 1
+#define JITTER_SLOT_SKIP 2
+
+#define SERIAL_MODULUS 0x7FFF
+
+static uint16_t serial_add(const uint16_t serial, const uint32_t n) {
+    return (uint16_t) ((serial - 1 + n) % SERIAL_MODULUS + 1);
+}
+
+/**
+ * @return Distance from b to a in serial space, negative if a comes before b
+ */
+static int32_t serial_diff(const uint16_t a, const uint16_t b) {
+    const int32_t d = ((int32_t) a - (int32_t) b + SERIAL_MODULUS) % SERIAL_MODULUS;
+    return d > SERIAL_MODULUS / 2 ? d - SERIAL_MODULUS : d;
+}
+
+jitter_buffer *jitter_buffer_create(const uint32_t device) {
+    jitter_buffer *jb = calloc(1, sizeof(jitter_buffer));
+    if (jb == NULL) {
+        return NULL;
+    }
+
+    jb->device = device;
+    jb->target_depth = JITTER_BUFFER_MIN_DEPTH;
+    return jb;
+}
+
+void jitter_buffer_destroy(jitter_buffer *jb) {
+    free(jb);
+}
+
+void jitter_buffer_reset(jitter_buffer *jb) {
+    for (uint32_t i = 0; i < JITTER_BUFFER_CAPACITY; i++) {
+        jb->slots[i].state = JITTER_SLOT_EMPTY;
+        jb->slots[i].frame_count = 0;
+        jb->slots[i].played = 0;
+    }
+
+    jb->has_serial = 0;
+    jb->playing = 0;
+    jb->head = 0;
+    jb->span = 0;
+    jb->count = 0;
+    jb->last_serial = 0;
+    jb->last_frames = 0;
+}
+
+static void jitter_buffer_advance(jitter_buffer *jb) {
+    jitter_buffer_slot *slot = &jb->slots[jb->head];
+    if (slot->state == JITTER_SLOT_FRAME) {
+        jb->count -= (uint32_t) (slot->frame_count - slot->played);
+    }
+    slot->state = JITTER_SLOT_EMPTY;
+    slot->frame_count = 0;
+    slot->played = 0;
+
+    jb->head = (jb->head + 1) & JITTER_BUFFER_MASK;
+    jb->next = serial_add(jb->next, 1);
+    if (jb->span > 0) {
+        jb->span--;
+    }
+}
+
+static void jitter_buffer_drop(jitter_buffer *jb, const uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        const jitter_buffer_slot *slot = &jb->slots[jb->head];
+        if (slot->state == JITTER_SLOT_FRAME) {
+            jb->stats.discarded += (uint32_t) (slot->frame_count - slot->played);
+        }
+        jitter_buffer_advance(jb);
+    }
+}
+
+/**
+ * @brief Drop the oldest buffered frame, if the next message to play has one left
+ */
+static void jitter_buffer_drop_frame(jitter_buffer *jb) {
+    jitter_buffer_slot *slot = &jb->slots[jb->head];
+    if (slot->state != JITTER_SLOT_FRAME) {
+        return;
+    }
+
+    jb->stats.discarded++;
+    jb->count--;
+    if (++slot->played == slot->frame_count) {
+        jitter_buffer_advance(jb);
+    }
+}
+
+static void jitter_buffer_update_jitter(jitter_buffer *jb, const uint16_t serial, const uint8_t frame,
+                                        const uint64_t now_ms) {
+    if (frame != 0) {
+        // a later frame of a message: it arrives with the first one
+        if (serial == jb->last_serial && frame >= jb->last_frames) {
+            jb->last_frames = (uint8_t) (frame + 1);
+        }
+        return;
+    }
+
+    if (jb->last_serial != 0) {
+        const int32_t frames = serial_diff(serial, jb->last_serial);
+        if (frames <= 0) {
+            // reordered or duplicate: measured against the newest frame only
+            return;
+        }
+
+        // RFC 3550: D = (arrival difference) - (send time difference), J += (|D| - J) / 16
+        // messages are sent as often as they carry frames: the newest one tells how many
+        const int64_t sent_ms = (int64_t) frames * (jb->last_frames != 0 ? jb->last_frames : 1) * AUDIO_FRAME_MS;
+        int64_t deviation = (int64_t) (now_ms - jb->last_arrival_ms) - sent_ms;
+        if (deviation < 0) deviation = -deviation;
+        if (deviation > JITTER_MAX_DEVIATION_MS) deviation = JITTER_MAX_DEVIATION_MS;
+        jb->jitter16 += (uint32_t) deviation - ((jb->jitter16 + 8) >> 4);
+
+        // enough depth to cover twice the mean deviation
+        uint32_t depth = JITTER_BUFFER_MIN_DEPTH + (2 * jitter_buffer_jitter_ms(jb) + AUDIO_FRAME_MS - 1) / AUDIO_FRAME_MS;
+        if (depth > JITTER_BUFFER_CAPACITY - 2) depth = JITTER_BUFFER_CAPACITY - 2;
+        jb->target_depth = depth;
+    }
+
+    jb->last_serial = serial;
+    jb->last_frames = 1;
+    jb->last_arrival_ms = now_ms;
+}
+
+void jitter_buffer_put(jitter_buffer *jb, const uint16_t serial, const uint8_t frame, const void *data,
+                       const uint16_t length, const uint64_t now_ms) {
+    if (serial == 0) {
+        // can't be ordered
+        jb->stats.discarded++;
+        return;
+    }
+    if (length > JITTER_FRAME_MAX) {
+        jb->stats.oversize++;
+        return;
+    }
+
+    jitter_buffer_update_jitter(jb, serial, frame, now_ms);
+
+    if (!jb->has_serial) {
+        jb->next = serial;
+        jb->has_serial = 1;
+    }
+
+    int32_t offset = serial_diff(serial, jb->next);
+    if (offset < 0) {
+        jb->stats.late++;
+        return;
+    }
+    if (offset >= JITTER_BUFFER_CAPACITY) {
+        // too far ahead: jump so the message lands in the last slot
+        jitter_buffer_drop(jb, (uint32_t) offset - JITTER_BUFFER_CAPACITY + 1);
+        offset = JITTER_BUFFER_CAPACITY - 1;
+    }
+
+    jitter_buffer_slot *slot = &jb->slots[(jb->head + (uint32_t) offset) & JITTER_BUFFER_MASK];
+    if (slot->state == JITTER_SLOT_FRAME) {
+        if (frame < slot->frame_count) {
+            jb->stats.duplicate++;
+            return;
+        }
+    } else if (slot->played != 0) {
+        // the message is already being concealed
+        jb->stats.late++;
+        return;
+    } else {
+        slot->state = JITTER_SLOT_FRAME;
+        slot->frame_count = 0;
+        slot->serial = serial;
+    }
+
+    const uint16_t start = slot->frame_count == 0 ? 0 : slot->ends[slot->frame_count - 1];
+    if (slot->frame_count == JITTER_SLOT_FRAMES || length > JITTER_SLOT_SIZE - start) {
+        jb->stats.oversize++;
+        if (slot->frame_count == 0) {
+            slot->state = JITTER_SLOT_EMPTY;
+        }
+        return;
+    }
+    memcpy(slot->data + start, data, length);
+    slot->ends[slot->frame_count++] = (uint16_t) (start + length);
+
+    jb->count++;
+    if ((uint32_t) offset + 1 > jb->span) {
+        jb->span = (uint32_t) offset + 1;
+    }
+    jb->stats.received++;
+}
+
+void jitter_buffer_skip(jitter_buffer *jb, const uint16_t serial) {
+    if (!jb->has_serial) {
+        return;
+    }
+
+    const int32_t offset = serial_diff(serial, jb->next);
+    if (offset < 0 || offset >= JITTER_BUFFER_CAPACITY) {
+        return;
+    }
+
+    jitter_buffer_slot *slot = &jb->slots[(jb->head + (uint32_t) offset) & JITTER_BUFFER_MASK];
+    if (slot->state == JITTER_SLOT_EMPTY) {
+        slot->state = JITTER_SLOT_SKIP;
+        slot->serial = serial;
+        if ((uint32_t) offset + 1 > jb->span) {
+            jb->span = (uint32_t) offset + 1;
+        }
+    }
+}
+
+jitter_buffer_result jitter_buffer_pop(jitter_buffer *jb, uint16_t *serial, const uint8_t **data,
+                                       uint16_t *length) {
+    if (!jb->playing) {
+        if (jb->count == 0 || jb->count < jb->target_depth) {
+            return kJitterWait;
+        }
+        jb->playing = 1;
+    }
+
+    while (1) {
+        if (jb->span == 0) {
+            // ran dry: buffer up to the target depth again
+            jb->stats.underruns++;
+            jb->playing = 0;
+            return kJitterWait;
+        }
+
+        jitter_buffer_slot *slot = &jb->slots[jb->head];
+        if (slot->state == JITTER_SLOT_SKIP) {
+            jitter_buffer_advance(jb);
+            continue;
+        }
+
+        *serial = jb->next;
+        if (slot->state == JITTER_SLOT_EMPTY) {
+            // a missing message lasts as many ticks as the newest one
+            jb->stats.lost++;
+            if (++slot->played >= (jb->last_frames != 0 ? jb->last_frames : 1)) {
+                jitter_buffer_advance(jb);
+            }
+            return kJitterLost;
+        }
+
+        // the slot keeps its data until a later frame is stored in it
+        const uint8_t frame = slot->played++;
+        const uint16_t start = frame == 0 ? 0 : slot->ends[frame - 1];
+        *data = slot->data + start;
+        *length = (uint16_t) (slot->ends[frame] - start);
+        jb->count--;
+        if (slot->played == slot->frame_count) {
+            jitter_buffer_advance(jb);
+        }
+        jb->stats.played++;
+
+        // well above target, beyond the swing of a message arriving: drop the oldest frame to bring latency down
+        if (jb->count > jb->target_depth + 1 + (jb->last_frames != 0 ? jb->last_frames : 1)) {
+            jitter_buffer_drop_frame(jb);
+        }
+        return kJitterFrame;
+    }
+}
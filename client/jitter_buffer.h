@@ -0,0 +1,130 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#define JITTER_BUFFER_CAPACITY 16       // frames, power of two
+#define JITTER_BUFFER_MIN_DEPTH 2       // frames buffered before playout starts
+#define JITTER_FRAME_MAX 1276           // largest Opus frame
+#define JITTER_SLOT_FRAMES 16           // frames of one message, as PARROT_AUDIO_MAX_FRAMES
+#define JITTER_SLOT_SIZE 1536           // frame bytes of one message: it fits in one datagram
+#define AUDIO_FRAME_MS 20               // playout interval
+
+typedef struct jitter_buffer_stats {
+    uint64_t received;      // frames stored
+    uint64_t played;        // frames handed to playout
+    uint64_t late;          // frames arriving after their playout time
+    uint64_t duplicate;     // frames already buffered
+    uint64_t lost;          // frames missing at playout time (to be concealed)
+    uint64_t underruns;     // playout ticks with nothing buffered
+    uint64_t discarded;     // frames dropped to shrink the buffer or jump ahead
+    uint64_t oversize;      // frames larger than JITTER_FRAME_MAX, or beyond the room of their message's slot
+} jitter_buffer_stats;
+
+typedef enum jitter_buffer_result {
+    kJitterWait = 0,        // nothing to play: (re)buffering
+    kJitterFrame,           // a frame is returned
+    kJitterLost,            // the next frame is missing, conceal it
+} jitter_buffer_result;
+
+/**
+ * @brief The frames of one message, back to back in data
+ */
+typedef struct jitter_buffer_slot {
+    uint8_t state;          // JITTER_SLOT_*
+    uint8_t frame_count;    // frames stored
+    uint8_t played;         // frames taken (or concealed) so far
+    uint16_t serial;
+    uint16_t ends[JITTER_SLOT_FRAMES];      // end of frame i in data, frame i starts at ends[i - 1] (0 for i = 0)
+    uint8_t data[JITTER_SLOT_SIZE];
+} jitter_buffer_slot;
+
+/**
+ * @brief Reorders the audio frames of one device by serial and plays them out at a steady pace.
+ *
+ * Slot i of the ring holds the message i positions after the next one to
+ * play, so storing and taking frames is O(1). A message may carry several
+ * frames: its slot keeps them all, and they play out in order, one per
+ * tick. Frames arriving after their playout time are dropped as late; a
+ * missing message is reported as lost, once per frame of the newest
+ * message, so the consumer can conceal it.
+ *
+ * Depths count frames. The target depth adapts to the interarrival jitter, estimated as in
+ * RFC 3550 (a running mean of transit time differences with gain 1/16).
+ * Playout waits until the target depth is buffered, and drops a frame when
+ * the buffer runs well above it, so latency follows the network.
+ *
+ * Serials are 15-bit and wrap from 32767 to 1. Non-audio messages share
+ * the serial space of a device; jitter_buffer_skip() marks their serials
+ * so they don't count as lost frames.
+ */
+typedef struct jitter_buffer {
+    uint32_t device;
+    uint8_t has_serial;     // next is valid
+    uint8_t playing;        // 0 while (re)buffering
+    uint16_t next;          // serial of the next message to play
+    uint32_t head;          // slot of next
+    uint32_t span;          // slots in use from head: offset of the newest message + 1
+    uint32_t count;         // frames buffered, not yet played
+    uint32_t target_depth;
+
+    // jitter estimate
+    uint16_t last_serial;
+    uint8_t last_frames;    // frames of the newest message: the number of ticks a message lasts
+    uint64_t last_arrival_ms;
+    uint32_t jitter16;      // mean deviation in 1/16 ms
+
+    jitter_buffer_stats stats;
+    jitter_buffer_slot slots[JITTER_BUFFER_CAPACITY];
+} jitter_buffer;
+
+/**
+ * @brief Allocate an empty jitter buffer
+ * @return Jitter buffer, NULL for failure
+ */
+jitter_buffer *jitter_buffer_create(uint32_t device);
+
+/**
+ * @brief Release a jitter buffer
+ */
+void jitter_buffer_destroy(jitter_buffer *jb);
+
+/**
+ * @brief Drop every buffered frame and wait for a new stream. Statistics are kept.
+ */
+void jitter_buffer_reset(jitter_buffer *jb);
+
+/**
+ * @brief Store a received frame
+ * @param serial [in] serial of the message carrying the frame
+ * @param frame [in] index of the frame in its message, frames of a message are put in order
+ * @param now_ms [in] arrival time
+ */
+void jitter_buffer_put(jitter_buffer *jb, uint16_t serial, uint8_t frame, const void *data, uint16_t length,
+                       uint64_t now_ms);
+
+/**
+ * @brief Mark a serial as used by a non-audio message
+ */
+void jitter_buffer_skip(jitter_buffer *jb, uint16_t serial);
+
+/**
+ * @brief Take the next frame to play. Call once per AUDIO_FRAME_MS.
+ * @param serial [out] serial of the message of the frame, for kJitterFrame and kJitterLost
+ * @param data [out] frame data for kJitterFrame, valid until the next call on the buffer
+ * @param length [out] frame length for kJitterFrame
+ */
+jitter_buffer_result jitter_buffer_pop(jitter_buffer *jb, uint16_t *serial, const uint8_t **data, uint16_t *length);
+
+/**
+ * @return Interarrival jitter estimate in milliseconds
+ */
+static inline uint32_t jitter_buffer_jitter_ms(const jitter_buffer *jb) {
+    return jb->jitter16 >> 4;
+}
+
+#if __cplusplus
+}
+#endif
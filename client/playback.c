@@ -0,0 +1,69 @@
+#include "playback.h"
+
+#include <string.h>
+#include <time.h>
+
+#define PLAYBACK_IDLE_SLEEP_NS 1000000
+
+static void playback_play(playback *p, const audio_frame *frame) {
+    switch (frame->type) {
+        case AUDIO_RING_FRAME:
+            p->stats.frames++;
+            p->stats.bytes += frame->length;
+            break;
+        case AUDIO_RING_LOST:
+            p->stats.concealed++;
+            break;
+        default:
+            p->stats.events++;
+            break;
+    }
+
+    if (p->ring != NULL
+        && audio_ring_write(p->ring, frame->type, frame->device, frame->serial, frame->data, frame->length) != 0) {
+        p->stats.dropped++;
+    }
+}
+
+static uint32_t playback_drain(playback *p) {
+    uint32_t played = 0;
+    for (uint32_t i = 0; i < p->queue_count; i++) {
+        const audio_frame *frame;
+        while ((frame = spsc_queue_front(p->queues[i])) != NULL) {
+            playback_play(p, frame);
+            spsc_queue_pop(p->queues[i]);
+            ++played;
+        }
+    }
+    return played;
+}
+
+static void playback_main(void *arg) {
+    playback *p = arg;
+    const struct timespec idle = {0, PLAYBACK_IDLE_SLEEP_NS};
+
+    while (!__atomic_load_n(&p->stopped, __ATOMIC_ACQUIRE)) {
+        if (playback_drain(p) == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    playback_drain(p);
+}
+
+int playback_start(playback *p, spsc_queue *const *queues, const uint32_t count, audio_ring *ring) {
+    memset(p, 0, sizeof(*p));
+    if (count > WORKER_MAX_COUNT) {
+        return -1;
+    }
+
+    memcpy(p->queues, queues, count * sizeof(spsc_queue *));
+    p->queue_count = count;
+    p->ring = ring;
+    return worker_start(&p->thread, 0, -1, playback_main, p);
+}
+
+void playback_stop(playback *p) {
+    __atomic_store_n(&p->stopped, 1, __ATOMIC_RELEASE);
+    worker_join(&p->thread);
+}
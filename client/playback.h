@@ -0,0 +1,72 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#include "../net/spsc_queue.h"
+#include "../net/worker.h"
+#include "audio_ring.h"
+#include "jitter_buffer.h"
+
+/**
+ * @brief One frame or event handed from a network worker to the playback thread
+ */
+typedef struct audio_frame {
+    uint8_t type;           // AUDIO_RING_FRAME, AUDIO_RING_LOST, AUDIO_RING_START or AUDIO_RING_STOP
+    uint16_t serial;
+    uint32_t device;
+    uint16_t length;        // data length, AUDIO_RING_FRAME only
+    uint8_t data[JITTER_FRAME_MAX];
+} audio_frame;
+
+typedef struct playback_stats {
+    uint64_t frames;        // frames played
+    uint64_t concealed;     // lost frames concealed
+    uint64_t bytes;         // encoded bytes played
+    uint64_t events;        // start/stop events
+    uint64_t dropped;       // records the audio ring had no room for
+} playback_stats;
+
+/**
+ * @brief Playback thread: consumes the audio frames the network workers play out.
+ *
+ * Every worker has its own SPSC queue of audio_frame, so workers never wait
+ * for audio output; when a queue is full the worker drops the frame. The
+ * thread drains the queues into the audio sink, a shared-memory ring read by
+ * an external player process (see audio_ring.h), and sleeps briefly when all
+ * queues are empty. Without a ring, frames are only counted.
+ *
+ * A frame is copied three times before the player sees it: from the
+ * datagram into its jitter buffer slot, from the slot into the worker's
+ * queue, and from the queue into the ring. The slot and queue copies let
+ * the worker reuse its buffers without waiting for this thread. The player
+ * then reads the ring in place.
+ */
+typedef struct playback {
+    worker thread;
+    spsc_queue *queues[WORKER_MAX_COUNT];
+    uint32_t queue_count;
+    audio_ring *ring;       // NULL for none
+    uint8_t stopped;
+    playback_stats stats;   // owned by the playback thread until playback_stop() returns
+} playback;
+
+/**
+ * @brief Start the playback thread
+ * @param queues [in] audio_frame queues, one per producer
+ * @param count [in] number of queues
+ * @param ring [in] producer side of the audio ring to publish into, NULL for none
+ * @return 0 for success, -1 for failure
+ */
+int playback_start(playback *p, spsc_queue *const *queues, uint32_t count, audio_ring *ring);
+
+/**
+ * @brief Drain the queues and stop the playback thread
+ */
+void playback_stop(playback *p);
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,126 @@
+#include "transaction_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t transaction_hash(const uint32_t device, const uint16_t serial) {
+    // combine, then the murmur3 finalizer: the table masks the low bits, which a product alone
+    // leaves blind to the high bits of the device code
+    uint32_t h = device ^ serial * 0x9E3779B1u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+int transaction_table_init(transaction_table *table, const uint32_t device_count) {
+    memset(table, 0, sizeof(*table));
+
+    // one transaction per device at most: the load factor stays at or below 1/2
+    uint32_t capacity = 16;
+    while (capacity < device_count * 2) {
+        capacity <<= 1;
+    }
+
+    table->slots = calloc(capacity, sizeof(transaction));
+    if (table->slots == NULL) {
+        return -1;
+    }
+    table->mask = capacity - 1;
+    table->rtt.rto_ms = TRANSACTION_RTO_INITIAL_MS;
+    return 0;
+}
+
+void transaction_table_destroy(transaction_table *table) {
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+transaction *transaction_table_find(const transaction_table *table, const uint32_t device, const uint16_t serial) {
+    if (device == 0 || table->slots == NULL) {
+        return NULL;
+    }
+
+    uint32_t index = transaction_hash(device, serial) & table->mask;
+    while (1) {
+        transaction *t = &table->slots[index];
+        if (t->device == 0) {
+            return NULL;
+        }
+        if (t->device == device && t->serial == serial) {
+            return t;
+        }
+        index = (index + 1) & table->mask;
+    }
+}
+
+transaction *transaction_table_insert(transaction_table *table, const uint32_t device, const uint16_t serial,
+                                      const uint16_t command, const uint64_t sent_ns) {
+    if (device == 0 || table->slots == NULL || table->count == table->mask) {
+        // one slot stays free, so probes end
+        return NULL;
+    }
+
+    uint32_t index = transaction_hash(device, serial) & table->mask;
+    while (table->slots[index].device != 0
+           && (table->slots[index].device != device || table->slots[index].serial != serial)) {
+        index = (index + 1) & table->mask;
+    }
+
+    transaction *t = &table->slots[index];
+    if (t->device == 0) {
+        ++table->count;
+    }
+    t->device = device;
+    t->serial = serial;
+    t->command = command;
+    t->sent_ns = sent_ns;
+    return t;
+}
+
+void transaction_table_remove(transaction_table *table, transaction *t) {
+    // backward shift deletion: move up the following entries of the run that probed past this slot
+    uint32_t hole = (uint32_t) (t - table->slots);
+    uint32_t index = hole;
+    while (1) {
+        index = (index + 1) & table->mask;
+        const transaction *next = &table->slots[index];
+        if (next->device == 0) {
+            break;
+        }
+        const uint32_t home = transaction_hash(next->device, next->serial) & table->mask;
+        // the entry may move to the hole if its home isn't cyclically within (hole, index]
+        if (((index - home) & table->mask) >= ((index - hole) & table->mask)) {
+            table->slots[hole] = *next;
+            hole = index;
+        }
+    }
+
+    memset(&table->slots[hole], 0, sizeof(transaction));
+    --table->count;
+}
+
+void rtt_estimator_sample(rtt_estimator *rtt, const uint64_t rtt_ns) {
+    const uint32_t r = rtt_ns / 1000 < UINT32_MAX / 8 ? (uint32_t) (rtt_ns / 1000) : UINT32_MAX / 8;
+    if (rtt->samples++ == 0) {
+        rtt->srtt_us = r;
+        rtt->rttvar_us = r / 2;
+    } else {
+        // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R
+        const uint32_t delta = rtt->srtt_us > r ? rtt->srtt_us - r : r - rtt->srtt_us;
+        rtt->rttvar_us = rtt->rttvar_us - rtt->rttvar_us / 4 + delta / 4;
+        rtt->srtt_us = rtt->srtt_us - rtt->srtt_us / 8 + r / 8;
+    }
+
+    const uint64_t rto_ms = ((uint64_t) rtt->srtt_us + 4 * (uint64_t) rtt->rttvar_us + 999) / 1000;
+    rtt->rto_ms = rto_ms < TRANSACTION_RTO_MIN_MS ? TRANSACTION_RTO_MIN_MS
+                  : rto_ms > TRANSACTION_RTO_MAX_MS ? TRANSACTION_RTO_MAX_MS
+                  : (uint32_t) rto_ms;
+}
+
+uint32_t rtt_estimator_timeout(const rtt_estimator *rtt, const uint32_t attempt, const uint32_t max_ms) {
+    const uint64_t timeout = attempt < 16 ? (uint64_t) rtt->rto_ms << attempt : UINT64_MAX;
+    return timeout < max_ms ? (uint32_t) timeout : max_ms;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#define TRANSACTION_RTO_INITIAL_MS 1000    // before the first RTT sample
+#define TRANSACTION_RTO_MIN_MS 200
+#define TRANSACTION_RTO_MAX_MS 60000
+
+/**
+ * @brief A request waiting for its response
+ */
+typedef struct transaction {
+    uint32_t device;        // device code, 0 for a free slot
+    uint16_t serial;        // serial of the request, echoed by the response
+    uint16_t command;       // command of the request
+    uint64_t sent_ns;       // CLOCK_MONOTONIC
+} transaction;
+
+/**
+ * @brief Retransmission timeout from smoothed RTT and RTT variance, as TCP computes it (RFC 6298)
+ */
+typedef struct rtt_estimator {
+    uint32_t samples;
+    uint32_t srtt_us;       // smoothed RTT
+    uint32_t rttvar_us;     // RTT variance
+    uint32_t rto_ms;        // in [TRANSACTION_RTO_MIN_MS, TRANSACTION_RTO_MAX_MS]
+} rtt_estimator;
+
+/**
+ * @brief Open-addressing (linear probing) table of pending requests keyed by (device code, serial).
+ *
+ * Slots are fixed-size and allocated once: a device has at most one request
+ * in flight, since a retransmission goes out with a new serial and replaces
+ * the transaction it retries. So each response is matched to the very
+ * transmission it answers, and every match is a valid RTT sample (no
+ * retransmission ambiguity, which TCP resolves with Karn's algorithm).
+ */
+typedef struct transaction_table {
+    transaction *slots;
+    uint32_t mask;          // capacity - 1
+    uint32_t count;
+    rtt_estimator rtt;      // shared by all devices: they talk to the same server
+} transaction_table;
+
+/**
+ * @brief Allocate a table for the given number of devices
+ * @return 0 for success, -1 for failure
+ */
+int transaction_table_init(transaction_table *table, uint32_t device_count);
+
+/**
+ * @brief Release table storage
+ */
+void transaction_table_destroy(transaction_table *table);
+
+/**
+ * @brief Find the pending transaction of a request
+ * @return Transaction, NULL if none is pending
+ */
+transaction *transaction_table_find(const transaction_table *table, uint32_t device, uint16_t serial);
+
+/**
+ * @brief Track a request sent
+ * @return Transaction, NULL if device is 0 or the table is full
+ */
+transaction *transaction_table_insert(transaction_table *table, uint32_t device, uint16_t serial, uint16_t command,
+                                      uint64_t sent_ns);
+
+/**
+ * @brief Remove a transaction returned by transaction_table_find() or transaction_table_insert()
+ */
+void transaction_table_remove(transaction_table *table, transaction *t);
+
+/**
+ * @brief Update the RTT estimate with the RTT of a matched response
+ */
+void rtt_estimator_sample(rtt_estimator *rtt, uint64_t rtt_ns);
+
+/**
+ * @brief Timeout of a request, doubled for every retransmission
+ * @param attempt [in] transmissions before this one
+ * @return min(rto << attempt, max_ms) in milliseconds
+ */
+uint32_t rtt_estimator_timeout(const rtt_estimator *rtt, uint32_t attempt, uint32_t max_ms);
+
+#if __cplusplus
+}
+#endif
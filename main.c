@@ -1,376 +1,307 @@
+#include <getopt.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
-#include <sys/select.h>
-#include <fcntl.h>
 #include <string.h>
-#include <errno.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#include <unistd.h>
 
-#include "proto/c_string.h"
-#include "proto/parrot_message.h"
-#include "proto/parrot_payload.h"
+#include "net/logger.h"
+#include "net/udp_io.h"
+#include "net/metrics.h"
+#include "net/spsc_queue.h"
+#include "net/worker.h"
+#include "client/client_worker.h"
+#include "client/device_table.h"
+#include "client/playback.h"
 
 static const char *host = "";
 static uint16_t port = 18029;
-static int sock = -1;
-static parrot_bool is_logged_in = parrot_false;
-static const uint32_t device_id = 0xC1C2C3C4;
-static uint16_t serial = 0;
-
-static int audio_frame_count = 0;
-static time_t last_keep_alive_time = 0;
-static volatile uint8_t exit_flag = 0;
-static int exit_value = 0;
+static udp_io_backend io_backend = kUdpIoBatch;
+static const char *devices_path = NULL;
+static uint32_t worker_count = 1;
+static int cpus[WORKER_MAX_COUNT];
+static int cpu_count = 0;
+static client_worker *workers = NULL;
+static playback player;
+static const char *audio_ring_path = NULL;
+static audio_ring ring;
+static const char *capture_path = NULL;
+static const char *metrics_path = NULL;
+static metrics_server metrics;
+
+#define DEFAULT_DEVICE_ID 0xC1C2C3C4
+#define AUDIO_RING_CAPACITY (1024 * 1024)
 
-int create_udp_socket(int local_port);
-int connect_udp_socket();
-void send_register_request();
-void read_udp_messages();
-void routine_check();
+static int exit_value = 0;
 
 void on_interrupt(const int sig) {
     (void)sig;
 
-    exit_flag = 1;
-}
-
-
-int main(const int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <host> [port]\n", argv[0]);
-        return 1;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        event_loop_stop(&workers[i].loop);
     }
+}
 
-    signal(SIGINT, on_interrupt);
-    signal(SIGPIPE, SIG_IGN);
-
-    host = argv[1];
-    if (argc > 2) port = (uint16_t) strtol(argv[2], NULL, 10);
+static void render_metrics(FILE *out, void *user_data) {
+    (void) user_data;
 
-    // listen on udp
-    sock = create_udp_socket(9802);
-    if (sock < 0) {
-        fprintf(stderr, "Failed to create UDP socket\n");
-        return 1;
+    const client_metrics *worker_metrics[WORKER_MAX_COUNT];
+    for (uint32_t i = 0; i < worker_count; i++) {
+        worker_metrics[i] = &workers[i].metrics;
     }
+    client_metrics_render(out, worker_metrics, worker_count);
+}
 
-    int n = connect_udp_socket();
-    if (n < 0) {
-        close(sock);
-        fprintf(stderr, "Failed to connect UDP socket\n");
-        return 1;
-    }
-
-    // event loop
-    time_t last_check_time = time(NULL);
-    send_register_request();
-    while (!exit_flag) {
-        fd_set read_fds;
-        struct timeval timeout;
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
-
-        FD_ZERO(&read_fds);
-        FD_SET(sock, &read_fds);
-        n = select(sock + 1, &read_fds, NULL, NULL, &timeout);
-        if (n > 0) {
-            read_udp_messages();
-        }
-
-        const time_t now = time(NULL);
-        if (now > last_check_time) {
-            routine_check(); // periodic status check
-            last_check_time = now;
+static int setup_worker(client_worker *w, const uint32_t index) {
+    char path[256];
+    client_worker_options options = {host, port, io_backend, NULL};
+    if (capture_path != NULL) {
+        // a trace has one writer
+        if (index == 0) {
+            snprintf(path, sizeof(path), "%s", capture_path);
+        } else {
+            snprintf(path, sizeof(path), "%s.%u", capture_path, index);
         }
+        options.capture_path = path;
     }
 
-    return exit_value;
+    w->thread.cpu = cpu_count > 0 ? cpus[index % (uint32_t) cpu_count] : -1;
+    return client_worker_init(w, index, &options);
 }
 
-void send_keep_alive() {
-    printf("send keep alive\n");
-    parrot_message msg;
-    memset(&msg, 0, sizeof(parrot_message));
-    msg.command = 0x03; // Keep-alive request
-    msg.device = device_id;
-    msg.serial = ++serial;
-
-    char buf[512];
-    const uint16_t n = parrot_message_serialize(buf, sizeof(buf), &msg, parrot_true);
-    const ssize_t ret = send(sock, buf, n, 0);
-    if (ret < 0) {
-        perror("send");
-    }
+static void usage(const char *program) {
+    printf("Usage: %s [options] <host> [port]\n", program);
+    printf("  --devices FILE  host the devices listed in FILE, one per line: <device code> [client ip] [volume]\n");
+    printf("  --io-uring      receive and send with io_uring (falls back to recvmmsg/sendmmsg)\n");
+    printf("  --workers N     split the devices over N threads, each with its own socket on local port %d + i\n",
+           CLIENT_LOCAL_PORT);
+    printf("  --cpus LIST     pin worker i to the i-th CPU of LIST, e.g. 0,2,4-7\n");
+    printf("  --audio-ring NAME\n");
+    printf("                  publish audio frames and start/stop events to the shared memory ring NAME (e.g. /parrot-audio)\n");
+    printf("  --capture FILE  record every datagram sent and received into the trace FILE (FILE.<i> for worker i > 0),\n");
+    printf("                  for parrot-replay\n");
+    printf("  --metrics PATH  serve metrics in the Prometheus text format on the Unix socket PATH\n");
+    printf("  --log-level LEVEL\n");
+    printf("                  log messages of LEVEL and above: debug, info (default), warn or error\n");
 }
 
-void routine_check() {
-    if (!is_logged_in) {
-        send_register_request();
-    } else {
-        const time_t now = time(NULL);
-        if (now > last_keep_alive_time + 30) {
-            last_keep_alive_time = now;
-            send_keep_alive();
-        }
-    }
-
-    if (audio_frame_count != 0) {
-        printf("audio frame count %d\n", audio_frame_count);
-        audio_frame_count = 0;
-    }
+static uint32_t worker_of(const uint32_t device) {
+    // a different mix than the table slot hash, so a shard's keys still spread over its table
+    return (uint32_t) (((uint64_t) (device * 0x85EBCA6Bu) * worker_count) >> 32);
 }
 
-
-static void on_audio_notify(const void *payload, const uint16_t len) {
-    payload_parse parse;
-    parrot_payload_parse_init(&parse, payload, len);
-
-    payload_entry entry;
-
-    while (parse.pos < parse.length) {
-        if (!parrot_payload_parse_entry(&entry, &parse))
-            break;
-
-        if (entry.key == 1 && entry.is_string) {
-            printf("opus frame: %d bytes\n", entry.value.str.length);
-        }
+static int load_devices() {
+    device_table all;
+    if (device_table_init(&all, 1) != 0) {
+        return -1;
     }
-}
-
-static void on_volume_notify(const void *payload, const uint16_t len) {
-    payload_parse parse;
-    parrot_payload_parse_init(&parse, payload, len);
-
-    payload_entry entry;
-
-    int audio_dev_id = 0;
-    int volume = 0;
-
-
-    while (parse.pos < parse.length) {
-        if (!parrot_payload_parse_entry(&entry, &parse))
-            break;
 
-        if (entry.key == 1) audio_dev_id = (int) entry.value.i64;
-        if (entry.key == 2) volume = (int) entry.value.i64;
+    if (devices_path == NULL) {
+        if (device_table_insert(&all, DEFAULT_DEVICE_ID) == NULL) {
+            device_table_destroy(&all);
+            return -1;
+        }
+    } else {
+        const int n = device_table_load(&all, devices_path);
+        if (n <= 0) {
+            fprintf(stderr, "No devices loaded from %s\n", devices_path);
+            device_table_destroy(&all);
+            return -1;
+        }
+        printf("loaded %d devices from %s\n", n, devices_path);
     }
 
-    printf("volume notify id=%d value=%d\n", audio_dev_id, volume);
-}
-
-static void on_status_notify(const void *payload, const uint16_t len) {
-    payload_parse parse;
-    parrot_payload_parse_init(&parse, payload, len);
-
-    payload_entry entry;
-
-    int code = 0;
-    const char *message_data = "";
-    uint16_t message_len = 0;
-
-    while (parse.pos < parse.length) {
-        if (!parrot_payload_parse_entry(&entry, &parse))
-            break;
-
-        if (entry.key == 1) {
-            code = (int) entry.value.i64;
-        } else if (entry.key == 2) {
-            message_data = entry.value.str.data;
-            message_len = entry.value.str.length;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        if (device_table_init(&workers[i].devices, all.count / worker_count + 1) != 0) {
+            device_table_destroy(&all);
+            return -1;
         }
     }
 
-    printf("online status=%d message=%.*s\n", code, message_len, message_data);
-}
-
-static void on_register_res(const void *payload, const uint16_t len) {
-    payload_parse parse;
-    parrot_payload_parse_init(&parse, payload, len);
-
-    payload_entry entry;
-
-    int code = 0;
-    const char *message_data = "";
-    uint16_t message_len = 0;
-
-    while (parse.pos < parse.length) {
-        if (!parrot_payload_parse_entry(&entry, &parse))
-            break;
+    const uint32_t capacity = device_table_capacity(&all);
+    for (uint32_t i = 0; i < capacity; i++) {
+        const device_session *src = device_table_at(&all, i);
+        if (src == NULL) {
+            continue;
+        }
 
-        if (entry.key == 1) {
-            code = (int) entry.value.i64;
-        } else if (entry.key == 2) {
-            message_data = entry.value.str.data;
-            message_len = entry.value.str.length;
+        device_session *dst = device_table_insert(&workers[worker_of(src->device)].devices, src->device);
+        if (dst == NULL) {
+            device_table_destroy(&all);
+            return -1;
         }
+        dst->volume = src->volume;
+        memcpy(dst->client_ip, src->client_ip, sizeof(dst->client_ip));
     }
 
-    printf("Register status=%d message=%.*s\n", code, message_len, message_data);
-    is_logged_in = parrot_true;
+    device_table_destroy(&all);
+    return 0;
 }
 
-static void handle_udp_message(const void *data, const int length) {
-    parrot_message msg;
-    const parrot_bool ok = parrot_message_parse(&msg, data, length);
-    if (!ok) {
-        fprintf(stderr, "corrupted udp message.\n");
-        return;
+int main(const int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"devices", required_argument, NULL, 'd'},
+        {"io-uring", no_argument, NULL, 'u'},
+        {"workers", required_argument, NULL, 'w'},
+        {"cpus", required_argument, NULL, 'c'},
+        {"audio-ring", required_argument, NULL, 'a'},
+        {"capture", required_argument, NULL, 'C'},
+        {"metrics", required_argument, NULL, 'm'},
+        {"log-level", required_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:uw:c:a:C:m:l:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'd':
+                devices_path = optarg;
+                break;
+            case 'u':
+                io_backend = kUdpIoUring;
+                break;
+            case 'w':
+                worker_count = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                audio_ring_path = optarg;
+                break;
+            case 'C':
+                capture_path = optarg;
+                break;
+            case 'm':
+                metrics_path = optarg;
+                break;
+            case 'l':
+                if (logger_parse_level(optarg, &logger_level) != 0) {
+                    fprintf(stderr, "bad log level: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                cpu_count = worker_parse_cpu_list(optarg, cpus, WORKER_MAX_COUNT);
+                if (cpu_count <= 0) {
+                    fprintf(stderr, "bad cpu list: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
     }
 
-    switch (msg.command) {
-        case 0x02: // Register response
-            on_register_res(msg.payload_data, msg.payload_len);
-            break;
-        case 0x04:
-            printf("keep-alive response received\n");
-            break;
-        case 0x40:
-            on_status_notify(msg.payload_data, msg.payload_len);
-            break;
-        case 0x41:
-            on_audio_notify(msg.payload_data, msg.payload_len);
-            break;
-        case 0x42:
-            printf("start play notify\n");
-            break;
-        case 0x43:
-            printf("stop play notify\n");
-            break;
-        case 0x44:
-            on_volume_notify(msg.payload_data, msg.payload_len);
-            break;
-        default:
-            break;
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
     }
-}
-
-void read_udp_messages() {
-    struct sockaddr_in addr;
-    socklen_t addr_len = sizeof(addr);
-    char read_buf[1500];
-    while (1) {
-        const int n = (int) recvfrom(sock, read_buf, sizeof(read_buf), 0,
-                                     (struct sockaddr*) &addr,
-                                     &addr_len);
-        if (n > 0) {
-            handle_udp_message(read_buf, n);
-            continue;
-        }
 
-        if (n == -1) {
-            if (errno == EINTR) {
-                continue;
-            }
+    if (worker_count == 0) worker_count = worker_cpu_count();
+    if (worker_count > WORKER_MAX_COUNT) worker_count = WORKER_MAX_COUNT;
 
-            if (errno != EAGAIN) {
-                fprintf(stderr, "recvfrom: %s\n", strerror(errno));
-            }
-            return;
-        }
+    workers = calloc(worker_count, sizeof(client_worker));
+    if (workers == NULL) {
+        fprintf(stderr, "Failed to allocate workers\n");
+        return 1;
     }
-}
-
-void send_register_request() {
-    c_string payload;
-    memset(&payload, 0, sizeof(payload));
-    // field #1 client_ip       (string)
-    // field #2 client_version  (string)
-    // field #3 ao_volume       (integer)
-    parrot_payload_put_string(&payload, 1, "192.168.124.130",  -1);
-    parrot_payload_put_string(&payload, 2, "1.0.1", -1);
-    parrot_payload_put_integer(&payload, 3, 100);
-
-    printf("send register request\n");
-    parrot_message msg;
-    memset(&msg, 0, sizeof(parrot_message));
-    msg.command = 0x01; // Register request
-    msg.device = device_id;
-    msg.serial = ++serial;
-    msg.payload_data = payload.data;
-    msg.payload_len = payload.length;
-
-
-    char buf[512];
-    const uint16_t n = parrot_message_serialize(buf, sizeof(buf), &msg, parrot_true);
-    const ssize_t ret = send(sock, buf, n, 0);
-    if (ret < 0) {
-        perror("send");
+    for (uint32_t i = 0; i < worker_count; i++) {
+        client_worker_reset(&workers[i]);
     }
 
-    c_string_hard_clear(&payload);
-}
-
-static int ensure_nonblock(const int fd) {
-    uint32_t fl = fcntl(fd, F_GETFL, 0);
-    if (fl == 0xFFFFFFFFu) {
-        fprintf(stderr, "fcntl(%d, F_GETFL, 0): %s\n", fd, strerror(errno));
-        return -1;
-    }
+    signal(SIGINT, on_interrupt);
+    signal(SIGPIPE, SIG_IGN);
 
-    if ((fl & O_NONBLOCK) != 0) {
-        return 0;
+    if (load_devices() != 0) {
+        fprintf(stderr, "Failed to load devices\n");
+        exit_value = 1;
     }
 
-    fl |= (uint32_t) O_NONBLOCK;
+    host = argv[optind];
+    if (optind + 1 < argc) port = (uint16_t) strtol(argv[optind + 1], NULL, 10);
 
-    const int ret = fcntl(fd, F_SETFL, fl);
-    if (ret == -1) {
-        fprintf(stderr, "fcntl(%d, F_SETFL, 0): %s", fd, strerror(errno));
-        return -1;
+    for (uint32_t i = 0; exit_value == 0 && i < worker_count; i++) {
+        if (setup_worker(&workers[i], i) != 0) {
+            exit_value = 1;
+        }
     }
 
-    return 0;
-}
-
-int connect_udp_socket(void) {
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
+    if (exit_value == 0) {
+        printf("udp io: %s, %u workers\n", udp_io_backend_name(&workers[0].io), worker_count);
 
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    inet_aton(host, &addr.sin_addr);
+        spsc_queue *queues[WORKER_MAX_COUNT];
+        for (uint32_t i = 0; i < worker_count; i++) {
+            queues[i] = &workers[i].audio_queue;
+        }
+        if (audio_ring_path != NULL) {
+            if (audio_ring_create(&ring, audio_ring_path, AUDIO_RING_CAPACITY) != 0) {
+                fprintf(stderr, "Failed to create audio ring %s\n", audio_ring_path);
+                exit_value = 1;
+            } else {
+                printf("audio ring: %s, %u bytes\n", audio_ring_path, ring.capacity);
+            }
+        }
+        if (exit_value == 0 && metrics_path != NULL) {
+            if (metrics_server_start(&metrics, metrics_path, render_metrics, NULL) != 0) {
+                fprintf(stderr, "Failed to serve metrics on %s\n", metrics_path);
+                exit_value = 1;
+            } else {
+                printf("metrics: %s\n", metrics_path);
+            }
+        }
+        if (exit_value == 0 && logger_start() != 0) {
+            fprintf(stderr, "Failed to start logger\n");
+            exit_value = 1;
+        }
+        if (exit_value == 0 && playback_start(&player, queues, worker_count,
+                                              audio_ring_path != NULL ? &ring : NULL) != 0) {
+            fprintf(stderr, "Failed to start playback\n");
+            exit_value = 1;
+        }
 
-    const int n = connect(sock, (struct sockaddr*) &addr, sizeof(addr));
-    if (n < 0) {
-        perror("connect");
-        close(sock);
-        sock = -1;
-        return -1;
-    }
+        // worker 0 runs on the main thread, which also takes the signals
+        uint32_t started = 1;
+        while (exit_value == 0 && started < worker_count
+               && worker_start(&workers[started].thread, started, workers[started].thread.cpu, client_worker_run,
+                               &workers[started]) == 0) {
+            ++started;
+        }
 
-    return 0;
-}
+        if (started < worker_count) {
+            exit_value = 1;
+        } else {
+            if (workers[0].thread.cpu >= 0) worker_pin_current(workers[0].thread.cpu);
+            client_worker_run(&workers[0]);
+        }
 
-int create_udp_socket(const int local_port) {
-    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sock < 0) {
-        perror("socket");
-        return sock;
-    }
+        // stop every loop, whichever way the main one ended
+        on_interrupt(SIGINT);
+        for (uint32_t i = 1; i < started; i++) {
+            worker_join(&workers[i].thread);
+        }
 
-    // bind to local port
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(local_port);
-    if (0 != bind(sock, (struct sockaddr*) &addr, sizeof(addr))) {
-        perror("bind");
-        close(sock);
-        sock = -1;
-        return sock;
+        metrics_server_stop(&metrics);
+        playback_stop(&player);
+        logger_stop();
+        const logger_stats log_stats = logger_get_stats();
+        if (log_stats.dropped != 0 || log_stats.suppressed != 0) {
+            printf("log: %llu records written, %llu dropped, %llu suppressed by rate limits\n",
+                   (unsigned long long) log_stats.written, (unsigned long long) log_stats.dropped,
+                   (unsigned long long) log_stats.suppressed);
+        }
+        if (player.stats.frames != 0 || player.stats.concealed != 0 || player.stats.events != 0) {
+            printf("playback: %llu frames, %llu bytes, %llu concealed, %llu events, %llu dropped by the ring\n",
+                   (unsigned long long) player.stats.frames, (unsigned long long) player.stats.bytes,
+                   (unsigned long long) player.stats.concealed, (unsigned long long) player.stats.events,
+                   (unsigned long long) player.stats.dropped);
+        }
+        audio_ring_close(&ring);
     }
 
-    const int n = ensure_nonblock(sock);
-    if (n != 0) {
-        close(sock);
-        sock = -1;
-        return sock;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        client_worker_destroy(&workers[i]);
     }
+    free(workers);
 
-
-    return sock;
+    return exit_value;
 }
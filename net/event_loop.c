@@ -0,0 +1,207 @@
+#include "event_loop.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+uint64_t event_loop_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000u + (uint64_t) ts.tv_nsec / 1000000u;
+}
+
+static event_handler *event_loop_find(event_loop *loop, const int fd) {
+    for (int i = 0; i < EVENT_LOOP_MAX_HANDLERS; i++) {
+        if (loop->handlers[i].fd == fd) {
+            return &loop->handlers[i];
+        }
+    }
+    return NULL;
+}
+
+static event_handler *event_loop_register(event_loop *loop, const int fd, const uint32_t epoll_events) {
+    event_handler *handler = event_loop_find(loop, -1);
+    if (handler == NULL) {
+        fprintf(stderr, "event loop: too many handlers\n");
+        return NULL;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = epoll_events;
+    ev.data.ptr = handler;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        fprintf(stderr, "epoll_ctl(%d, ADD): %s\n", fd, strerror(errno));
+        return NULL;
+    }
+
+    memset(handler, 0, sizeof(*handler));
+    handler->fd = fd;
+    return handler;
+}
+
+int event_loop_init(event_loop *loop) {
+    memset(loop, 0, sizeof(*loop));
+    for (int i = 0; i < EVENT_LOOP_MAX_HANDLERS; i++) {
+        loop->handlers[i].fd = -1;
+    }
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    loop->now_ms = event_loop_clock_ms();
+    return 0;
+}
+
+void event_loop_destroy(event_loop *loop) {
+    for (int i = 0; i < EVENT_LOOP_MAX_HANDLERS; i++) {
+        if (loop->handlers[i].fd >= 0 && loop->handlers[i].is_timer) {
+            close(loop->handlers[i].fd);
+        }
+        loop->handlers[i].fd = -1;
+    }
+
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+}
+
+int event_loop_add_fd(event_loop *loop, const int fd, const uint32_t events, const event_io_callback callback,
+                      void *user_data) {
+    uint32_t epoll_events = EPOLLET;
+    if (events & EVENT_READ) epoll_events |= EPOLLIN;
+    if (events & EVENT_WRITE) epoll_events |= EPOLLOUT;
+
+    event_handler *handler = event_loop_register(loop, fd, epoll_events);
+    if (handler == NULL) {
+        return -1;
+    }
+
+    handler->on_io = callback;
+    handler->user_data = user_data;
+    return 0;
+}
+
+void event_loop_del_fd(event_loop *loop, const int fd) {
+    event_handler *handler = event_loop_find(loop, fd);
+    if (handler == NULL || fd < 0) {
+        return;
+    }
+
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    handler->fd = -1;
+}
+
+int event_loop_add_timer(event_loop *loop, const event_callback callback, void *user_data) {
+    const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    event_handler *handler = event_loop_register(loop, fd, EPOLLIN | EPOLLET);
+    if (handler == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    handler->is_timer = 1;
+    handler->on_timer = callback;
+    handler->user_data = user_data;
+    return fd;
+}
+
+int event_loop_set_timer(event_loop *loop, const int timer, const uint32_t delay_ms, const uint32_t interval_ms) {
+    (void) loop;
+
+    struct itimerspec spec;
+    spec.it_value.tv_sec = delay_ms / 1000;
+    spec.it_value.tv_nsec = (long) (delay_ms % 1000) * 1000000L;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (long) (interval_ms % 1000) * 1000000L;
+
+    if (timerfd_settime(timer, 0, &spec, NULL) != 0) {
+        fprintf(stderr, "timerfd_settime(%d): %s\n", timer, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void event_loop_del_timer(event_loop *loop, const int timer) {
+    if (timer < 0) {
+        return;
+    }
+
+    event_loop_del_fd(loop, timer);
+    close(timer);
+}
+
+void event_loop_set_iteration_callback(event_loop *loop, const event_callback callback, void *user_data) {
+    loop->on_iteration = callback;
+    loop->iteration_user_data = user_data;
+}
+
+static void event_loop_dispatch(event_loop *loop, event_handler *handler, const uint32_t epoll_events) {
+    if (handler->fd < 0) {
+        // removed by a callback earlier in this iteration
+        return;
+    }
+
+    if (handler->is_timer) {
+        uint64_t expirations = 0;
+        if (read(handler->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            return;
+        }
+        handler->on_timer(loop, handler->user_data);
+        return;
+    }
+
+    uint32_t events = 0;
+    if (epoll_events & EPOLLIN) events |= EVENT_READ;
+    if (epoll_events & EPOLLOUT) events |= EVENT_WRITE;
+    if (epoll_events & (EPOLLERR | EPOLLHUP)) events |= EVENT_ERROR;
+    handler->on_io(loop, handler->fd, events, handler->user_data);
+}
+
+int event_loop_run(event_loop *loop) {
+    struct epoll_event events[EVENT_LOOP_MAX_HANDLERS];
+
+    loop->stopped = 0;
+    while (!loop->stopped) {
+        const int n = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_HANDLERS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            return -1;
+        }
+
+        loop->now_ms = event_loop_clock_ms();
+        for (int i = 0; i < n; i++) {
+            event_loop_dispatch(loop, events[i].data.ptr, events[i].events);
+        }
+
+        if (loop->on_iteration != NULL) {
+            loop->on_iteration(loop, loop->iteration_user_data);
+        }
+    }
+
+    return 0;
+}
+
+void event_loop_stop(event_loop *loop) {
+    loop->stopped = 1;
+}
+
+uint64_t event_loop_now_ms(const event_loop *loop) {
+    return loop->now_ms;
+}
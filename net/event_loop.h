@@ -0,0 +1,129 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#define EVENT_LOOP_MAX_HANDLERS 64
+
+#define EVENT_READ  0x01u
+#define EVENT_WRITE 0x02u
+#define EVENT_ERROR 0x04u
+
+typedef struct event_loop event_loop;
+
+/**
+ * @brief Callback invoked when a watched file descriptor becomes ready.
+ *
+ * Descriptors are watched edge-triggered: the callback must consume
+ * everything available (until EAGAIN), or it won't be notified again.
+ *
+ * @param loop [in] event loop
+ * @param fd [in] ready file descriptor
+ * @param events [in] EVENT_READ / EVENT_WRITE / EVENT_ERROR bits
+ * @param user_data [in] user data passed on registration
+ */
+typedef void (*event_io_callback)(event_loop *loop, int fd, uint32_t events, void *user_data);
+
+/**
+ * @brief Callback invoked when a timer expires, or at the end of every loop iteration
+ * @param loop [in] event loop
+ * @param user_data [in] user data passed on registration
+ */
+typedef void (*event_callback)(event_loop *loop, void *user_data);
+
+typedef struct event_handler {
+    int fd;
+    uint8_t is_timer;
+    event_io_callback on_io;
+    event_callback on_timer;
+    void *user_data;
+} event_handler;
+
+/**
+ * @brief epoll based event loop, with timerfd timers on the monotonic clock
+ */
+struct event_loop {
+    int epoll_fd;
+    volatile uint8_t stopped;
+    uint64_t now_ms;
+
+    event_callback on_iteration;
+    void *iteration_user_data;
+
+    event_handler handlers[EVENT_LOOP_MAX_HANDLERS];
+};
+
+/**
+ * @brief Create the epoll instance
+ * @return 0 for success, -1 for failure
+ */
+int event_loop_init(event_loop *loop);
+
+/**
+ * @brief Close the epoll instance and all timers. Watched descriptors are not closed.
+ */
+void event_loop_destroy(event_loop *loop);
+
+/**
+ * @brief Watch a file descriptor (edge-triggered)
+ * @param events [in] EVENT_READ and/or EVENT_WRITE
+ * @return 0 for success, -1 for failure
+ */
+int event_loop_add_fd(event_loop *loop, int fd, uint32_t events, event_io_callback callback, void *user_data);
+
+/**
+ * @brief Stop watching a file descriptor
+ */
+void event_loop_del_fd(event_loop *loop, int fd);
+
+/**
+ * @brief Create a timer. The timer is disarmed until event_loop_set_timer() is called.
+ * @return Timer id, -1 for failure
+ */
+int event_loop_add_timer(event_loop *loop, event_callback callback, void *user_data);
+
+/**
+ * @brief Arm or disarm a timer
+ * @param timer [in] timer id returned by event_loop_add_timer()
+ * @param delay_ms [in] milliseconds until first expiry, 0 disarms the timer
+ * @param interval_ms [in] period after first expiry, 0 for one-shot timers
+ * @return 0 for success, -1 for failure
+ */
+int event_loop_set_timer(event_loop *loop, int timer, uint32_t delay_ms, uint32_t interval_ms);
+
+/**
+ * @brief Close a timer
+ */
+void event_loop_del_timer(event_loop *loop, int timer);
+
+/**
+ * @brief Set a callback invoked once per loop iteration after all ready events are dispatched
+ */
+void event_loop_set_iteration_callback(event_loop *loop, event_callback callback, void *user_data);
+
+/**
+ * @brief Dispatch events until event_loop_stop() is called
+ * @return 0 when stopped, -1 on epoll failure
+ */
+int event_loop_run(event_loop *loop);
+
+/**
+ * @brief Make event_loop_run() return. Safe to call from signal handlers.
+ */
+void event_loop_stop(event_loop *loop);
+
+/**
+ * @return Monotonic time in milliseconds, cached once per loop iteration
+ */
+uint64_t event_loop_now_ms(const event_loop *loop);
+
+/**
+ * @return Current monotonic time in milliseconds
+ */
+uint64_t event_loop_clock_ms(void);
+
+#if __cplusplus
+}
+#endif
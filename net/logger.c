@@ -0,0 +1,349 @@
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spsc_queue.h"
+#include "worker.h"
+
+#define LOG_LINE_SIZE 512
+#define LOG_IDLE_MS 5
+
+/**
+ * @brief Ring of one logging thread, allocated on its first record
+ */
+typedef struct logger_thread {
+    spsc_queue ring;
+    uint64_t dropped;           // written by the owning thread
+    uint64_t reported;          // drops already reported, logger thread only
+} logger_thread;
+
+typedef struct logger {
+    worker thread;
+    volatile int running;
+    uint32_t thread_count;                      // reserved slots of threads
+    logger_thread *threads[LOG_MAX_THREADS];
+    uint64_t dropped;                           // records of threads without a ring, or whose ring is freed
+    uint64_t written;                           // logger thread only while it runs
+    uint64_t suppressed;
+} logger;
+
+log_level logger_level = kLogInfo;
+
+static logger log_state;
+static __thread logger_thread *log_local = NULL;
+static __thread char log_staged[LOG_TEXT_SIZE];
+static __thread uint8_t log_staged_length = 0;
+
+static const char *const level_names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+static uint64_t logger_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+int logger_admit(log_site *site) {
+    if (site->rate == 0) {
+        return 1;
+    }
+
+    // a coarse clock is enough for a window of a second
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    const uint32_t now = (uint32_t) ts.tv_sec;
+    if (__atomic_load_n(&site->window, __ATOMIC_RELAXED) != now) {
+        // threads racing on the rollover may admit a few records more
+        __atomic_store_n(&site->window, now, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->admitted, 0, __ATOMIC_RELAXED);
+    }
+    if (__atomic_fetch_add(&site->admitted, 1, __ATOMIC_RELAXED) < site->rate) {
+        return 1;
+    }
+
+    __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&log_state.suppressed, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int64_t logger_text(const char *data, int length) {
+    if (data == NULL) {
+        data = "(null)";
+        length = -1;
+    }
+    if (length < 0) {
+        length = (int) strnlen(data, LOG_TEXT_SIZE - 1);
+    }
+    if (length > LOG_TEXT_SIZE - 1) {
+        length = LOG_TEXT_SIZE - 1;
+    }
+    memcpy(log_staged, data, (size_t) length);
+    log_staged_length = (uint8_t) length;
+    return 0;
+}
+
+/**
+ * @brief Format one conversion of a record
+ * @param spec [in] conversion, from '%' to before the conversion character
+ * @return Characters written
+ */
+static int format_conversion(char *out, const size_t size, const char *spec, const size_t spec_length,
+                             const char conversion, const log_record *record, uint32_t *arg) {
+    // flags, width and precision are kept, length modifiers replaced by ll
+    char format[32];
+    size_t n = 0;
+    for (size_t i = 0; i < spec_length && n < sizeof(format) - 4; i++) {
+        if (strchr("hlLqjzt", spec[i]) == NULL) {
+            format[n++] = spec[i];
+        }
+    }
+
+    if (conversion == 's') {
+        format[n++] = '.';
+        format[n++] = '*';
+        format[n++] = 's';
+        format[n] = '\0';
+        return snprintf(out, size, format, (int) record->text_length, record->text);
+    }
+
+    const int64_t value = *arg < record->arg_count ? record->args[*arg] : 0;
+    ++*arg;
+    if (conversion == 'c') {
+        format[n++] = 'c';
+        format[n] = '\0';
+        return snprintf(out, size, format, (int) value);
+    }
+    format[n++] = 'l';
+    format[n++] = 'l';
+    format[n++] = conversion;
+    format[n] = '\0';
+    if (conversion == 'd' || conversion == 'i') {
+        return snprintf(out, size, format, (long long) value);
+    }
+    return snprintf(out, size, format, (unsigned long long) value);
+}
+
+/**
+ * @brief Format a record into a line, newline included
+ * @return Line length
+ */
+static size_t format_record(char *line, const size_t size, const log_record *record) {
+    const time_t seconds = (time_t) (record->time_ns / 1000000000u);
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+    size_t n = strftime(line, size, "%Y-%m-%d %H:%M:%S", &tm);
+    n += (size_t) snprintf(line + n, size - n, ".%06u %-5s ", (unsigned) (record->time_ns % 1000000000u / 1000),
+                           level_names[record->site->level]);
+
+    uint32_t arg = 0;
+    for (const char *p = record->site->format; *p != '\0' && n < size - 1;) {
+        if (*p != '%') {
+            line[n++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            line[n++] = '%';
+            p += 2;
+            continue;
+        }
+
+        const char *spec = p;
+        p++;
+        while (*p != '\0' && strchr("diouxXcs", *p) == NULL) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        const int written = format_conversion(line + n, size - n, spec, (size_t) (p - spec), *p, record, &arg);
+        if (written > 0) {
+            n += (size_t) written < size - n ? (size_t) written : size - n - 1;
+        }
+        p++;
+    }
+
+    const uint64_t suppressed = __atomic_exchange_n(&record->site->suppressed, 0, __ATOMIC_RELAXED);
+    if (suppressed != 0 && n < size - 1) {
+        const int written = snprintf(line + n, size - n, " (%llu more suppressed)", (unsigned long long) suppressed);
+        if (written > 0) {
+            n += (size_t) written < size - n ? (size_t) written : size - n - 1;
+        }
+    }
+    if (n > size - 2) {
+        n = size - 2;
+    }
+    line[n++] = '\n';
+    line[n] = '\0';
+    return n;
+}
+
+static void write_record(const log_record *record) {
+    char line[LOG_LINE_SIZE];
+    const size_t n = format_record(line, sizeof(line), record);
+    fwrite(line, 1, n, record->site->level >= kLogWarn ? stderr : stdout);
+}
+
+void logger_write(log_site *site, const int64_t *args, const uint32_t count) {
+    logger_thread *local = log_local;
+    if (local == NULL && __atomic_load_n(&log_state.running, __ATOMIC_ACQUIRE)) {
+        const uint32_t slot = __atomic_fetch_add(&log_state.thread_count, 1, __ATOMIC_RELAXED);
+        logger_thread *t = slot < LOG_MAX_THREADS ? calloc(1, sizeof(logger_thread)) : NULL;
+        if (t != NULL && spsc_queue_init(&t->ring, LOG_RING_RECORDS, sizeof(log_record)) != 0) {
+            free(t);
+            t = NULL;
+        }
+        if (slot < LOG_MAX_THREADS) {
+            __atomic_store_n(&log_state.threads[slot], t, __ATOMIC_RELEASE);
+        }
+        if (t == NULL) {
+            __atomic_fetch_add(&log_state.dropped, 1, __ATOMIC_RELAXED);
+            log_staged_length = 0;
+            return;
+        }
+        log_local = local = t;
+    }
+
+    log_record stack_record;
+    log_record *record = &stack_record;
+    const int queued = local != NULL && __atomic_load_n(&log_state.running, __ATOMIC_ACQUIRE);
+    if (queued) {
+        record = spsc_queue_reserve(&local->ring);
+        if (record == NULL) {
+            // never wait for the logger thread
+            __atomic_store_n(&local->dropped, local->dropped + 1, __ATOMIC_RELAXED);
+            log_staged_length = 0;
+            return;
+        }
+    }
+
+    record->time_ns = logger_clock_ns();
+    record->site = site;
+    record->arg_count = (uint8_t) (count < LOG_MAX_ARGS ? count : LOG_MAX_ARGS);
+    memcpy(record->args, args, record->arg_count * sizeof(int64_t));
+    record->text_length = log_staged_length;
+    memcpy(record->text, log_staged, log_staged_length);
+    log_staged_length = 0;
+
+    if (queued) {
+        spsc_queue_publish(&local->ring);
+    } else {
+        write_record(record);
+    }
+}
+
+/**
+ * @brief Write the queued records of every thread
+ * @return Number of records written
+ */
+static uint32_t drain(void) {
+    uint32_t written = 0;
+    uint32_t count = __atomic_load_n(&log_state.thread_count, __ATOMIC_RELAXED);
+    if (count > LOG_MAX_THREADS) {
+        count = LOG_MAX_THREADS;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        logger_thread *t = __atomic_load_n(&log_state.threads[i], __ATOMIC_ACQUIRE);
+        if (t == NULL) {
+            continue;
+        }
+
+        const log_record *record;
+        while ((record = spsc_queue_front(&t->ring)) != NULL) {
+            write_record(record);
+            spsc_queue_pop(&t->ring);
+            ++written;
+        }
+
+        const uint64_t dropped = __atomic_load_n(&t->dropped, __ATOMIC_RELAXED);
+        if (dropped != t->reported) {
+            fprintf(stderr, "log: %llu records dropped, the logger fell behind\n",
+                    (unsigned long long) (dropped - t->reported));
+            t->reported = dropped;
+        }
+    }
+
+    if (written != 0) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+    log_state.written += written;
+    return written;
+}
+
+static void run_logger(void *arg) {
+    (void) arg;
+
+    const struct timespec idle = {0, LOG_IDLE_MS * 1000000L};
+    while (__atomic_load_n(&log_state.running, __ATOMIC_ACQUIRE)) {
+        if (drain() == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+}
+
+int logger_start(void) {
+    if (log_state.running) {
+        return 0;
+    }
+
+    fflush(stdout);
+    __atomic_store_n(&log_state.running, 1, __ATOMIC_RELEASE);
+    if (worker_start(&log_state.thread, 0, -1, run_logger, NULL) != 0) {
+        __atomic_store_n(&log_state.running, 0, __ATOMIC_RELEASE);
+        return -1;
+    }
+    return 0;
+}
+
+void logger_stop(void) {
+    if (!log_state.running) {
+        return;
+    }
+
+    __atomic_store_n(&log_state.running, 0, __ATOMIC_RELEASE);
+    worker_join(&log_state.thread);
+    drain();
+
+    const uint32_t count = log_state.thread_count < LOG_MAX_THREADS ? log_state.thread_count : LOG_MAX_THREADS;
+    for (uint32_t i = 0; i < count; i++) {
+        logger_thread *t = log_state.threads[i];
+        if (t != NULL) {
+            log_state.dropped += t->dropped;
+            spsc_queue_destroy(&t->ring);
+            free(t);
+        }
+        log_state.threads[i] = NULL;
+    }
+    log_state.thread_count = 0;
+    // the stopping thread's ring is gone; other threads must not log until the next start
+    log_local = NULL;
+}
+
+logger_stats logger_get_stats(void) {
+    logger_stats stats;
+    stats.written = log_state.written;
+    stats.suppressed = __atomic_load_n(&log_state.suppressed, __ATOMIC_RELAXED);
+    stats.dropped = __atomic_load_n(&log_state.dropped, __ATOMIC_RELAXED);
+    const uint32_t count = log_state.thread_count < LOG_MAX_THREADS ? log_state.thread_count : LOG_MAX_THREADS;
+    for (uint32_t i = 0; i < count; i++) {
+        const logger_thread *t = __atomic_load_n(&log_state.threads[i], __ATOMIC_ACQUIRE);
+        if (t != NULL) {
+            stats.dropped += __atomic_load_n(&t->dropped, __ATOMIC_RELAXED);
+        }
+    }
+    return stats;
+}
+
+int logger_parse_level(const char *name, log_level *level) {
+    static const char *const names[] = {"debug", "info", "warn", "error"};
+    for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *level = (log_level) i;
+            return 0;
+        }
+    }
+    return -1;
+}
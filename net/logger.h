@@ -0,0 +1,136 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#define LOG_MAX_ARGS 8
+#define LOG_TEXT_SIZE 64            // bytes of the string argument kept by a record
+#define LOG_RING_RECORDS 1024       // records per thread in flight to the logger thread
+#define LOG_MAX_THREADS 128
+#define LOG_DEFAULT_RATE 20         // records per second and call site
+
+typedef enum log_level {
+    kLogDebug,
+    kLogInfo,
+    kLogWarn,
+    kLogError,
+} log_level;
+
+/**
+ * @brief Static state of one LOG_* call site
+ */
+typedef struct log_site {
+    const char *format;
+    log_level level;
+    uint32_t rate;          // records per second, 0 for no limit
+    uint32_t window;        // second of the current rate window
+    uint32_t admitted;      // records admitted in the current window
+    uint64_t suppressed;    // records suppressed by the rate limit and not reported yet
+} log_site;
+
+/**
+ * @brief Fixed-size binary record, formatted by the logger thread
+ */
+typedef struct log_record {
+    uint64_t time_ns;       // CLOCK_REALTIME
+    log_site *site;
+    uint8_t arg_count;
+    uint8_t text_length;
+    int64_t args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+} log_record;
+
+typedef struct logger_stats {
+    uint64_t written;       // records formatted and written
+    uint64_t dropped;       // records lost because a thread's ring was full
+    uint64_t suppressed;    // records suppressed by the rate limits of their call sites
+} logger_stats;
+
+/**
+ * @brief Records below this level are discarded at the call site
+ */
+extern log_level logger_level;
+
+/*
+ * Logging never blocks the calling thread. A call site checks the level and
+ * its rate limit, then copies its arguments into a record of the thread's own
+ * ring; the logger thread formats the records and writes them, info and debug
+ * to stdout, warnings and errors to stderr. When a ring is full the record is
+ * dropped and counted.
+ *
+ * Formats take printf conversions, with these restrictions: arguments are
+ * integers (converted to int64_t, so length modifiers are ignored), and at
+ * most one string, passed as LOG_STR() for a %s conversion. Width, flags and
+ * precision are kept.
+ *
+ *     LOG_INFO("[%08x] volume notify id=%d value=%d", device, id, volume);
+ *     LOG_WARN("[%08x] bad audio notify: %s", device, LOG_STR(name, -1));
+ *
+ * Before logger_start() and after logger_stop(), records are formatted and
+ * written by the calling thread.
+ */
+#define LOG_RATE(level, rate, format, ...)                                                                  \
+    do {                                                                                                    \
+        static log_site log_site_ = {format, level, rate, 0, 0, 0};                                         \
+        if ((level) >= logger_level && logger_admit(&log_site_)) {                                          \
+            const int64_t log_args_[] = {0, ##__VA_ARGS__};                                                 \
+            (void) sizeof(char[sizeof(log_args_) <= (LOG_MAX_ARGS + 1) * sizeof(int64_t) ? 1 : -1]);        \
+            logger_write(&log_site_, log_args_ + 1, sizeof(log_args_) / sizeof(int64_t) - 1);               \
+        }                                                                                                   \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_RATE(kLogDebug, LOG_DEFAULT_RATE, __VA_ARGS__)
+#define LOG_INFO(...) LOG_RATE(kLogInfo, LOG_DEFAULT_RATE, __VA_ARGS__)
+#define LOG_WARN(...) LOG_RATE(kLogWarn, LOG_DEFAULT_RATE, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_RATE(kLogError, LOG_DEFAULT_RATE, __VA_ARGS__)
+
+/**
+ * @brief The string argument of a record, copied up to LOG_TEXT_SIZE - 1 bytes
+ * @param length [in] string length, -1 for a NUL-terminated string
+ */
+#define LOG_STR(data, length) logger_text(data, length)
+
+/**
+ * @brief Apply the rate limit of a call site
+ * @return Whether the record is to be written
+ */
+int logger_admit(log_site *site);
+
+/**
+ * @brief Stage the string argument of the calling thread's next record
+ * @return 0, the argument's placeholder
+ */
+int64_t logger_text(const char *data, int length);
+
+/**
+ * @brief Queue a record, or write it if the logger thread isn't running
+ */
+void logger_write(log_site *site, const int64_t *args, uint32_t count);
+
+/**
+ * @brief Start the logger thread
+ * @return 0 for success, -1 for failure
+ */
+int logger_start(void);
+
+/**
+ * @brief Write what's queued and stop the logger thread. Threads that log must have stopped logging.
+ */
+void logger_stop(void);
+
+/**
+ * @return Counters of the logger, summed over all threads
+ */
+logger_stats logger_get_stats(void);
+
+/**
+ * @brief Parse a level name: debug, info, warn or error
+ * @return 0 for success, -1 for an unknown name
+ */
+int logger_parse_level(const char *name, log_level *level);
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,233 @@
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define METRICS_REQUEST_SIZE 1024
+#define METRICS_IO_TIMEOUT_MS 200
+
+void metrics_histogram_merge(metrics_histogram *to, const metrics_histogram *from) {
+    to->sum += metrics_load(&from->sum);
+    for (uint32_t i = 0; i < METRICS_BUCKETS; i++) {
+        to->counts[i] += metrics_load(&from->counts[i]);
+    }
+}
+
+uint64_t metrics_histogram_count(const metrics_histogram *h) {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < METRICS_BUCKETS; i++) {
+        count += metrics_load(&h->counts[i]);
+    }
+    return count;
+}
+
+uint64_t metrics_histogram_quantile(const metrics_histogram *h, const double q) {
+    const uint64_t count = metrics_histogram_count(h);
+    if (count == 0) {
+        return 0;
+    }
+
+    const uint64_t rank = (uint64_t) (q * (double) count);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < METRICS_BUCKETS; i++) {
+        seen += metrics_load(&h->counts[i]);
+        if (seen > rank) {
+            return metrics_histogram_bucket_max(i);
+        }
+    }
+    return metrics_histogram_bucket_max(METRICS_BUCKETS - 1);
+}
+
+void metrics_write_family(FILE *out, const char *name, const char *type, const char *help) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_write_sample(FILE *out, const char *name, const char *labels, const uint64_t value) {
+    if (labels != NULL) {
+        fprintf(out, "%s{%s} %llu\n", name, labels, (unsigned long long) value);
+    } else {
+        fprintf(out, "%s %llu\n", name, (unsigned long long) value);
+    }
+}
+
+void metrics_write_histogram(FILE *out, const char *name, const char *help, const metrics_histogram *h,
+                             const double scale) {
+    metrics_write_family(out, name, "histogram", help);
+
+    // one line per power of two: the last bucket of each octave
+    uint64_t cumulative = 0;
+    uint32_t bucket = 0;
+    for (uint32_t bits = METRICS_SUB_BITS + 1; bits <= METRICS_MAX_BITS; bits++) {
+        const uint64_t bound = 1ull << bits;
+        while (bucket < METRICS_BUCKETS && metrics_histogram_bucket_max(bucket) < bound) {
+            cumulative += metrics_load(&h->counts[bucket]);
+            bucket++;
+        }
+        fprintf(out, "%s_bucket{le=\"%.9g\"} %llu\n", name, (double) bound * scale, (unsigned long long) cumulative);
+    }
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long) cumulative);
+    fprintf(out, "%s_sum %.9g\n", name, (double) metrics_load(&h->sum) * scale);
+    fprintf(out, "%s_count %llu\n", name, (unsigned long long) cumulative);
+}
+
+static void metrics_serve(metrics_server *server, const int fd) {
+    const struct timeval timeout = {0, METRICS_IO_TIMEOUT_MS * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // read the request, if any, so that closing doesn't reset the connection
+    char request[METRICS_REQUEST_SIZE];
+    size_t received = 0;
+    while (received < sizeof(request) - 1) {
+        const ssize_t n = recv(fd, request + received, sizeof(request) - 1 - received, 0);
+        if (n <= 0) {
+            break;
+        }
+        received += (size_t) n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+            break;
+        }
+    }
+
+    char *body = NULL;
+    size_t body_size = 0;
+    FILE *out = open_memstream(&body, &body_size);
+    if (out == NULL) {
+        return;
+    }
+    server->render(out, server->user_data);
+    if (fclose(out) != 0) {
+        free(body);
+        return;
+    }
+
+    char header[128];
+    const int header_size = snprintf(header, sizeof(header),
+                                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                     "Content-Length: %zu\r\n\r\n", body_size);
+    if (send(fd, header, (size_t) header_size, MSG_NOSIGNAL) == header_size) {
+        size_t sent = 0;
+        while (sent < body_size) {
+            const ssize_t n = send(fd, body + sent, body_size - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += (size_t) n;
+        }
+    }
+    shutdown(fd, SHUT_WR);
+    free(body);
+}
+
+static void on_listen_readable(event_loop *loop, const int fd, const uint32_t events, void *user_data) {
+    (void) loop;
+    (void) events;
+
+    // scrapes are rare and small: serve each connection to the end, blocking with a timeout
+    int conn;
+    while ((conn = accept4(fd, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+        metrics_serve(user_data, conn);
+        close(conn);
+    }
+}
+
+static void on_control_readable(event_loop *loop, const int fd, const uint32_t events, void *user_data) {
+    (void) events;
+    (void) user_data;
+
+    char buf[16];
+    if (read(fd, buf, sizeof(buf)) <= 0) {
+        event_loop_del_fd(loop, fd);
+        event_loop_stop(loop);
+    }
+}
+
+static void run_server(void *arg) {
+    metrics_server *server = arg;
+    event_loop_run(&server->loop);
+}
+
+static void close_server_fds(metrics_server *server) {
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        unlink(server->path);
+    }
+    if (server->control[0] >= 0) close(server->control[0]);
+    if (server->control[1] >= 0) close(server->control[1]);
+    server->listen_fd = -1;
+    server->control[0] = -1;
+    server->control[1] = -1;
+}
+
+int metrics_server_start(metrics_server *server, const char *path, const metrics_render render, void *user_data) {
+    memset(server, 0, sizeof(*server));
+    server->listen_fd = -1;
+    server->control[0] = -1;
+    server->control[1] = -1;
+    server->render = render;
+    server->user_data = user_data;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path) || strlen(path) >= sizeof(server->path)) {
+        fprintf(stderr, "metrics socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    server->listen_fd = fd;
+    strcpy(server->path, path);
+
+    if (pipe2(server->control, O_NONBLOCK | O_CLOEXEC) != 0) {
+        perror("pipe2");
+        close_server_fds(server);
+        return -1;
+    }
+
+    if (event_loop_init(&server->loop) != 0) {
+        fprintf(stderr, "Failed to create event loop\n");
+        close_server_fds(server);
+        return -1;
+    }
+
+    if (event_loop_add_fd(&server->loop, server->listen_fd, EVENT_READ, on_listen_readable, server) != 0
+        || event_loop_add_fd(&server->loop, server->control[0], EVENT_READ, on_control_readable, server) != 0
+        || worker_start(&server->thread, 0, -1, run_server, server) != 0) {
+        fprintf(stderr, "Failed to start the metrics server\n");
+        event_loop_destroy(&server->loop);
+        close_server_fds(server);
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_server_stop(metrics_server *server) {
+    if (server->render == NULL || server->listen_fd < 0) {
+        return;
+    }
+
+    close(server->control[1]);
+    server->control[1] = -1;
+    worker_join(&server->thread);
+
+    event_loop_destroy(&server->loop);
+    close_server_fds(server);
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdio.h>
+
+#include "event_loop.h"
+#include "worker.h"
+
+#define METRICS_SUB_BITS 4                                  // linear sub-buckets per power of two: 2^4
+#define METRICS_SUB_BUCKETS (1u << METRICS_SUB_BITS)
+#define METRICS_MAX_BITS 36                                 // values are clamped below 2^36 (68 s in ns)
+#define METRICS_BUCKETS ((METRICS_MAX_BITS - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+
+/*
+ * Metrics are written by the thread that owns them and read by the metrics
+ * server's thread. Writers use relaxed atomic stores (a single writer needs no
+ * read-modify-write), readers relaxed atomic loads: no locks, no lock-prefixed
+ * instructions on the hot path, and a scrape sums every thread's metrics.
+ */
+
+/**
+ * @brief Add to a counter owned by the calling thread
+ */
+static inline void metrics_add(uint64_t *counter, const uint64_t n) {
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Read a counter of any thread
+ */
+static inline uint64_t metrics_load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Log-linear histogram, in the manner of HDR histograms.
+ *
+ * Every power of two is split into METRICS_SUB_BUCKETS linear buckets, so a
+ * bucket is at most 1/16 wide relative to its values, from 1 to 2^36.
+ * Recording is an index computation and one increment.
+ */
+typedef struct metrics_histogram {
+    uint64_t sum;
+    uint64_t counts[METRICS_BUCKETS];
+} metrics_histogram;
+
+/**
+ * @return Bucket of a value
+ */
+static inline uint32_t metrics_histogram_bucket(uint64_t value) {
+    if (value < METRICS_SUB_BUCKETS) {
+        return (uint32_t) value;
+    }
+    if (value >> METRICS_MAX_BITS != 0) {
+        value = (1ull << METRICS_MAX_BITS) - 1;
+    }
+    const uint32_t shift = 63 - (uint32_t) __builtin_clzll(value) - METRICS_SUB_BITS;
+    return ((shift + 1) << METRICS_SUB_BITS) + (uint32_t) (value >> shift) - METRICS_SUB_BUCKETS;
+}
+
+/**
+ * @return Largest value of a bucket
+ */
+static inline uint64_t metrics_histogram_bucket_max(const uint32_t bucket) {
+    if (bucket < 2 * METRICS_SUB_BUCKETS) {
+        return bucket;
+    }
+    const uint32_t shift = (bucket >> METRICS_SUB_BITS) - 1;
+    const uint64_t low = (uint64_t) (METRICS_SUB_BUCKETS + (bucket & (METRICS_SUB_BUCKETS - 1))) << shift;
+    return low + (1ull << shift) - 1;
+}
+
+/**
+ * @brief Record a value into a histogram owned by the calling thread
+ */
+static inline void metrics_histogram_record(metrics_histogram *h, const uint64_t value) {
+    metrics_add(&h->counts[metrics_histogram_bucket(value)], 1);
+    metrics_add(&h->sum, value);
+}
+
+/**
+ * @brief Add a histogram of any thread into a histogram of the caller
+ */
+void metrics_histogram_merge(metrics_histogram *to, const metrics_histogram *from);
+
+/**
+ * @return Number of recorded values
+ */
+uint64_t metrics_histogram_count(const metrics_histogram *h);
+
+/**
+ * @return Upper bound of the bucket holding the quantile q of the values, 0 if there are none
+ */
+uint64_t metrics_histogram_quantile(const metrics_histogram *h, double q);
+
+/**
+ * @brief Write the TYPE and HELP lines of a metric family in the Prometheus text format
+ * @param type [in] "counter", "gauge" or "histogram"
+ */
+void metrics_write_family(FILE *out, const char *name, const char *type, const char *help);
+
+/**
+ * @brief Write a sample in the Prometheus text format
+ * @param labels [in] label set without braces, e.g. command="0x41", NULL for none
+ */
+void metrics_write_sample(FILE *out, const char *name, const char *labels, uint64_t value);
+
+/**
+ * @brief Write a histogram in the Prometheus text format, with its TYPE and HELP lines.
+ *
+ * Buckets are reported at powers of two, which are boundaries of the
+ * histogram's own buckets: each count is exact, up to the boundary value.
+ *
+ * @param scale [in] factor from recorded values to the reported unit, e.g. 1e-9 from ns to seconds
+ */
+void metrics_write_histogram(FILE *out, const char *name, const char *help, const metrics_histogram *h,
+                             double scale);
+
+/**
+ * @brief Write the metrics text of a scrape
+ * @param out [in] stream of the response body
+ * @param user_data [in] user data passed to metrics_server_start()
+ */
+typedef void (*metrics_render)(FILE *out, void *user_data);
+
+/**
+ * @brief Local stats endpoint: a Unix stream socket answering each connection with the metrics text.
+ *
+ * The server runs on its own thread and event loop. A connection gets an
+ * HTTP/1.0 response, so it can be scraped with curl --unix-socket or a
+ * Prometheus exporter proxying Unix sockets, and is closed.
+ */
+typedef struct metrics_server {
+    worker thread;
+    event_loop loop;
+    int listen_fd;
+    int control[2];         // closing the write end stops the server
+    metrics_render render;
+    void *user_data;
+    char path[108];
+} metrics_server;
+
+/**
+ * @brief Listen on a Unix socket path (an existing socket there is replaced) and start serving
+ * @return 0 for success, -1 for failure
+ */
+int metrics_server_start(metrics_server *server, const char *path, metrics_render render, void *user_data);
+
+/**
+ * @brief Stop serving, remove the socket path and release resources. A zeroed or failed server is ignored.
+ */
+void metrics_server_stop(metrics_server *server);
+
+#if __cplusplus
+}
+#endif
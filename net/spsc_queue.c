@@ -0,0 +1,30 @@
+#include "spsc_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_queue_init(spsc_queue *q, const uint32_t capacity, const uint32_t element_size) {
+    memset(q, 0, sizeof(*q));
+    if (capacity == 0 || capacity > 0x80000000u || element_size == 0) {
+        return -1;
+    }
+
+    uint32_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    q->elements = calloc(size, element_size);
+    if (q->elements == NULL) {
+        return -1;
+    }
+
+    q->mask = size - 1;
+    q->element_size = element_size;
+    return 0;
+}
+
+void spsc_queue_destroy(spsc_queue *q) {
+    free(q->elements);
+    memset(q, 0, sizeof(*q));
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPSC_CACHE_LINE 64
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring of fixed-size elements.
+ *
+ * The producer fills a slot in place (spsc_queue_reserve / spsc_queue_publish)
+ * and the consumer reads it in place (spsc_queue_front / spsc_queue_pop), so
+ * elements are copied once. Neither side ever blocks: reserve returns NULL
+ * when the ring is full, front returns NULL when it's empty.
+ *
+ * Each side keeps a cached copy of the other side's index and reloads it
+ * only when the ring looks full (or empty), and the two indices live on
+ * separate cache lines, so in steady state the sides rarely share a line.
+ */
+typedef struct spsc_queue {
+    // producer
+    uint32_t tail;          // next slot to fill
+    uint32_t head_cache;
+    uint8_t producer_pad[SPSC_CACHE_LINE - 2 * sizeof(uint32_t)];
+
+    // consumer
+    uint32_t head;          // next slot to read
+    uint32_t tail_cache;
+    uint8_t consumer_pad[SPSC_CACHE_LINE - 2 * sizeof(uint32_t)];
+
+    // read-only after init
+    uint32_t mask;
+    uint32_t element_size;
+    uint8_t *elements;
+} spsc_queue;
+
+/**
+ * @brief Allocate a queue
+ * @param capacity [in] number of elements, rounded up to a power of two
+ * @param element_size [in] element size in bytes
+ * @return 0 for success, -1 for failure
+ */
+int spsc_queue_init(spsc_queue *q, uint32_t capacity, uint32_t element_size);
+
+/**
+ * @brief Release the queue storage. Neither side may use the queue any more.
+ */
+void spsc_queue_destroy(spsc_queue *q);
+
+/**
+ * @brief Producer: get the next free slot
+ * @return Slot to fill, NULL if the queue is full
+ */
+static inline void *spsc_queue_reserve(spsc_queue *q) {
+    const uint32_t tail = q->tail;
+    if (tail - q->head_cache > q->mask) {
+        q->head_cache = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        if (tail - q->head_cache > q->mask) {
+            return NULL;
+        }
+    }
+    return q->elements + (size_t) (tail & q->mask) * q->element_size;
+}
+
+/**
+ * @brief Producer: hand the slot returned by spsc_queue_reserve() to the consumer
+ */
+static inline void spsc_queue_publish(spsc_queue *q) {
+    __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Consumer: get the oldest element
+ * @return Element, NULL if the queue is empty
+ */
+static inline void *spsc_queue_front(spsc_queue *q) {
+    const uint32_t head = q->head;
+    if (head == q->tail_cache) {
+        q->tail_cache = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+        if (head == q->tail_cache) {
+            return NULL;
+        }
+    }
+    return q->elements + (size_t) (head & q->mask) * q->element_size;
+}
+
+/**
+ * @brief Consumer: release the element returned by spsc_queue_front()
+ */
+static inline void spsc_queue_pop(spsc_queue *q) {
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+}
+
+#if __cplusplus
+}
+#endif
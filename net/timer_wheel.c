@@ -0,0 +1,150 @@
+#include "timer_wheel.h"
+
+#include <string.h>
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_MAX_DELAY ((1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1)
+
+static void timer_list_init(timer_wheel_node *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static void timer_list_add(timer_wheel_node *head, timer_wheel_node *node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void timer_list_unlink(timer_wheel_node *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+void timer_wheel_init(timer_wheel *wheel, const uint32_t tick_ms, const uint64_t now_ms,
+                      const timer_wheel_callback callback, void *user_data) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->tick_ms = tick_ms ? tick_ms : 1;
+    wheel->current = now_ms / wheel->tick_ms;
+    wheel->callback = callback;
+    wheel->user_data = user_data;
+    wheel->random = (uint32_t) now_ms * 2654435761u | 1u;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            timer_list_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+static void timer_wheel_place(timer_wheel *wheel, timer_wheel_node *node) {
+    const uint64_t delta = node->expires - wheel->current;
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= 1ull << ((level + 1) * TIMER_WHEEL_SLOT_BITS)) {
+        ++level;
+    }
+
+    const uint32_t slot = (uint32_t) (node->expires >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_MASK;
+    timer_list_add(&wheel->slots[level][slot], node);
+}
+
+void timer_wheel_arm(timer_wheel *wheel, timer_wheel_node *node, const uint32_t delay_ms) {
+    if (timer_wheel_armed(node)) {
+        timer_list_unlink(node);
+    } else {
+        wheel->count++;
+    }
+
+    uint64_t ticks = (delay_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    if (ticks == 0) ticks = 1;
+    if (ticks > TIMER_WHEEL_MAX_DELAY) ticks = TIMER_WHEEL_MAX_DELAY;
+
+    node->expires = wheel->current + ticks;
+    timer_wheel_place(wheel, node);
+}
+
+void timer_wheel_cancel(timer_wheel *wheel, timer_wheel_node *node) {
+    if (!timer_wheel_armed(node)) {
+        return;
+    }
+
+    timer_list_unlink(node);
+    wheel->count--;
+}
+
+static void timer_wheel_cascade(timer_wheel *wheel, const int level) {
+    const uint32_t slot = (uint32_t) (wheel->current >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_MASK;
+    timer_wheel_node *head = &wheel->slots[level][slot];
+
+    while (head->next != head) {
+        timer_wheel_node *node = head->next;
+        timer_list_unlink(node);
+        timer_wheel_place(wheel, node);
+    }
+}
+
+uint32_t timer_wheel_advance(timer_wheel *wheel, const uint64_t now_ms) {
+    const uint64_t target = now_ms / wheel->tick_ms;
+    uint32_t expired = 0;
+
+    while (wheel->current < target) {
+        if (wheel->count == 0) {
+            wheel->current = target;
+            break;
+        }
+
+        wheel->current++;
+
+        // when a level wraps, redistribute the next slot of the level above
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if ((wheel->current & ((1ull << (level * TIMER_WHEEL_SLOT_BITS)) - 1)) != 0) {
+                break;
+            }
+            timer_wheel_cascade(wheel, level);
+        }
+
+        timer_wheel_node *head = &wheel->slots[0][wheel->current & TIMER_WHEEL_MASK];
+        while (head->next != head) {
+            timer_wheel_node *node = head->next;
+            timer_list_unlink(node);
+            wheel->count--;
+            ++expired;
+            wheel->callback(node, wheel->user_data);
+        }
+    }
+
+    return expired;
+}
+
+static uint32_t timer_wheel_next_random(timer_wheel *wheel) {
+    // xorshift32
+    uint32_t x = wheel->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    wheel->random = x;
+    return x;
+}
+
+uint32_t timer_wheel_jitter(timer_wheel *wheel, const uint32_t ms, const uint32_t jitter_percent) {
+    const uint32_t range = (uint32_t) ((uint64_t) ms * jitter_percent / 100);
+    if (range == 0) {
+        return ms;
+    }
+    return ms - timer_wheel_next_random(wheel) % (range + 1);
+}
+
+uint32_t timer_wheel_backoff(timer_wheel *wheel, const uint32_t base_ms, const uint32_t max_ms,
+                             const uint32_t attempt) {
+    uint64_t delay = base_ms;
+    for (uint32_t i = 0; i < attempt && delay < max_ms; i++) {
+        delay <<= 1;
+    }
+    if (delay > max_ms) delay = max_ms;
+
+    return timer_wheel_jitter(wheel, (uint32_t) delay, 50);
+}
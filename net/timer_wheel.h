@@ -0,0 +1,103 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+
+typedef struct timer_wheel_node timer_wheel_node;
+
+/**
+ * @brief Callback invoked when a timer expires. The timer may be re-armed from the callback.
+ * @param node [in] expired timer
+ * @param user_data [in] user data passed to timer_wheel_init()
+ */
+typedef void (*timer_wheel_callback)(timer_wheel_node *node, void *user_data);
+
+/**
+ * @brief Timer embedded in the structure it belongs to (e.g. a session).
+ *
+ * Zero-initialized nodes are valid and disarmed.
+ */
+struct timer_wheel_node {
+    timer_wheel_node *next;
+    timer_wheel_node *prev;     // NULL when disarmed
+    uint64_t expires;           // expiry tick
+};
+
+/**
+ * @brief Hierarchical timer wheel: arming and cancelling timers is O(1).
+ *
+ * Level 0 has one slot per tick, each higher level has slots 64 times
+ * coarser. Timers move down a level when the level below wraps, so each
+ * timer is touched at most once per level. With 10 ms ticks the wheel
+ * covers about 46 hours; longer timers are clamped to that.
+ */
+typedef struct timer_wheel {
+    uint32_t tick_ms;
+    uint64_t current;       // current tick
+    uint32_t count;         // armed timers
+    uint32_t random;        // jitter generator state
+    timer_wheel_callback callback;
+    void *user_data;
+    timer_wheel_node slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];   // list heads
+} timer_wheel;
+
+/**
+ * @brief Initialize a wheel
+ * @param tick_ms [in] resolution in milliseconds
+ * @param now_ms [in] current monotonic time
+ * @param callback [in] invoked for every expired timer
+ * @param user_data [in] passed to callback
+ */
+void timer_wheel_init(timer_wheel *wheel, uint32_t tick_ms, uint64_t now_ms, timer_wheel_callback callback,
+                      void *user_data);
+
+/**
+ * @brief Arm (or re-arm) a timer
+ * @param delay_ms [in] milliseconds from the wheel's current time
+ */
+void timer_wheel_arm(timer_wheel *wheel, timer_wheel_node *node, uint32_t delay_ms);
+
+/**
+ * @brief Disarm a timer. Disarming a disarmed timer has no effect.
+ */
+void timer_wheel_cancel(timer_wheel *wheel, timer_wheel_node *node);
+
+/**
+ * @return Non-zero if the timer is armed
+ */
+static inline int timer_wheel_armed(const timer_wheel_node *node) {
+    return node->prev != NULL;
+}
+
+/**
+ * @brief Advance the wheel to now, invoking the callback of every expired timer
+ * @return Number of timers expired
+ */
+uint32_t timer_wheel_advance(timer_wheel *wheel, uint64_t now_ms);
+
+/**
+ * @return A random delay in [ms - ms * jitter_percent / 100, ms]
+ */
+uint32_t timer_wheel_jitter(timer_wheel *wheel, uint32_t ms, uint32_t jitter_percent);
+
+/**
+ * @brief Exponential backoff with jitter: min(base << attempt, max), of which a random half is kept
+ * @return Delay in milliseconds, in [delay / 2, delay]
+ */
+uint32_t timer_wheel_backoff(timer_wheel *wheel, uint32_t base_ms, uint32_t max_ms, uint32_t attempt);
+
+/**
+ * @brief Get the structure a timer is embedded in
+ */
+#define timer_wheel_entry(node, type, member) ((type *) ((char *) (node) - offsetof(type, member)))
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,184 @@
+#include "udp_batch.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+int udp_batch_init(udp_batch *batch, const int fd, const uint16_t rx_slots, const uint16_t tx_slots) {
+    memset(batch, 0, sizeof(*batch));
+    batch->fd = fd;
+    batch->rx_capacity = rx_slots;
+    batch->tx_capacity = tx_slots;
+
+    batch->rx_msgs = calloc(rx_slots, sizeof(struct mmsghdr));
+    batch->rx_iov = calloc(rx_slots, sizeof(struct iovec));
+    batch->rx_addr = calloc(rx_slots, sizeof(struct sockaddr_in));
+    batch->rx_buf = malloc((size_t) rx_slots * UDP_BATCH_SLOT_SIZE);
+
+    batch->tx_msgs = calloc(tx_slots, sizeof(struct mmsghdr));
+    batch->tx_iov = calloc(tx_slots, sizeof(struct iovec));
+    batch->tx_addr = calloc(tx_slots, sizeof(struct sockaddr_in));
+    batch->tx_buf = malloc((size_t) tx_slots * UDP_BATCH_SLOT_SIZE);
+
+    if (batch->rx_msgs == NULL || batch->rx_iov == NULL || batch->rx_addr == NULL || batch->rx_buf == NULL
+        || batch->tx_msgs == NULL || batch->tx_iov == NULL || batch->tx_addr == NULL || batch->tx_buf == NULL) {
+        udp_batch_destroy(batch);
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < rx_slots; i++) {
+        batch->rx_iov[i].iov_base = batch->rx_buf + (size_t) i * UDP_BATCH_SLOT_SIZE;
+        batch->rx_iov[i].iov_len = UDP_BATCH_SLOT_SIZE;
+        batch->rx_msgs[i].msg_hdr.msg_iov = &batch->rx_iov[i];
+        batch->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->rx_msgs[i].msg_hdr.msg_name = &batch->rx_addr[i];
+    }
+
+    for (uint16_t i = 0; i < tx_slots; i++) {
+        batch->tx_iov[i].iov_base = batch->tx_buf + (size_t) i * UDP_BATCH_SLOT_SIZE;
+        batch->tx_msgs[i].msg_hdr.msg_iov = &batch->tx_iov[i];
+        batch->tx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    return 0;
+}
+
+void udp_batch_destroy(udp_batch *batch) {
+    free(batch->rx_msgs);
+    free(batch->rx_iov);
+    free(batch->rx_addr);
+    free(batch->rx_buf);
+    free(batch->tx_msgs);
+    free(batch->tx_iov);
+    free(batch->tx_addr);
+    free(batch->tx_buf);
+    memset(batch, 0, sizeof(*batch));
+    batch->fd = -1;
+}
+
+int udp_batch_receive(udp_batch *batch, const udp_batch_handler handler, void *user_data) {
+    int total = 0;
+    while (1) {
+        for (uint16_t i = 0; i < batch->rx_capacity; i++) {
+            // the kernel overwrites name length with the actual address size
+            batch->rx_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+
+        const int n = recvmmsg(batch->fd, batch->rx_msgs, batch->rx_capacity, MSG_DONTWAIT, NULL);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN("recvmmsg: %s", LOG_STR(strerror(errno), -1));
+                return -1;
+            }
+            return total;
+        }
+
+        if (n == 0) {
+            return total;
+        }
+
+        batch->stats.rx_calls++;
+        batch->stats.rx_datagrams += n;
+
+        for (int i = 0; i < n; i++) {
+            const struct mmsghdr *m = &batch->rx_msgs[i];
+            if (m->msg_hdr.msg_flags & MSG_TRUNC) {
+                // longer than a slot: what's left of it can't be parsed
+                batch->stats.rx_dropped++;
+                continue;
+            }
+            handler(user_data, m->msg_hdr.msg_iov->iov_base, (uint16_t) m->msg_len, &batch->rx_addr[i]);
+            total++;
+        }
+
+        if (n < batch->rx_capacity) {
+            // socket is drained, skip the extra recvmmsg() that would return EAGAIN
+            return total;
+        }
+    }
+}
+
+void *udp_batch_slot(udp_batch *batch, uint16_t *size) {
+    if (batch->tx_count >= batch->tx_capacity) {
+        udp_batch_flush(batch);
+    }
+
+    *size = UDP_BATCH_SLOT_SIZE;
+    return batch->tx_iov[batch->tx_count].iov_base;
+}
+
+void udp_batch_commit(udp_batch *batch, const uint16_t length, const struct sockaddr_in *to) {
+    if (length == 0 || batch->tx_count >= batch->tx_capacity) {
+        return;
+    }
+
+    struct mmsghdr *m = &batch->tx_msgs[batch->tx_count];
+    batch->tx_iov[batch->tx_count].iov_len = length;
+    if (to != NULL) {
+        batch->tx_addr[batch->tx_count] = *to;
+        m->msg_hdr.msg_name = &batch->tx_addr[batch->tx_count];
+        m->msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    } else {
+        m->msg_hdr.msg_name = NULL;
+        m->msg_hdr.msg_namelen = 0;
+    }
+    batch->tx_count++;
+}
+
+int udp_batch_send(udp_batch *batch, const void *data, const uint16_t length, const struct sockaddr_in *to) {
+    if (length > UDP_BATCH_SLOT_SIZE) {
+        return -1;
+    }
+
+    uint16_t size = 0;
+    void *slot = udp_batch_slot(batch, &size);
+    memcpy(slot, data, length);
+    udp_batch_commit(batch, length, to);
+    return 0;
+}
+
+int udp_batch_flush(udp_batch *batch) {
+    int sent = 0;
+    int ok = 0;
+    while (sent < batch->tx_count) {
+        const int n = sendmmsg(batch->fd, batch->tx_msgs + sent, batch->tx_count - sent, 0);
+        if (n == -1) {
+            const int err = errno;
+            if (err == EINTR) {
+                continue;
+            }
+
+            // the first remaining datagram failed (e.g. ECONNREFUSED), skip it and go on with the rest
+            LOG_WARN("sendmmsg: %s", LOG_STR(strerror(err), -1));
+            if (err == EAGAIN || err == EWOULDBLOCK) {
+                batch->stats.tx_dropped += batch->tx_count - sent;
+                break;
+            }
+            batch->stats.tx_dropped++;
+            sent++;
+            continue;
+        }
+
+        batch->stats.tx_calls++;
+        batch->stats.tx_datagrams += n;
+        sent += n;
+        ok += n;
+    }
+
+    batch->tx_count = 0;
+    return ok;
+}
+
+double udp_batch_avg_rx(const udp_batch_stats *stats) {
+    return stats->rx_calls ? (double) stats->rx_datagrams / (double) stats->rx_calls : 0.0;
+}
+
+double udp_batch_avg_tx(const udp_batch_stats *stats) {
+    return stats->tx_calls ? (double) stats->tx_datagrams / (double) stats->tx_calls : 0.0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define UDP_BATCH_SLOT_SIZE 1500
+
+/**
+ * @brief Counters of batched socket I/O
+ */
+typedef struct udp_batch_stats {
+    uint64_t rx_calls;      // recvmmsg() calls that returned at least one datagram
+    uint64_t rx_datagrams;  // datagrams received
+    uint64_t rx_dropped;    // datagrams received but not handled: truncated, or (io_uring) no room to defer them
+    uint64_t tx_calls;      // sendmmsg() calls
+    uint64_t tx_datagrams;  // datagrams sent
+    uint64_t tx_dropped;    // datagrams dropped on send errors
+} udp_batch_stats;
+
+/**
+ * @brief Preallocated receive slots and outgoing queue of one UDP socket.
+ *
+ * Received datagrams are read with one recvmmsg() per batch, outgoing datagrams
+ * are queued and sent with one sendmmsg() per flush.
+ */
+typedef struct udp_batch {
+    int fd;
+    uint16_t rx_capacity;
+    uint16_t tx_capacity;
+    uint16_t tx_count;
+
+    struct mmsghdr *rx_msgs;
+    struct iovec *rx_iov;
+    struct sockaddr_in *rx_addr;
+    uint8_t *rx_buf;
+
+    struct mmsghdr *tx_msgs;
+    struct iovec *tx_iov;
+    struct sockaddr_in *tx_addr;
+    uint8_t *tx_buf;
+
+    udp_batch_stats stats;
+} udp_batch;
+
+/**
+ * @brief Callback invoked for each received datagram
+ * @param user_data [in] user data passed to udp_batch_receive()
+ * @param data [in] datagram bytes, valid only during the call
+ * @param length [in] datagram length
+ * @param from [in] source address
+ */
+typedef void (*udp_batch_handler)(void *user_data, const void *data, uint16_t length, const struct sockaddr_in *from);
+
+/**
+ * @brief Allocate receive slots and outgoing queue
+ * @param batch [out] batch to be initialized
+ * @param fd [in] non-blocking UDP socket
+ * @param rx_slots [in] number of datagrams read per recvmmsg()
+ * @param tx_slots [in] number of datagrams queued before an implicit flush
+ * @return 0 for success, -1 for failure
+ */
+int udp_batch_init(udp_batch *batch, int fd, uint16_t rx_slots, uint16_t tx_slots);
+
+/**
+ * @brief Release storage allocated by udp_batch_init(). Queued datagrams are discarded.
+ */
+void udp_batch_destroy(udp_batch *batch);
+
+/**
+ * @brief Read all pending datagrams, one recvmmsg() per batch of slots
+ * @param batch [in] batch
+ * @param handler [in] callback invoked for each datagram
+ * @param user_data [in] passed to handler
+ * @return Number of datagrams handled (truncated ones are counted in rx_dropped instead), -1 on socket error
+ */
+int udp_batch_receive(udp_batch *batch, udp_batch_handler handler, void *user_data);
+
+/**
+ * @brief Get the buffer of the next outgoing datagram. The queue is flushed first if it's full.
+ * @param batch [in] batch
+ * @param size [out] buffer size (UDP_BATCH_SLOT_SIZE)
+ * @return Buffer to write the datagram into, committed by udp_batch_commit()
+ */
+void *udp_batch_slot(udp_batch *batch, uint16_t *size);
+
+/**
+ * @brief Queue the datagram written into the buffer returned by udp_batch_slot()
+ * @param batch [in] batch
+ * @param length [in] datagram length, 0 discards the slot
+ * @param to [in] destination address, NULL for connected sockets
+ */
+void udp_batch_commit(udp_batch *batch, uint16_t length, const struct sockaddr_in *to);
+
+/**
+ * @brief Copy a datagram into the outgoing queue
+ * @return 0 for success, -1 if the datagram is too long
+ */
+int udp_batch_send(udp_batch *batch, const void *data, uint16_t length, const struct sockaddr_in *to);
+
+/**
+ * @brief Send all queued datagrams with sendmmsg()
+ * @return Number of datagrams sent
+ */
+int udp_batch_flush(udp_batch *batch);
+
+/**
+ * @return Average number of datagrams per recvmmsg() call
+ */
+double udp_batch_avg_rx(const udp_batch_stats *stats);
+
+/**
+ * @return Average number of datagrams per sendmmsg() call
+ */
+double udp_batch_avg_tx(const udp_batch_stats *stats);
+
+#if __cplusplus
+}
+#endif
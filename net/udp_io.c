@@ -0,0 +1,130 @@
+#include "udp_io.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define UDP_IO_RX_SLOTS 64
+#define UDP_IO_TX_SLOTS 64
+#define UDP_IO_URING_BUFFERS 256
+
+int udp_io_init(udp_io *io, const int fd, const udp_io_backend backend) {
+    memset(io, 0, sizeof(*io));
+
+#if PARROT_WITH_IO_URING
+    if (backend == kUdpIoUring) {
+        if (uring_udp_init(&io->uring, fd, UDP_IO_URING_BUFFERS, UDP_IO_TX_SLOTS) == 0) {
+            io->backend = kUdpIoUring;
+            return 0;
+        }
+        fprintf(stderr, "io_uring unavailable, falling back to recvmmsg/sendmmsg\n");
+    }
+#else
+    if (backend == kUdpIoUring) {
+        fprintf(stderr, "io_uring support not compiled in, using recvmmsg/sendmmsg\n");
+    }
+#endif
+
+    io->backend = kUdpIoBatch;
+    return udp_batch_init(&io->batch, fd, UDP_IO_RX_SLOTS, UDP_IO_TX_SLOTS);
+}
+
+void udp_io_destroy(udp_io *io) {
+#if PARROT_WITH_IO_URING
+    if (io->backend == kUdpIoUring) {
+        uring_udp_destroy(&io->uring);
+        return;
+    }
+#endif
+    udp_batch_destroy(&io->batch);
+}
+
+int udp_io_fd(const udp_io *io) {
+#if PARROT_WITH_IO_URING
+    if (io->backend == kUdpIoUring) {
+        return io->uring.ring_fd;
+    }
+#endif
+    return io->batch.fd;
+}
+
+const char *udp_io_backend_name(const udp_io *io) {
+    return io->backend == kUdpIoUring ? "io_uring" : "recvmmsg/sendmmsg";
+}
+
+const udp_batch_stats *udp_io_stats(const udp_io *io) {
+#if PARROT_WITH_IO_URING
+    if (io->backend == kUdpIoUring) {
+        return &io->uring.stats;
+    }
+#endif
+    return &io->batch.stats;
+}
+
+/**
+ * @brief Handler of a capturing receive: records the datagram, then passes it on
+ */
+typedef struct udp_io_capture {
+    udp_trace_writer *trace;
+    udp_batch_handler handler;
+    void *user_data;
+} udp_io_capture;
+
+static void udp_io_capture_datagram(void *user_data, const void *data, const uint16_t length,
+                                    const struct sockaddr_in *from) {
+    const udp_io_capture *capture = user_data;
+    udp_trace_writer_append(capture->trace, kUdpTraceRx, data, length, from);
+    capture->handler(capture->user_data, data, length, from);
+}
+
+int udp_io_receive(udp_io *io, udp_batch_handler handler, void *user_data) {
+    udp_io_capture capture;
+    if (io->capture != NULL) {
+        capture.trace = io->capture;
+        capture.handler = handler;
+        capture.user_data = user_data;
+        handler = udp_io_capture_datagram;
+        user_data = &capture;
+    }
+
+#if PARROT_WITH_IO_URING
+    if (io->backend == kUdpIoUring) {
+        return uring_udp_receive(&io->uring, handler, user_data);
+    }
+#endif
+    return udp_batch_receive(&io->batch, handler, user_data);
+}
+
+void *udp_io_slot(udp_io *io, uint16_t *size) {
+#if PARROT_WITH_IO_URING
+    if (io->backend == kUdpIoUring) {
+        io->tx_slot = uring_udp_slot(&io->uring, size);
+        return io->tx_slot;
+    }
+#endif
+    io->tx_slot = udp_batch_slot(&io->batch, size);
+    return io->tx_slot;
+}
+
+void udp_io_commit(udp_io *io, const uint16_t length, const struct sockaddr_in *to) {
+    if (io->capture != NULL && length != 0 && io->tx_slot != NULL) {
+        udp_trace_writer_append(io->capture, kUdpTraceTx, io->tx_slot, length, to);
+    }
+
+#if PARROT_WITH_IO_URING
+    if (io->backend == kUdpIoUring) {
+        uring_udp_commit(&io->uring, length, to);
+        return;
+    }
+#endif
+    udp_batch_commit(&io->batch, length, to);
+}
+
+void udp_io_flush(udp_io *io) {
+#if PARROT_WITH_IO_URING
+    if (io->backend == kUdpIoUring) {
+        uring_udp_flush(&io->uring);
+        return;
+    }
+#endif
+    udp_batch_flush(&io->batch);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#include "udp_batch.h"
+#include "udp_trace.h"
+#if PARROT_WITH_IO_URING
+#include "uring_udp.h"
+#endif
+
+typedef enum udp_io_backend {
+    kUdpIoBatch,    // recvmmsg/sendmmsg
+    kUdpIoUring,    // io_uring multishot recvmsg and batched submits
+} udp_io_backend;
+
+/**
+ * @brief UDP socket I/O with a backend chosen at runtime.
+ *
+ * The io_uring backend is compiled in with PARROT_WITH_IO_URING, and falls
+ * back to recvmmsg/sendmmsg if the kernel doesn't support it.
+ *
+ * With a capture trace set, every datagram handled or committed is also
+ * appended to the trace.
+ */
+typedef struct udp_io {
+    udp_io_backend backend;
+    udp_batch batch;
+#if PARROT_WITH_IO_URING
+    uring_udp uring;
+#endif
+    udp_trace_writer *capture;
+    void *tx_slot;              // last slot handed out, for the capture
+} udp_io;
+
+/**
+ * @brief Initialize I/O of a socket
+ * @param io [out] I/O to be initialized
+ * @param fd [in] non-blocking UDP socket
+ * @param backend [in] preferred backend
+ * @return 0 for success, -1 for failure
+ */
+int udp_io_init(udp_io *io, int fd, udp_io_backend backend);
+
+/**
+ * @brief Release resources. The socket is not closed.
+ */
+void udp_io_destroy(udp_io *io);
+
+/**
+ * @brief Record the datagrams of this I/O into a trace, owned by the caller
+ * @param capture [in] open trace writer, NULL to stop capturing
+ */
+static inline void udp_io_set_capture(udp_io *io, udp_trace_writer *capture) {
+    io->capture = capture;
+}
+
+/**
+ * @return File descriptor to watch for readability: the socket or the io_uring instance
+ */
+int udp_io_fd(const udp_io *io);
+
+/**
+ * @return Name of the backend in use
+ */
+const char *udp_io_backend_name(const udp_io *io);
+
+/**
+ * @return I/O counters
+ */
+const udp_batch_stats *udp_io_stats(const udp_io *io);
+
+/**
+ * @brief Handle all received datagrams
+ * @return Number of datagrams handled, -1 on failure
+ */
+int udp_io_receive(udp_io *io, udp_batch_handler handler, void *user_data);
+
+/**
+ * @brief Get the buffer of the next outgoing datagram
+ * @param size [out] buffer size
+ * @return Buffer to write the datagram into, committed by udp_io_commit()
+ */
+void *udp_io_slot(udp_io *io, uint16_t *size);
+
+/**
+ * @brief Queue the datagram written into the buffer returned by udp_io_slot()
+ * @param length [in] datagram length, 0 discards the slot
+ * @param to [in] destination address, NULL for connected sockets
+ */
+void udp_io_commit(udp_io *io, uint16_t length, const struct sockaddr_in *to);
+
+/**
+ * @brief Send all queued datagrams
+ */
+void udp_io_flush(udp_io *io);
+
+#if __cplusplus
+}
+#endif
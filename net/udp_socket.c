@@ -0,0 +1,102 @@
+#include "udp_socket.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int udp_socket_set_nonblock(const int fd) {
+    uint32_t fl = fcntl(fd, F_GETFL, 0);
+    if (fl == 0xFFFFFFFFu) {
+        fprintf(stderr, "fcntl(%d, F_GETFL, 0): %s\n", fd, strerror(errno));
+        return -1;
+    }
+
+    if ((fl & O_NONBLOCK) != 0) {
+        return 0;
+    }
+
+    fl |= (uint32_t) O_NONBLOCK;
+
+    const int ret = fcntl(fd, F_SETFL, fl);
+    if (ret == -1) {
+        fprintf(stderr, "fcntl(%d, F_SETFL, 0): %s", fd, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+int udp_socket_connect(const int sock, const char *host, const uint16_t port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_aton(host, &addr.sin_addr) == 0) {
+        fprintf(stderr, "bad IPv4 address: %s\n", host);
+        return -1;
+    }
+
+    const int n = connect(sock, (struct sockaddr*) &addr, sizeof(addr));
+    if (n < 0) {
+        perror("connect");
+        return -1;
+    }
+
+    return 0;
+}
+
+int udp_socket_bind(const uint16_t local_port, const int buffer_size, const uint32_t flags) {
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        perror("socket");
+        return sock;
+    }
+
+    if (buffer_size > 0) {
+        // best effort: the kernel caps these at net.core.rmem_max / wmem_max
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    }
+
+    if ((flags & UDP_SOCKET_REUSEPORT) != 0) {
+        // the kernel spreads datagrams over the sockets of the port by a hash of the 4-tuple
+        const int on = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+            perror("setsockopt(SO_REUSEPORT)");
+            close(sock);
+            return -1;
+        }
+    }
+
+    // bind to local port
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(local_port);
+    if (0 != bind(sock, (struct sockaddr*) &addr, sizeof(addr))) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+
+    const int n = udp_socket_set_nonblock(sock);
+    if (n != 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+int udp_socket_set_incoming_cpu(const int sock, const int cpu) {
+    if (setsockopt(sock, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) != 0) {
+        perror("setsockopt(SO_INCOMING_CPU)");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+// bind flags
+#define UDP_SOCKET_REUSEPORT 0x01u  // share the port with other sockets of this process (SO_REUSEPORT)
+
+/**
+ * @brief Make a file descriptor non-blocking
+ * @return 0 for success, -1 for failure
+ */
+int udp_socket_set_nonblock(int fd);
+
+/**
+ * @brief Create a non-blocking UDP socket bound to a local port on all addresses
+ * @param local_port [in] local port, 0 for any
+ * @param buffer_size [in] SO_RCVBUF/SO_SNDBUF size in bytes, 0 keeps the system default
+ * @param flags [in] UDP_SOCKET_* bind flags
+ * @return Socket, -1 for failure
+ */
+int udp_socket_bind(uint16_t local_port, int buffer_size, uint32_t flags);
+
+/**
+ * @brief Prefer this socket for datagrams received on a CPU (SO_INCOMING_CPU).
+ *
+ * Among SO_REUSEPORT sockets of a port, the kernel picks the one whose
+ * incoming CPU matches the CPU that processed the datagram, if any.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int udp_socket_set_incoming_cpu(int sock, int cpu);
+
+/**
+ * @brief Connect a UDP socket to a remote address, so it sends there and receives only from there
+ * @param host [in] IPv4 address
+ * @param port [in] remote port
+ * @return 0 for success, -1 for failure
+ */
+int udp_socket_connect(int sock, const char *host, uint16_t port);
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,253 @@
+#include "udp_trace.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define UDP_TRACE_CHUNK (16u * 1024 * 1024)
+
+static uint64_t udp_trace_clock_ns(const clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static uint64_t udp_trace_record_size(const uint16_t length) {
+    return (sizeof(udp_trace_record) + length + 7) & ~(uint64_t) 7;
+}
+
+/**
+ * @brief Grow the file and its mapping to hold at least size bytes
+ * @return 0 for success, -1 for failure
+ */
+static int udp_trace_grow(udp_trace_writer *writer, const uint64_t size) {
+    uint64_t grown = writer->size;
+    while (grown < size) {
+        grown += UDP_TRACE_CHUNK;
+    }
+
+    if (ftruncate(writer->fd, (off_t) grown) != 0) {
+        return -1;
+    }
+    void *map = mremap(writer->map, writer->size, grown, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        // the file is longer than the mapping now; the close trims it
+        return -1;
+    }
+    writer->map = map;
+    writer->size = grown;
+    return 0;
+}
+
+int udp_trace_writer_open(udp_trace_writer *writer, const char *path) {
+    memset(writer, 0, sizeof(*writer));
+
+    writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    if (ftruncate(writer->fd, UDP_TRACE_CHUNK) != 0) {
+        perror("ftruncate");
+        close(writer->fd);
+        return -1;
+    }
+    void *map = mmap(NULL, UDP_TRACE_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        close(writer->fd);
+        return -1;
+    }
+    writer->map = map;
+    writer->size = UDP_TRACE_CHUNK;
+
+    udp_trace_header *header = (udp_trace_header *) writer->map;
+    memcpy(header->magic, UDP_TRACE_MAGIC, sizeof(header->magic));
+    header->version = UDP_TRACE_VERSION;
+    header->header_size = sizeof(udp_trace_header);
+    header->start_ns = udp_trace_clock_ns(CLOCK_MONOTONIC);
+    header->start_realtime_ns = udp_trace_clock_ns(CLOCK_REALTIME);
+    header->data_end = sizeof(udp_trace_header);
+    return 0;
+}
+
+void udp_trace_writer_append(udp_trace_writer *writer, const udp_trace_direction direction, const void *data,
+                             const uint16_t length, const struct sockaddr_in *peer) {
+    udp_trace_header *header = (udp_trace_header *) writer->map;
+    const uint64_t offset = header->data_end;
+    const uint64_t end = offset + udp_trace_record_size(length);
+
+    if (header->count == writer->index_capacity) {
+        const uint64_t capacity = writer->index_capacity ? writer->index_capacity * 2 : 4096;
+        uint64_t *index = realloc(writer->index, capacity * sizeof(uint64_t));
+        if (index == NULL) {
+            ++writer->dropped;
+            return;
+        }
+        writer->index = index;
+        writer->index_capacity = capacity;
+    }
+    if (end > writer->size) {
+        if (udp_trace_grow(writer, end) != 0) {
+            ++writer->dropped;
+            return;
+        }
+        header = (udp_trace_header *) writer->map;
+    }
+
+    udp_trace_record *record = (udp_trace_record *) (writer->map + offset);
+    record->time_ns = udp_trace_clock_ns(CLOCK_MONOTONIC) - header->start_ns;
+    record->addr = peer != NULL ? peer->sin_addr.s_addr : 0;
+    record->port = peer != NULL ? peer->sin_port : 0;
+    record->length = length;
+    record->direction = (uint8_t) direction;
+    memset(record->reserved, 0, sizeof(record->reserved));
+    memcpy(record + 1, data, length);
+
+    writer->index[header->count] = offset;
+    // publish the record after its bytes
+    header->data_end = end;
+    header->count++;
+}
+
+int udp_trace_writer_close(udp_trace_writer *writer) {
+    if (writer->map == NULL) {
+        return 0;
+    }
+
+    udp_trace_header *header = (udp_trace_header *) writer->map;
+    const uint64_t index_offset = header->data_end;
+    const uint64_t index_size = header->count * sizeof(uint64_t);
+
+    int ret = -1;
+    if (index_offset + index_size <= writer->size || udp_trace_grow(writer, index_offset + index_size) == 0) {
+        header = (udp_trace_header *) writer->map;
+        if (index_size != 0) {
+            memcpy(writer->map + index_offset, writer->index, index_size);
+        }
+        header->index_offset = index_offset;
+        ret = 0;
+    }
+
+    const uint64_t file_size = header->index_offset != 0 ? index_offset + index_size : index_offset;
+    munmap(writer->map, writer->size);
+    if (ftruncate(writer->fd, (off_t) file_size) != 0) {
+        ret = -1;
+    }
+    close(writer->fd);
+    free(writer->index);
+    memset(writer, 0, sizeof(*writer));
+    return ret;
+}
+
+/**
+ * @return Whether a record lies within [offset, end) of the mapping
+ */
+static int udp_trace_record_valid(const udp_trace_reader *reader, const uint64_t offset, const uint64_t end) {
+    if ((offset & 7) != 0 || offset < reader->header->header_size || offset + sizeof(udp_trace_record) > end) {
+        return 0;
+    }
+    const udp_trace_record *record = (const udp_trace_record *) (reader->map + offset);
+    return offset + udp_trace_record_size(record->length) <= end;
+}
+
+/**
+ * @brief Rebuild the index of a trace whose writer didn't close it
+ */
+static int udp_trace_scan(udp_trace_reader *reader) {
+    const uint64_t count = reader->header->count;
+    const uint64_t end = reader->header->data_end;
+    // every record takes at least a record header: a larger count is corrupted, and could wrap the size
+    if (count > (end - reader->header->header_size) / sizeof(udp_trace_record)) {
+        return -1;
+    }
+    reader->scanned = malloc((count != 0 ? count : 1) * sizeof(uint64_t));
+    if (reader->scanned == NULL) {
+        return -1;
+    }
+
+    uint64_t offset = reader->header->header_size;
+    for (uint64_t i = 0; i < count; i++) {
+        if (!udp_trace_record_valid(reader, offset, end)) {
+            return -1;
+        }
+        reader->scanned[i] = offset;
+        offset += udp_trace_record_size(((const udp_trace_record *) (reader->map + offset))->length);
+    }
+    reader->index = reader->scanned;
+    return 0;
+}
+
+int udp_trace_reader_open(udp_trace_reader *reader, const char *path) {
+    memset(reader, 0, sizeof(*reader));
+
+    reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (reader->fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0 || (uint64_t) st.st_size < sizeof(udp_trace_header)) {
+        fprintf(stderr, "%s: not a trace\n", path);
+        close(reader->fd);
+        return -1;
+    }
+    reader->size = (uint64_t) st.st_size;
+
+    void *map = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        close(reader->fd);
+        return -1;
+    }
+    reader->map = map;
+    reader->header = map;
+
+    const udp_trace_header *header = reader->header;
+    if (memcmp(header->magic, UDP_TRACE_MAGIC, sizeof(header->magic)) != 0 || header->version != UDP_TRACE_VERSION
+        || header->header_size < sizeof(udp_trace_header)) {
+        fprintf(stderr, "%s: not a trace, or of another version\n", path);
+        udp_trace_reader_close(reader);
+        return -1;
+    }
+    if (header->data_end > reader->size || header->data_end < header->header_size) {
+        fprintf(stderr, "%s: truncated trace\n", path);
+        udp_trace_reader_close(reader);
+        return -1;
+    }
+
+    int valid = 1;
+    if (header->index_offset != 0) {
+        valid = header->index_offset == header->data_end
+                && header->count <= (reader->size - header->index_offset) / sizeof(uint64_t);
+        reader->index = (const uint64_t *) (reader->map + header->index_offset);
+        for (uint64_t i = 0; valid && i < header->count; i++) {
+            valid = udp_trace_record_valid(reader, reader->index[i], header->data_end);
+        }
+    } else {
+        valid = udp_trace_scan(reader) == 0;
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: corrupted trace\n", path);
+        udp_trace_reader_close(reader);
+        return -1;
+    }
+    reader->count = header->count;
+    return 0;
+}
+
+void udp_trace_reader_close(udp_trace_reader *reader) {
+    if (reader->map != NULL) {
+        munmap((void *) reader->map, reader->size);
+        close(reader->fd);
+    }
+    free(reader->scanned);
+    memset(reader, 0, sizeof(*reader));
+}
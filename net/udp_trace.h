@@ -0,0 +1,125 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <netinet/in.h>
+
+#define UDP_TRACE_MAGIC "PRTTRACE"
+#define UDP_TRACE_VERSION 1
+
+typedef enum udp_trace_direction {
+    kUdpTraceRx,    // received datagram
+    kUdpTraceTx,    // sent datagram
+} udp_trace_direction;
+
+/**
+ * @brief File header of a trace, in host byte order.
+ *
+ * count and data_end are updated after every record, so the trace of a
+ * process that died is readable up to its last record. The index of
+ * record offsets is written when the trace is closed.
+ */
+typedef struct udp_trace_header {
+    char magic[8];              // UDP_TRACE_MAGIC
+    uint32_t version;
+    uint32_t header_size;       // offset of the first record
+    uint64_t start_ns;          // CLOCK_MONOTONIC when the trace was created
+    uint64_t start_realtime_ns; // CLOCK_REALTIME when the trace was created
+    uint64_t count;             // committed records
+    uint64_t data_end;          // offset after the last committed record
+    uint64_t index_offset;      // offset of count uint64_t record offsets, 0 until the trace is closed
+    uint64_t reserved;
+} udp_trace_header;
+
+/**
+ * @brief Record header, followed by the datagram padded to 8 bytes
+ */
+typedef struct udp_trace_record {
+    uint64_t time_ns;           // since udp_trace_header.start_ns
+    uint32_t addr;              // peer IPv4 address in network byte order, 0 if the socket is connected
+    uint16_t port;              // peer port in network byte order
+    uint16_t length;            // datagram length
+    uint8_t direction;          // udp_trace_direction
+    uint8_t reserved[7];
+} udp_trace_record;
+
+/**
+ * @brief Append-only trace file of datagrams, written through a shared memory mapping.
+ *
+ * The file grows by UDP_TRACE_CHUNK with ftruncate() and mremap(); an append
+ * is a copy into the mapping and never a system call of its own. A writer
+ * belongs to one thread.
+ */
+typedef struct udp_trace_writer {
+    int fd;
+    uint8_t *map;               // NULL when the writer isn't open
+    uint64_t size;              // mapped bytes, the file size while writing
+    uint64_t *index;            // offsets of the records
+    uint64_t index_capacity;
+    uint64_t dropped;           // records not written because the file couldn't grow
+} udp_trace_writer;
+
+/**
+ * @brief Read-only mapping of a trace
+ */
+typedef struct udp_trace_reader {
+    int fd;
+    const uint8_t *map;
+    uint64_t size;
+    const udp_trace_header *header;
+    const uint64_t *index;      // offsets of the records, from the file or rebuilt by a scan
+    uint64_t count;
+    uint64_t *scanned;          // index rebuilt for a trace that wasn't closed
+} udp_trace_reader;
+
+/**
+ * @brief Create (or truncate) a trace file
+ * @param writer [out] writer to be initialized
+ * @param path [in] file path
+ * @return 0 for success, -1 for failure
+ */
+int udp_trace_writer_open(udp_trace_writer *writer, const char *path);
+
+/**
+ * @brief Append a datagram, stamped with the monotonic clock
+ * @param peer [in] source or destination address, NULL if the socket is connected
+ */
+void udp_trace_writer_append(udp_trace_writer *writer, udp_trace_direction direction, const void *data,
+                             uint16_t length, const struct sockaddr_in *peer);
+
+/**
+ * @brief Write the index, trim the file to its contents and close it. A zeroed writer is ignored.
+ * @return 0 for success, -1 if the index couldn't be written (the records are kept)
+ */
+int udp_trace_writer_close(udp_trace_writer *writer);
+
+/**
+ * @brief Map a trace for reading, and check its header and records
+ * @return 0 for success, -1 for failure
+ */
+int udp_trace_reader_open(udp_trace_reader *reader, const char *path);
+
+/**
+ * @brief Unmap a trace. A zeroed reader is ignored.
+ */
+void udp_trace_reader_close(udp_trace_reader *reader);
+
+/**
+ * @return Record i of the trace, i < reader->count
+ */
+static inline const udp_trace_record *udp_trace_reader_at(const udp_trace_reader *reader, const uint64_t i) {
+    return (const udp_trace_record *) (reader->map + reader->index[i]);
+}
+
+/**
+ * @return Datagram of a record
+ */
+static inline const uint8_t *udp_trace_record_data(const udp_trace_record *record) {
+    return (const uint8_t *) (record + 1);
+}
+
+#if __cplusplus
+}
+#endif
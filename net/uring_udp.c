@@ -0,0 +1,486 @@
+#include "uring_udp.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#define URING_RECV_TAG 0xFFFFFFFFull
+#define URING_BUF_GROUP 0
+
+static int sys_io_uring_setup(const unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(const int fd, const unsigned to_submit, const unsigned min_complete,
+                              const unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(const int fd, const unsigned opcode, void *arg, const unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static struct io_uring_sqe *uring_udp_get_sqe(uring_udp *ring) {
+    const uint32_t head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        uring_udp_flush(ring);
+        if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+static void uring_udp_recycle_buffer(uring_udp *ring, const uint16_t bid) {
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (ring->buf_count - 1)];
+    buf->addr = (uint64_t) (uintptr_t) (ring->rx_buf + (size_t) bid * ring->buf_size);
+    buf->len = ring->buf_size;
+    buf->bid = bid;
+    ring->buf_tail++;
+}
+
+static void uring_udp_publish_buffers(uring_udp *ring) {
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int uring_udp_arm_recv(uring_udp *ring) {
+    struct io_uring_sqe *sqe = uring_udp_get_sqe(ring);
+    if (sqe == NULL) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = ring->sock;
+    sqe->addr = (uint64_t) (uintptr_t) &ring->rx_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = URING_RECV_TAG;
+    ring->recv_armed = 1;
+    ring->recv_fresh = 1;
+    return 0;
+}
+
+/**
+ * @return Whether a receive completion says the kernel rejects the request itself, not a socket error
+ */
+static int uring_udp_recv_rejected(const struct io_uring_cqe *cqe) {
+    return !(cqe->flags & IORING_CQE_F_MORE) && (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP);
+}
+
+/**
+ * @brief Check that the receive just armed was accepted
+ * @return 0 if it runs, -1 if the kernel rejected it
+ */
+static int uring_udp_check_recv(uring_udp *ring) {
+    // a rejected request completes during submission: its completion is already posted
+    const uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (uint32_t head = *ring->cq_head; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        if (cqe->user_data == URING_RECV_TAG && uring_udp_recv_rejected(cqe)) {
+            fprintf(stderr, "io_uring multishot recvmsg: %s\n", strerror(-cqe->res));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int uring_udp_map_rings(uring_udp *ring, const struct io_uring_params *params) {
+    ring->sq_map_size = params->sq_off.array + params->sq_entries * sizeof(uint32_t);
+    ring->cq_map_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+        ring->cq_map_size = 0;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return -1;
+    }
+
+    if (ring->cq_map_size == 0) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return -1;
+        }
+    }
+
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    uint8_t *sq = ring->sq_ptr;
+    ring->sq_head = (uint32_t *) (sq + params->sq_off.head);
+    ring->sq_tail = (uint32_t *) (sq + params->sq_off.tail);
+    ring->sq_mask = *(uint32_t *) (sq + params->sq_off.ring_mask);
+    ring->sq_entries = params->sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sq_submitted = ring->sq_local_tail;
+
+    // sqes are always used in ring order, so the index array is an identity mapping
+    uint32_t *array = (uint32_t *) (sq + params->sq_off.array);
+    for (uint32_t i = 0; i < params->sq_entries; i++) {
+        array[i] = i;
+    }
+
+    uint8_t *cq = ring->cq_ptr;
+    ring->cq_head = (uint32_t *) (cq + params->cq_off.head);
+    ring->cq_tail = (uint32_t *) (cq + params->cq_off.tail);
+    ring->cq_mask = *(uint32_t *) (cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params->cq_off.cqes);
+    return 0;
+}
+
+static int uring_udp_setup_buffers(uring_udp *ring, const uint16_t rx_buffers) {
+    ring->buf_count = rx_buffers;
+    // recvmsg result header, source address, then the payload
+    ring->buf_size = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + UDP_BATCH_SLOT_SIZE;
+
+    ring->rx_buf = malloc((size_t) rx_buffers * ring->buf_size);
+    if (ring->rx_buf == NULL) {
+        return -1;
+    }
+
+    ring->buf_ring_size = rx_buffers * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) ring->buf_ring;
+    reg.ring_entries = rx_buffers;
+    reg.bgid = URING_BUF_GROUP;
+    if (sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        fprintf(stderr, "io_uring_register(PBUF_RING): %s\n", strerror(errno));
+        munmap(ring->buf_ring, ring->buf_ring_size);
+        ring->buf_ring = NULL;
+        return -1;
+    }
+
+    ring->buf_tail = 0;
+    for (uint16_t i = 0; i < rx_buffers; i++) {
+        uring_udp_recycle_buffer(ring, i);
+    }
+    uring_udp_publish_buffers(ring);
+
+    memset(&ring->rx_msg, 0, sizeof(ring->rx_msg));
+    ring->rx_msg.msg_namelen = sizeof(struct sockaddr_in);
+    return 0;
+}
+
+static int uring_udp_setup_tx(uring_udp *ring, const uint16_t tx_slots) {
+    ring->tx_capacity = tx_slots;
+    ring->tx_free_count = tx_slots;
+    ring->tx_current = -1;
+    ring->tx_free = calloc(tx_slots, sizeof(uint16_t));
+    ring->tx_buf = malloc((size_t) tx_slots * UDP_BATCH_SLOT_SIZE);
+    ring->tx_msg = calloc(tx_slots, sizeof(struct msghdr));
+    ring->tx_iov = calloc(tx_slots, sizeof(struct iovec));
+    ring->tx_addr = calloc(tx_slots, sizeof(struct sockaddr_in));
+    if (ring->tx_free == NULL || ring->tx_buf == NULL || ring->tx_msg == NULL || ring->tx_iov == NULL
+        || ring->tx_addr == NULL) {
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < tx_slots; i++) {
+        ring->tx_free[i] = (uint16_t) (tx_slots - 1 - i);
+        ring->tx_iov[i].iov_base = ring->tx_buf + (size_t) i * UDP_BATCH_SLOT_SIZE;
+        ring->tx_msg[i].msg_iov = &ring->tx_iov[i];
+        ring->tx_msg[i].msg_iovlen = 1;
+    }
+    return 0;
+}
+
+int uring_udp_init(uring_udp *ring, const int sock, const uint16_t rx_buffers, const uint16_t tx_slots) {
+    memset(ring, 0, sizeof(*ring));
+    ring->sock = sock;
+
+    if (rx_buffers == 0 || (rx_buffers & (rx_buffers - 1)) != 0) {
+        fprintf(stderr, "io_uring: receive buffer count must be a power of 2\n");
+        return -1;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = (uint32_t) rx_buffers * 2 + tx_slots;
+
+    ring->ring_fd = sys_io_uring_setup((unsigned) tx_slots + 8, &params);
+    if (ring->ring_fd < 0) {
+        fprintf(stderr, "io_uring_setup: %s\n", strerror(errno));
+        return -1;
+    }
+
+    ring->deferred_capacity = (uint32_t) rx_buffers + 16;
+    ring->deferred = calloc(ring->deferred_capacity, sizeof(struct io_uring_cqe));
+    if (ring->deferred == NULL || uring_udp_map_rings(ring, &params) != 0 || uring_udp_setup_buffers(ring, rx_buffers) != 0
+        || uring_udp_setup_tx(ring, tx_slots) != 0 || uring_udp_arm_recv(ring) != 0 || uring_udp_flush(ring) != 1
+        || uring_udp_check_recv(ring) != 0) {
+        uring_udp_destroy(ring);
+        return -1;
+    }
+    return 0;
+}
+
+void uring_udp_destroy(uring_udp *ring) {
+    if (ring->buf_ring != NULL) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_map_size);
+    }
+    if (ring->sq_ptr != NULL) {
+        munmap(ring->sq_ptr, ring->sq_map_size);
+    }
+    if (ring->ring_fd > 0) {
+        // closing the ring cancels the multishot receive and in-flight sends
+        close(ring->ring_fd);
+    }
+
+    free(ring->rx_buf);
+    free(ring->deferred);
+    free(ring->tx_free);
+    free(ring->tx_buf);
+    free(ring->tx_msg);
+    free(ring->tx_iov);
+    free(ring->tx_addr);
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+    ring->sock = -1;
+}
+
+static void uring_udp_on_recv(uring_udp *ring, const struct io_uring_cqe *cqe, const udp_batch_handler handler,
+                              void *user_data) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        // multishot request terminated (buffers ran out, or socket error); re-armed after this batch
+        ring->recv_armed = 0;
+    }
+
+    if (cqe->res < 0) {
+        if (cqe->res != -ENOBUFS) {
+            LOG_WARN("io_uring recvmsg: %s", LOG_STR(strerror(-cqe->res), -1));
+            if (ring->recv_fresh && uring_udp_recv_rejected(cqe)) {
+                // rejected before receiving anything: re-arming would fail the same way, in a busy loop
+                ring->recv_failed = 1;
+            }
+        }
+        return;
+    }
+    ring->recv_fresh = 0;
+
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+        return;
+    }
+
+    const uint16_t bid = (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    uint8_t *buf = ring->rx_buf + (size_t) bid * ring->buf_size;
+    const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out *) buf;
+    const uint8_t *name = buf + sizeof(*out);
+    const uint8_t *payload = name + ring->rx_msg.msg_namelen + ring->rx_msg.msg_controllen;
+
+    const uint32_t room = (uint32_t) (buf + ring->buf_size - payload);
+    const uint32_t length = out->payloadlen < room ? out->payloadlen : room;
+
+    struct sockaddr_in from;
+    memset(&from, 0, sizeof(from));
+    memcpy(&from, name, out->namelen < sizeof(from) ? out->namelen : sizeof(from));
+
+    ring->stats.rx_datagrams++;
+    if ((out->flags & MSG_TRUNC) || out->payloadlen > room) {
+        // longer than a buffer: what's left of it can't be parsed
+        ring->stats.rx_dropped++;
+    } else if (length > 0) {
+        handler(user_data, payload, (uint16_t) length, &from);
+    }
+
+    uring_udp_recycle_buffer(ring, bid);
+}
+
+static void uring_udp_on_send(uring_udp *ring, const struct io_uring_cqe *cqe) {
+    const uint16_t slot = (uint16_t) cqe->user_data;
+    if (cqe->res < 0) {
+        LOG_WARN("io_uring sendmsg: %s", LOG_STR(strerror(-cqe->res), -1));
+        ring->stats.tx_dropped++;
+    } else {
+        ring->stats.tx_datagrams++;
+    }
+
+    ring->tx_free[ring->tx_free_count++] = slot;
+}
+
+static int uring_udp_reap(uring_udp *ring, const udp_batch_handler handler, void *user_data) {
+    int received = 0;
+    while (1) {
+        const uint32_t head = *ring->cq_head;
+        if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // consume the entry before handling it: handlers may queue sends, which can reap again
+        const struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+        if (cqe.user_data != URING_RECV_TAG) {
+            uring_udp_on_send(ring, &cqe);
+        } else if (handler != NULL) {
+            uring_udp_on_recv(ring, &cqe, handler, user_data);
+            received++;
+        } else if (ring->deferred_count < ring->deferred_capacity) {
+            // reaped while waiting for a send slot, handled by the next uring_udp_receive()
+            ring->deferred[ring->deferred_count++] = cqe;
+        } else {
+            ring->stats.rx_dropped++;
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                uring_udp_recycle_buffer(ring, (uint16_t) (cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                ring->recv_armed = 0;
+            }
+        }
+    }
+
+    if (received > 0) {
+        ring->stats.rx_calls++;
+    }
+    uring_udp_publish_buffers(ring);
+    return received;
+}
+
+int uring_udp_receive(uring_udp *ring, const udp_batch_handler handler, void *user_data) {
+    int total = 0;
+    do {
+        for (uint32_t i = 0; i < ring->deferred_count; i++) {
+            uring_udp_on_recv(ring, &ring->deferred[i], handler, user_data);
+            total++;
+        }
+        ring->deferred_count = 0;
+
+        total += uring_udp_reap(ring, handler, user_data);
+    } while (ring->deferred_count > 0);
+
+    if (ring->recv_failed) {
+        return -1;
+    }
+    if (!ring->recv_armed) {
+        if (uring_udp_arm_recv(ring) != 0) {
+            return -1;
+        }
+        uring_udp_flush(ring);
+    }
+    return total;
+}
+
+void *uring_udp_slot(uring_udp *ring, uint16_t *size) {
+    *size = UDP_BATCH_SLOT_SIZE;
+    if (ring->tx_current >= 0) {
+        return ring->tx_iov[ring->tx_current].iov_base;
+    }
+
+    while (ring->tx_free_count == 0) {
+        // every slot is in flight: submit what's queued and wait for a send to complete
+        uring_udp_flush(ring);
+        const int n = sys_io_uring_enter(ring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (n < 0 && errno != EINTR) {
+            LOG_WARN("io_uring_enter: %s", LOG_STR(strerror(errno), -1));
+        }
+        uring_udp_reap(ring, NULL, NULL);
+    }
+
+    ring->tx_current = ring->tx_free[--ring->tx_free_count];
+    return ring->tx_iov[ring->tx_current].iov_base;
+}
+
+void uring_udp_commit(uring_udp *ring, const uint16_t length, const struct sockaddr_in *to) {
+    const int32_t slot = ring->tx_current;
+    if (slot < 0) {
+        return;
+    }
+    ring->tx_current = -1;
+
+    if (length == 0) {
+        ring->tx_free[ring->tx_free_count++] = (uint16_t) slot;
+        return;
+    }
+
+    struct msghdr *msg = &ring->tx_msg[slot];
+    ring->tx_iov[slot].iov_len = length;
+    if (to != NULL) {
+        ring->tx_addr[slot] = *to;
+        msg->msg_name = &ring->tx_addr[slot];
+        msg->msg_namelen = sizeof(struct sockaddr_in);
+    } else {
+        msg->msg_name = NULL;
+        msg->msg_namelen = 0;
+    }
+
+    struct io_uring_sqe *sqe = uring_udp_get_sqe(ring);
+    if (sqe == NULL) {
+        ring->stats.tx_dropped++;
+        ring->tx_free[ring->tx_free_count++] = (uint16_t) slot;
+        return;
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = ring->sock;
+    sqe->addr = (uint64_t) (uintptr_t) msg;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t) slot;
+}
+
+int uring_udp_flush(uring_udp *ring) {
+    const uint32_t pending = ring->sq_local_tail - ring->sq_submitted;
+    if (pending == 0) {
+        return 0;
+    }
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    int submitted = 0;
+    while ((uint32_t) submitted < pending) {
+        const int n = sys_io_uring_enter(ring->ring_fd, pending - submitted, 0, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_WARN("io_uring_enter: %s", LOG_STR(strerror(errno), -1));
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        submitted += n;
+    }
+
+    ring->sq_submitted += (uint32_t) submitted;
+    ring->stats.tx_calls++;
+    return submitted;
+}
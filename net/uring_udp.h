@@ -0,0 +1,126 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "udp_batch.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+/**
+ * @brief io_uring based I/O of one UDP socket.
+ *
+ * Datagrams are received by a single multishot recvmsg request into a ring
+ * of provided buffers, so no syscall is needed per datagram. Outgoing
+ * datagrams are queued as sendmsg requests and submitted together by
+ * uring_udp_flush().
+ *
+ * The ring descriptor becomes readable when completions are pending, and
+ * is watched by the event loop instead of the socket.
+ *
+ * Multishot recvmsg needs Linux 6.0; some earlier kernels have provided
+ * buffer rings but reject it. uring_udp_init() submits the receive and
+ * fails if it is rejected, so that the caller falls back to recvmmsg.
+ */
+typedef struct uring_udp {
+    int ring_fd;
+    int sock;
+
+    // submission queue
+    void *sq_ptr;
+    size_t sq_map_size;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t sq_local_tail;
+    uint32_t sq_submitted;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    // completion queue
+    void *cq_ptr;
+    size_t cq_map_size;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // provided receive buffers
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    uint16_t buf_count;
+    uint16_t buf_tail;
+    uint32_t buf_size;
+    uint8_t *rx_buf;
+    struct msghdr rx_msg;
+    uint8_t recv_armed;
+    uint8_t recv_fresh;     // armed, and nothing received since
+    uint8_t recv_failed;    // the receive can't be armed: uring_udp_receive() fails
+    struct io_uring_cqe *deferred;
+    uint32_t deferred_count;
+    uint32_t deferred_capacity;
+
+    // outgoing datagrams
+    uint16_t tx_capacity;
+    uint16_t tx_free_count;
+    uint16_t *tx_free;
+    int32_t tx_current;
+    uint8_t *tx_buf;
+    struct msghdr *tx_msg;
+    struct iovec *tx_iov;
+    struct sockaddr_in *tx_addr;
+
+    udp_batch_stats stats;
+} uring_udp;
+
+/**
+ * @brief Set up the ring, register provided buffers and arm the multishot receive
+ * @param ring [out] ring to be initialized
+ * @param sock [in] UDP socket
+ * @param rx_buffers [in] number of provided receive buffers (power of 2)
+ * @param tx_slots [in] maximum number of outgoing datagrams in flight
+ * @return 0 for success, -1 if io_uring (or a required feature, such as multishot recvmsg) is unavailable
+ */
+int uring_udp_init(uring_udp *ring, int sock, uint16_t rx_buffers, uint16_t tx_slots);
+
+/**
+ * @brief Tear down the ring. The socket is not closed.
+ */
+void uring_udp_destroy(uring_udp *ring);
+
+/**
+ * @brief Handle all pending completions: received datagrams and finished sends
+ * @return Number of datagrams handled, -1 on failure (the kernel rejected the receive, which is not re-armed)
+ */
+int uring_udp_receive(uring_udp *ring, udp_batch_handler handler, void *user_data);
+
+/**
+ * @brief Get the buffer of the next outgoing datagram, waiting for an in-flight send if all slots are busy
+ * @param size [out] buffer size (UDP_BATCH_SLOT_SIZE)
+ * @return Buffer to write the datagram into, committed by uring_udp_commit()
+ */
+void *uring_udp_slot(uring_udp *ring, uint16_t *size);
+
+/**
+ * @brief Queue a sendmsg request for the buffer returned by uring_udp_slot()
+ * @param length [in] datagram length, 0 discards the slot
+ * @param to [in] destination address, NULL for connected sockets
+ */
+void uring_udp_commit(uring_udp *ring, uint16_t length, const struct sockaddr_in *to);
+
+/**
+ * @brief Submit all queued requests with one io_uring_enter()
+ * @return Number of requests submitted
+ */
+int uring_udp_flush(uring_udp *ring);
+
+#if __cplusplus
+}
+#endif
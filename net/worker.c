@@ -0,0 +1,105 @@
+#include "worker.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void *worker_main(void *arg) {
+    worker *w = arg;
+
+    // pin before running, so memory the worker allocates is first touched on its own node
+    if (w->cpu >= 0 && worker_pin_current(w->cpu) != 0) {
+        fprintf(stderr, "worker %u: failed to pin to cpu %d\n", w->index, w->cpu);
+    }
+
+    w->run(w->arg);
+    return NULL;
+}
+
+int worker_start(worker *w, const uint32_t index, const int cpu, const worker_function run, void *arg) {
+    w->index = index;
+    w->cpu = cpu;
+    w->run = run;
+    w->arg = arg;
+    w->started = 0;
+
+    // the new thread inherits the signal mask: block everything while creating it
+    sigset_t all;
+    sigset_t saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    const int ret = pthread_create(&w->thread, NULL, worker_main, w);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (ret != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(ret));
+        return -1;
+    }
+
+    w->started = 1;
+    return 0;
+}
+
+void worker_join(worker *w) {
+    if (w->started) {
+        pthread_join(w->thread, NULL);
+        w->started = 0;
+    }
+}
+
+int worker_pin_current(const int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return -1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+int worker_parse_cpu_list(const char *list, int *cpus, const int max) {
+    int count = 0;
+    const char *p = list;
+
+    while (*p != '\0') {
+        char *end;
+        const long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return -1;
+        }
+
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return -1;
+            }
+        }
+
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count == max) {
+                return -1;
+            }
+            cpus[count++] = (int) cpu;
+        }
+
+        if (*end == ',') {
+            ++end;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        p = end;
+    }
+
+    return count;
+}
+
+uint32_t worker_cpu_count(void) {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t) n : 1;
+}
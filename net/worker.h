@@ -0,0 +1,66 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <pthread.h>
+#include <stdint.h>
+
+#define WORKER_MAX_COUNT 64
+
+typedef void (*worker_function)(void *arg);
+
+/**
+ * @brief A thread running one shard of the work, optionally pinned to a CPU.
+ *
+ * Workers share nothing on the hot path: each owns its socket, event loop
+ * and state, and only the spawning thread touches them before start and
+ * after join. Signals are blocked in workers, so they are delivered to the
+ * spawning thread.
+ */
+typedef struct worker {
+    pthread_t thread;
+    uint32_t index;
+    int cpu;                // CPU the worker is pinned to, -1 for none
+    worker_function run;
+    void *arg;
+    uint8_t started;
+} worker;
+
+/**
+ * @brief Start a worker thread
+ * @param index [in] worker index, for logging
+ * @param cpu [in] CPU to pin the thread to, -1 to let it float
+ * @param run [in] thread body
+ * @param arg [in] argument passed to run
+ * @return 0 for success, -1 for failure
+ */
+int worker_start(worker *w, uint32_t index, int cpu, worker_function run, void *arg);
+
+/**
+ * @brief Wait for a worker thread to finish
+ */
+void worker_join(worker *w);
+
+/**
+ * @brief Pin the calling thread to a CPU
+ * @return 0 for success, -1 for failure
+ */
+int worker_pin_current(int cpu);
+
+/**
+ * @brief Parse a CPU list such as "0,2,4-7"
+ * @param cpus [out] CPU numbers in list order
+ * @param max [in] capacity of cpus
+ * @return Number of CPUs parsed, -1 for a malformed list
+ */
+int worker_parse_cpu_list(const char *list, int *cpus, int max);
+
+/**
+ * @return Number of online CPUs, at least 1
+ */
+uint32_t worker_cpu_count(void);
+
+#if __cplusplus
+}
+#endif
@@ -1,48 +1,139 @@
 #include "c_string.h"
 
 
-#include <assert.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define C_ARENA_ALIGN 16
+
+int c_arena_init(c_arena *arena, const uint32_t capacity) {
+    memset(arena, 0, sizeof(*arena));
+    arena->base = malloc(capacity);
+    if (arena->base == NULL) {
+        return -1;
+    }
+
+    arena->capacity = capacity;
+    return 0;
+}
+
+void c_arena_destroy(c_arena *arena) {
+    free(arena->base);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void *c_arena_alloc(c_arena *arena, const uint32_t size) {
+    const uint32_t start = (arena->used + C_ARENA_ALIGN - 1) & ~(uint32_t) (C_ARENA_ALIGN - 1);
+    if (start > arena->capacity || size > arena->capacity - start) {
+        arena->exhausted++;
+        return NULL;
+    }
+
+    arena->used = start + size;
+    return arena->base + start;
+}
+
 static size_t c_calculate_capacity(const size_t size) {
-    size_t capacity = 16;
+    size_t capacity = C_STRING_INLINE_CAPACITY * 2;
     while (capacity < size) {
         capacity = capacity << 1;
     }
     return capacity;
 }
 
-static void c_string_ensure_capacity(c_string *str, const size_t length) {
-    if (str->capacity > length + 1) {
-        return;
+/**
+ * @brief Make the string own at least size bytes, keeping its content
+ */
+static parrot_bool c_string_ensure_capacity(c_string *str, const size_t size) {
+    if (str->storage != kStringNone && str->capacity >= size) {
+        return parrot_true;
     }
 
-    const size_t capacity = c_calculate_capacity(length + 1);
+    if (size <= C_STRING_INLINE_CAPACITY && str->storage != kStringHeap && str->storage != kStringArena) {
+        if (str->length != 0 && str->data != str->small) {
+            memmove(str->small, str->data, str->length);
+        }
+        str->data = str->small;
+        str->capacity = C_STRING_INLINE_CAPACITY;
+        str->storage = kStringInline;
+        return parrot_true;
+    }
 
-    void *data = realloc(str->data, capacity);
-    assert(data != NULL);
+    const size_t capacity = c_calculate_capacity(size);
+    if (capacity > UINT32_MAX) {
+        return parrot_false;
+    }
+
+    char *data = NULL;
+    if (str->arena != NULL && str->storage != kStringHeap) {
+        data = c_arena_alloc(str->arena, (uint32_t) capacity);
+        if (data != NULL) {
+            if (str->length != 0) {
+                memcpy(data, str->data, str->length);
+            }
+            str->storage = kStringArena;
+        }
+    }
+
+    if (data == NULL) {
+        if (str->storage == kStringHeap) {
+            data = realloc(str->data, capacity);
+        } else {
+            data = malloc(capacity);
+            if (data != NULL && str->length != 0) {
+                memcpy(data, str->data, str->length);
+            }
+        }
+        if (data == NULL) {
+            return parrot_false;
+        }
+        str->storage = kStringHeap;
+    }
 
     str->data = data;
-    str->capacity = capacity;
+    str->capacity = (uint32_t) capacity;
+    return parrot_true;
 }
 
-void c_string_append(c_string *str, const char *data, int length) {
+void c_string_attach_arena(c_string *str, c_arena *arena) {
+    str->arena = arena;
+}
+
+parrot_bool c_string_reserve(c_string *str, const uint32_t capacity) {
+    return c_string_ensure_capacity(str, (size_t) capacity + 1);
+}
+
+parrot_bool c_string_append_raw_slow(c_string *str, const void *data, const uint32_t length) {
+    if (!c_string_ensure_capacity(str, (size_t) str->length + length)) {
+        return parrot_false;
+    }
+
+    memcpy(str->data + str->length, data, length);
+    str->length += length;
+    return parrot_true;
+}
+
+parrot_bool c_string_append(c_string *str, const char *data, int length) {
     if (length < 0) {
         length = (int) strlen(data);
     }
 
-    c_string_ensure_capacity(str, str->length + length + 1);
+    if (!c_string_ensure_capacity(str, (size_t) str->length + length + 1)) {
+        return parrot_false;
+    }
 
     memcpy(str->data + str->length, data, length);
     str->length += length;
     str->data[str->length] = '\0';
+    return parrot_true;
 }
 
 void c_string_add_char(c_string *str, const char ch) {
-    c_string_ensure_capacity(str, str->length + 1 + 1);
+    if (!c_string_ensure_capacity(str, (size_t) str->length + 1 + 1)) {
+        return;
+    }
     str->data[str->length] = ch;
     str->data[++str->length] = '\0';
 }
@@ -55,18 +146,23 @@ void c_string_assign(c_string *str, const char *data, const int length) {
 
 void c_string_soft_clear(c_string *str) {
     str->length = 0;
+    if (str->storage == kStringArena || str->storage == kStringNone) {
+        // the arena may be reset before the next use
+        str->data = NULL;
+        str->capacity = 0;
+        str->storage = kStringNone;
+    }
 }
 
 void c_string_hard_clear(c_string *str) {
-    if (str->data == NULL) {
-        return;
+    if (str->storage == kStringHeap) {
+        free(str->data);
     }
 
-    free(str->data);
     str->data = NULL;
-
     str->capacity = 0;
     str->length = 0;
+    str->storage = kStringNone;
 }
 
 void c_string_erase(c_string *str, const uint32_t pos, const uint32_t count) {
@@ -86,5 +182,7 @@ void c_string_erase(c_string *str, const uint32_t pos, const uint32_t count) {
     }
 
     str->length = pos + move_count;
-    str->data[str->length] = '\0';
+    if (str->capacity > str->length) {
+        str->data[str->length] = '\0';
+    }
 }
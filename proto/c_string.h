@@ -5,23 +5,94 @@
 extern "C" {
 #endif
 #include <stdint.h>
+#include <string.h>
 
 typedef unsigned char parrot_bool;
 #define parrot_true 1
 #define parrot_false 0
 
+#define C_STRING_INLINE_CAPACITY 64
+
+/**
+ * @brief Bump allocator for short-lived strings, e.g. the payloads of one event loop iteration.
+ *
+ * Allocation moves a cursor through one fixed block; nothing is freed
+ * individually. c_arena_reset() releases everything at once.
+ */
+typedef struct c_arena {
+    char *base;
+    uint32_t capacity;
+    uint32_t used;
+    uint64_t exhausted;     // allocations that didn't fit (served from the heap instead)
+} c_arena;
+
+/**
+ * @brief Where a c_string's data lives
+ */
+typedef enum c_string_storage {
+    kStringNone = 0,    // not owned: NULL, or a view into other memory (capacity 0)
+    kStringInline,      // the string's own small buffer
+    kStringHeap,
+    kStringArena,
+} c_string_storage;
 
 typedef struct c_string c_string;
 
 /**
  * @brief String (TEXT or BINARY) representation in C
+ *
+ * A zero-initialized c_string is empty and valid. Up to
+ * C_STRING_INLINE_CAPACITY - 1 characters are stored in the string itself;
+ * longer strings go to the attached arena if any, otherwise to the heap.
+ * A string holding inline data must not be copied by value.
  */
 struct c_string {
     char *data; // String data
     uint32_t capacity;  // Length of string
     uint32_t length;    // Actual
+    uint8_t storage;    // c_string_storage
+    c_arena *arena;     // grow into this arena when set
+    char small[C_STRING_INLINE_CAPACITY];
 };
 
+/**
+ * @brief Set up an arena
+ * @return 0 for success, -1 for failure
+ */
+int c_arena_init(c_arena *arena, uint32_t capacity);
+
+/**
+ * @brief Release an arena's block
+ */
+void c_arena_destroy(c_arena *arena);
+
+/**
+ * @brief Allocate from an arena, 16-byte aligned
+ * @return Memory valid until the next c_arena_reset(), NULL if the arena is full
+ */
+void *c_arena_alloc(c_arena *arena, uint32_t size);
+
+/**
+ * @brief Release all allocations. Strings that grew into the arena must have been cleared first.
+ */
+static inline void c_arena_reset(c_arena *arena) {
+    arena->used = 0;
+}
+
+/**
+ * @brief Grow a string into an arena from now on, NULL to go back to the heap
+ *
+ * Clearing the string (soft or hard) lets go of arena storage, so that the
+ * arena can be reset between uses of the string.
+ */
+void c_string_attach_arena(c_string *str, c_arena *arena);
+
+/**
+ * @brief Make room for at least capacity characters (and the NUL terminator) without reallocating
+ * @return parrot_true for success, parrot_false if memory ran out (the string is unchanged)
+ */
+parrot_bool c_string_reserve(c_string *str, uint32_t capacity);
+
 /**
  * @brief Assign content to string
  *
@@ -37,8 +108,28 @@ void c_string_assign(c_string *str, const char *data, int length);
  * @param str [out] String to be modified
  * @param data [in] Data pointer
  * @param length [in] Data length
+ * @return parrot_true for success, parrot_false if memory ran out
  */
-void c_string_append(c_string *str, const char *data, int length);
+parrot_bool c_string_append(c_string *str, const char *data, int length);
+
+parrot_bool c_string_append_raw_slow(c_string *str, const void *data, uint32_t length);
+
+/**
+ * @brief Append binary data without NUL-terminating the string
+ *
+ * For strings built only to be sent, e.g. payloads. If there's room
+ * this is a bounds check and a memcpy.
+ *
+ * @return parrot_true for success, parrot_false if memory ran out
+ */
+static inline parrot_bool c_string_append_raw(c_string *str, const void *data, const uint32_t length) {
+    if ((uint64_t) str->length + length <= str->capacity) {
+        memcpy(str->data + str->length, data, length);
+        str->length += length;
+        return parrot_true;
+    }
+    return c_string_append_raw_slow(str, data, length);
+}
 
 /**
  * @brief Append a character to string
@@ -50,6 +141,8 @@ void c_string_add_char(c_string *str, char ch);
 /**
  * @brief Clears a string's contents, without deallocating the storage
  *
+ * Arena storage is let go of.
+ *
  * @param str [out] String to be cleared
  */
 void c_string_soft_clear(c_string *str);
@@ -0,0 +1,213 @@
+#include "parrot_builder.h"
+#include "parrot_checksum.h"
+#include "parrot_payload.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#define PARROT_MAX_PAYLOAD 500
+
+static uint16_t builder_varint2_size(const uint16_t value) {
+    return value == 0 ? 0 : value < 128 ? 1 : 2;
+}
+
+static uint16_t builder_put_varint2(uint8_t *bytes, const uint16_t value) {
+    if (value == 0) {
+        return 0;
+    }
+
+    if (value > 127) {
+        bytes[0] = (uint8_t) (value | 0x80);
+        bytes[1] = (uint8_t) (value >> 7);
+        return 2;
+    }
+
+    bytes[0] = (uint8_t) value;
+    return 1;
+}
+
+void parrot_builder_begin(parrot_builder *b, void *buf, const uint16_t size, const uint32_t device,
+                          const uint16_t command, const uint16_t serial) {
+    b->bytes = buf;
+    b->size = size;
+    b->flags = 0x01 << 6; // version
+    b->failed = parrot_false;
+
+    // magic, flags, device, command, serial; the payload length byte is needed only with a payload
+    const uint16_t header_size = 2 + (device ? 4 : 0) + builder_varint2_size(command) + builder_varint2_size(serial);
+    if (size < header_size) {
+        b->failed = parrot_true;
+        b->length_pos = 0;
+        b->pos = 1;
+        return;
+    }
+
+    uint16_t pos = 2;
+    b->bytes[0] = 0xFF;
+    if (device) {
+        const uint32_t device_be = htonl(device);
+        memcpy(b->bytes + pos, &device_be, sizeof(device_be));
+        pos += 4;
+        b->flags |= 0x20;
+    }
+    if (command) b->flags |= 0x10;
+    if (serial) b->flags |= 0x08;
+    pos += builder_put_varint2(b->bytes + pos, command);
+    pos += builder_put_varint2(b->bytes + pos, serial);
+
+    b->length_pos = pos;
+    b->pos = pos + 1;
+}
+
+static uint8_t *builder_reserve(parrot_builder *b, const uint32_t length) {
+    if (b->failed || b->pos + length > b->size) {
+        b->failed = parrot_true;
+        return NULL;
+    }
+
+    uint8_t *out = b->bytes + b->pos;
+    b->pos += length;
+    return out;
+}
+
+parrot_bool parrot_builder_put_integer(parrot_builder *b, const uint8_t field_index, const int64_t value) {
+    uint8_t header[PARROT_FIELD_HEADER_MAX];
+    const uint32_t n = value < 0
+                       ? parrot_payload_field_header(header, field_index, kNegativeInt, -(uint64_t) value)
+                       : parrot_payload_field_header(header, field_index, kPositiveInt, (uint64_t) value);
+    uint8_t *out = n != 0 ? builder_reserve(b, n) : NULL;
+    if (out == NULL) {
+        return parrot_false;
+    }
+
+    memcpy(out, header, n);
+    return parrot_true;
+}
+
+parrot_bool parrot_builder_put_string(parrot_builder *b, const uint8_t field_index, const char *data,
+                                      int16_t length) {
+    if (data == NULL) {
+        return parrot_false;
+    }
+    if (length < 0) {
+        length = (int16_t) strlen(data);
+    }
+    if (length == 0) {
+        return parrot_false;
+    }
+
+    uint8_t header[PARROT_FIELD_HEADER_MAX];
+    const uint32_t n = parrot_payload_field_header(header, field_index, kFixedString, (uint64_t) length);
+    uint8_t *out = n != 0 ? builder_reserve(b, n + (uint32_t) length) : NULL;
+    if (out == NULL) {
+        return parrot_false;
+    }
+
+    memcpy(out, header, n);
+    memcpy(out + n, data, (size_t) length);
+    return parrot_true;
+}
+
+parrot_bool parrot_builder_put_payload(parrot_builder *b, const void *data, const uint16_t length) {
+    uint8_t *out = builder_reserve(b, length);
+    if (out == NULL) {
+        return parrot_false;
+    }
+
+    memcpy(out, data, length);
+    return parrot_true;
+}
+
+uint16_t parrot_builder_finish(parrot_builder *b, const parrot_bool add_checksum) {
+    const uint16_t payload_start = b->length_pos + 1;
+    const uint16_t payload_len = b->pos - payload_start;
+    if (b->failed || payload_len > PARROT_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    uint16_t pos = b->pos;
+    if (payload_len == 0) {
+        // no payload, no length field
+        pos = b->length_pos;
+    } else if (payload_len < 128) {
+        b->flags |= 0x04;
+        b->bytes[b->length_pos] = (uint8_t) payload_len;
+    } else {
+        if (pos + 1u > b->size) {
+            return 0;
+        }
+        b->flags |= 0x04;
+        memmove(b->bytes + payload_start + 1, b->bytes + payload_start, payload_len);
+        builder_put_varint2(b->bytes + b->length_pos, payload_len);
+        ++pos;
+    }
+
+    if (add_checksum) {
+        b->flags |= 0x02;
+    }
+    b->bytes[1] = b->flags;
+
+    if (add_checksum) {
+        if (pos + 2u > b->size) {
+            return 0;
+        }
+        const uint16_t checksum_be = htons(parrot_checksum(b->bytes, pos));
+        memcpy(b->bytes + pos, &checksum_be, sizeof(checksum_be));
+        pos += 2;
+    }
+    return pos;
+}
+
+void parrot_template_begin(parrot_template *t, parrot_builder *b, const uint32_t device, const uint16_t command) {
+    t->length = 0;
+    // serial 1 as a placeholder, so the serial field is present; one byte is kept free for a longer serial
+    parrot_builder_begin(b, t->bytes, PARROT_TEMPLATE_SIZE - 1, device, command, 1);
+    t->serial_pos = (uint8_t) (b->length_pos - 1);
+    t->serial_len = 1;
+}
+
+parrot_bool parrot_template_finish(parrot_template *t, parrot_builder *b, const parrot_bool add_checksum) {
+    const uint16_t n = parrot_builder_finish(b, add_checksum);
+    if (n == 0) {
+        t->length = 0;
+        return parrot_false;
+    }
+
+    t->length = (uint8_t) n;
+    t->checksum = add_checksum;
+    return parrot_true;
+}
+
+uint16_t parrot_template_emit(parrot_template *t, void *buf, const uint16_t size, const uint16_t serial) {
+    if (t->length == 0 || serial == 0 || serial > 0x7FFF) {
+        return 0;
+    }
+
+    uint8_t *field = t->bytes + t->serial_pos;
+    const uint8_t serial_len = serial < 128 ? 1 : 2;
+    uint32_t old_sum = field[0] + (t->serial_len == 2 ? field[1] : 0);
+
+    if (serial_len != t->serial_len) {
+        const uint32_t tail = t->length - (t->serial_pos + t->serial_len);
+        memmove(field + serial_len, field + t->serial_len, tail);
+        t->length = (uint8_t) (t->length + serial_len - t->serial_len);
+        t->serial_len = serial_len;
+    }
+    builder_put_varint2(field, serial);
+    const uint32_t new_sum = field[0] + (serial_len == 2 ? field[1] : 0);
+
+    if (t->checksum) {
+        // the checksum is the sum of the bytes before it: only the serial bytes changed
+        uint16_t checksum_be;
+        memcpy(&checksum_be, t->bytes + t->length - 2, sizeof(checksum_be));
+        const uint16_t checksum = (uint16_t) (ntohs(checksum_be) + new_sum - old_sum);
+        checksum_be = htons(checksum);
+        memcpy(t->bytes + t->length - 2, &checksum_be, sizeof(checksum_be));
+    }
+
+    if (size < t->length) {
+        return 0;
+    }
+    memcpy(buf, t->bytes, t->length);
+    return t->length;
+}
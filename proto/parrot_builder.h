@@ -0,0 +1,110 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#include "parrot_message.h"
+
+/**
+ * @brief Writes one message straight into its final buffer, e.g. a udp_io_slot().
+ *
+ * begin() writes the header with one byte reserved for the payload length;
+ * fields are then encoded in place after it, and finish() fills in the flags
+ * and payload length and appends the checksum. A payload of 128 bytes or
+ * more needs a two-byte length, so finish() moves it up one byte. Nothing is
+ * allocated and the buffer is not cleared beforehand.
+ *
+ * A field that doesn't fit marks the builder as failed, and finish() returns 0.
+ */
+typedef struct parrot_builder {
+    uint8_t *bytes;
+    uint16_t size;
+    uint16_t length_pos;    // reserved payload length byte, the payload starts right after it
+    uint16_t pos;
+    uint8_t flags;
+    parrot_bool failed;
+} parrot_builder;
+
+/**
+ * @brief Start a message
+ * @param b [out] builder
+ * @param buf [in] output buffer
+ * @param size [in] output buffer size
+ * @param device [in] device code, 0 to omit
+ * @param command [in] command, 0 to omit
+ * @param serial [in] serial, 0 to omit
+ */
+void parrot_builder_begin(parrot_builder *b, void *buf, uint16_t size, uint32_t device, uint16_t command,
+                          uint16_t serial);
+
+/**
+ * @brief Append an integer field to the payload
+ */
+parrot_bool parrot_builder_put_integer(parrot_builder *b, uint8_t field_index, int64_t value);
+
+/**
+ * @brief Append a string field to the payload
+ * @param length [in] string length, -1 for NUL-terminated data
+ */
+parrot_bool parrot_builder_put_string(parrot_builder *b, uint8_t field_index, const char *data, int16_t length);
+
+/**
+ * @brief Append encoded payload bytes, e.g. a payload shared by several messages
+ */
+parrot_bool parrot_builder_put_payload(parrot_builder *b, const void *data, uint16_t length);
+
+/**
+ * @brief Complete the message
+ * @param add_checksum [in] whether to add the optional checksum
+ * @return Length of the message in bytes, 0 if it didn't fit or the payload is longer than 500 bytes
+ */
+uint16_t parrot_builder_finish(parrot_builder *b, parrot_bool add_checksum);
+
+#define PARROT_TEMPLATE_SIZE 64
+
+/**
+ * @brief A message serialized once and re-sent with different serials.
+ *
+ * Requests that differ only in their serial (keep-alive, register) are
+ * built once; each send rewrites the serial varint in place and adjusts the
+ * additive checksum by the difference of the old and new serial bytes, then
+ * copies the message out. When the serial varint changes length (at 128,
+ * and when the serial wraps) the bytes after it move by one.
+ */
+typedef struct parrot_template {
+    uint8_t length;         // 0 until built
+    uint8_t serial_pos;     // offset of the serial varint
+    uint8_t serial_len;     // 1 or 2
+    parrot_bool checksum;
+    uint8_t bytes[PARROT_TEMPLATE_SIZE];
+} parrot_template;
+
+/**
+ * @brief Start building a template; add payload fields to the builder, then call parrot_template_finish()
+ * @param t [out] template
+ * @param b [out] builder writing into the template
+ * @param device [in] device code, 0 to omit
+ * @param command [in] command, not 0
+ */
+void parrot_template_begin(parrot_template *t, parrot_builder *b, uint32_t device, uint16_t command);
+
+/**
+ * @brief Complete a template
+ * @return parrot_true for success, parrot_false if the message is too long for a template
+ */
+parrot_bool parrot_template_finish(parrot_template *t, parrot_builder *b, parrot_bool add_checksum);
+
+/**
+ * @brief Write the template's message with a serial
+ * @param buf [out] output buffer
+ * @param size [in] output buffer size
+ * @param serial [in] serial, 1 - 0x7FFF
+ * @return Length of the message in bytes, 0 if the template isn't built or buf is too small
+ */
+uint16_t parrot_template_emit(parrot_template *t, void *buf, uint16_t size, uint16_t serial);
+
+#if __cplusplus
+}
+#endif
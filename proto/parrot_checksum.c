@@ -0,0 +1,166 @@
+#include "parrot_checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PARROT_CHECKSUM_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PARROT_CHECKSUM_NEON 1
+#endif
+
+uint16_t parrot_checksum_scalar(const void *data, const size_t length) {
+    const uint8_t *bytes = data;
+    uint16_t sum = 0;
+    for (size_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+#if PARROT_CHECKSUM_X86
+
+#if defined(__i386__)
+__attribute__((target("sse2")))
+#endif
+static uint16_t parrot_checksum_sse2(const void *data, const size_t length) {
+    const uint8_t *bytes = data;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero;
+    __m128i acc1 = zero;
+    size_t i = 0;
+
+    // psadbw against zero sums 8 bytes into each 64-bit lane, which can't overflow here
+    for (; i + 64 <= length; i += 64) {
+        const __m128i v0 = _mm_loadu_si128((const __m128i *) (bytes + i));
+        const __m128i v1 = _mm_loadu_si128((const __m128i *) (bytes + i + 16));
+        const __m128i v2 = _mm_loadu_si128((const __m128i *) (bytes + i + 32));
+        const __m128i v3 = _mm_loadu_si128((const __m128i *) (bytes + i + 48));
+        acc0 = _mm_add_epi64(acc0, _mm_add_epi64(_mm_sad_epu8(v0, zero), _mm_sad_epu8(v1, zero)));
+        acc1 = _mm_add_epi64(acc1, _mm_add_epi64(_mm_sad_epu8(v2, zero), _mm_sad_epu8(v3, zero)));
+    }
+    for (; i + 16 <= length; i += 16) {
+        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (bytes + i)), zero));
+    }
+
+    acc0 = _mm_add_epi64(acc0, acc1);
+    acc0 = _mm_add_epi64(acc0, _mm_unpackhi_epi64(acc0, acc0));
+    return (uint16_t) (_mm_cvtsi128_si32(acc0) + parrot_checksum_scalar(bytes + i, length - i));
+}
+
+__attribute__((target("avx2")))
+static uint16_t parrot_checksum_avx2(const void *data, const size_t length) {
+    const uint8_t *bytes = data;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = zero;
+    __m256i acc1 = zero;
+    size_t i = 0;
+
+    for (; i + 128 <= length; i += 128) {
+        const __m256i v0 = _mm256_loadu_si256((const __m256i *) (bytes + i));
+        const __m256i v1 = _mm256_loadu_si256((const __m256i *) (bytes + i + 32));
+        const __m256i v2 = _mm256_loadu_si256((const __m256i *) (bytes + i + 64));
+        const __m256i v3 = _mm256_loadu_si256((const __m256i *) (bytes + i + 96));
+        acc0 = _mm256_add_epi64(acc0, _mm256_add_epi64(_mm256_sad_epu8(v0, zero), _mm256_sad_epu8(v1, zero)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_add_epi64(_mm256_sad_epu8(v2, zero), _mm256_sad_epu8(v3, zero)));
+    }
+    for (; i + 32 <= length; i += 32) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *) (bytes + i)), zero));
+    }
+
+    acc0 = _mm256_add_epi64(acc0, acc1);
+    __m128i acc = _mm_add_epi64(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+    if (i + 16 <= length) {
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (bytes + i)), _mm_setzero_si128()));
+        i += 16;
+    }
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+    return (uint16_t) (_mm_cvtsi128_si32(acc) + parrot_checksum_scalar(bytes + i, length - i));
+}
+
+static const parrot_checksum_impl checksum_impls[] = {
+    {"scalar", parrot_checksum_scalar},
+    {"sse2", parrot_checksum_sse2},
+    {"avx2", parrot_checksum_avx2},
+};
+
+static uint32_t checksum_supported(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return 3;
+    if (__builtin_cpu_supports("sse2")) return 2;
+    return 1;
+}
+
+#elif PARROT_CHECKSUM_NEON
+
+static uint16_t parrot_checksum_neon(const void *data, const size_t length) {
+    const uint8_t *bytes = data;
+    // 16-bit lanes may wrap: only the sum modulo 2^16 is needed
+    uint16x8_t acc0 = vdupq_n_u16(0);
+    uint16x8_t acc1 = vdupq_n_u16(0);
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        acc0 = vpadalq_u8(acc0, vld1q_u8(bytes + i));
+        acc1 = vpadalq_u8(acc1, vld1q_u8(bytes + i + 16));
+    }
+    for (; i + 16 <= length; i += 16) {
+        acc0 = vpadalq_u8(acc0, vld1q_u8(bytes + i));
+    }
+
+    const uint16x8_t acc = vaddq_u16(acc0, acc1);
+#if defined(__aarch64__)
+    const uint16_t sum = vaddvq_u16(acc);
+#else
+    uint16_t lanes[8];
+    vst1q_u16(lanes, acc);
+    const uint16_t sum = (uint16_t) (lanes[0] + lanes[1] + lanes[2] + lanes[3]
+                                     + lanes[4] + lanes[5] + lanes[6] + lanes[7]);
+#endif
+    return (uint16_t) (sum + parrot_checksum_scalar(bytes + i, length - i));
+}
+
+static const parrot_checksum_impl checksum_impls[] = {
+    {"scalar", parrot_checksum_scalar},
+    {"neon", parrot_checksum_neon},
+};
+
+static uint32_t checksum_supported(void) {
+    return 2;
+}
+
+#else
+
+static const parrot_checksum_impl checksum_impls[] = {
+    {"scalar", parrot_checksum_scalar},
+};
+
+static uint32_t checksum_supported(void) {
+    return 1;
+}
+
+#endif
+
+// index into checksum_impls + 1, 0 until resolved; resolving twice is harmless
+static uint32_t checksum_selected = 0;
+
+static const parrot_checksum_impl *checksum_resolve(void) {
+    uint32_t selected = __atomic_load_n(&checksum_selected, __ATOMIC_RELAXED);
+    if (selected == 0) {
+        selected = checksum_supported();
+        __atomic_store_n(&checksum_selected, selected, __ATOMIC_RELAXED);
+    }
+    return &checksum_impls[selected - 1];
+}
+
+uint16_t parrot_checksum(const void *data, const size_t length) {
+    return checksum_resolve()->fn(data, length);
+}
+
+const char *parrot_checksum_name(void) {
+    return checksum_resolve()->name;
+}
+
+uint32_t parrot_checksum_impls(const parrot_checksum_impl **impls) {
+    *impls = checksum_impls;
+    return checksum_supported();
+}
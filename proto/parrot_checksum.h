@@ -0,0 +1,47 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Checksum function: 16-bit sum of all bytes (wrapping)
+ */
+typedef uint16_t (*parrot_checksum_fn)(const void *data, size_t length);
+
+typedef struct parrot_checksum_impl {
+    const char *name;
+    parrot_checksum_fn fn;
+} parrot_checksum_impl;
+
+/**
+ * @brief Message checksum: the sum of all bytes, modulo 2^16.
+ *
+ * Uses the fastest implementation the CPU supports, chosen on first use:
+ * AVX2 or SSE2 (psadbw horizontal sums) on x86-64, NEON on ARM, a scalar
+ * loop otherwise. All implementations return the same value.
+ */
+uint16_t parrot_checksum(const void *data, size_t length);
+
+/**
+ * @brief Byte-at-a-time reference implementation
+ */
+uint16_t parrot_checksum_scalar(const void *data, size_t length);
+
+/**
+ * @return Name of the implementation parrot_checksum() uses
+ */
+const char *parrot_checksum_name(void);
+
+/**
+ * @brief List the implementations the running CPU supports, for tests and benchmarks
+ * @param impls [out] set to an array of implementations, the scalar one first
+ * @return Number of implementations
+ */
+uint32_t parrot_checksum_impls(const parrot_checksum_impl **impls);
+
+#if __cplusplus
+}
+#endif
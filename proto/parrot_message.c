@@ -1,245 +1,197 @@
 #include "parrot_message.h"
+#include "parrot_builder.h"
+#include "parrot_checksum.h"
+#include "parrot_varint.h"
 
-#include <stdio.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 
-static char parrot_error_data[1024] = "";
-static uint16_t parrot_error_len = 0;
+// per thread, so that parsing on several threads doesn't race; formatted only when asked for
+static __thread parrot_error parrot_last_error = kParrotOk;
 
-#define PARROT_RETURN_FAIL(fmt, ...) { \
-    parrot_error_len = snprintf(parrot_error_data, sizeof(parrot_error_data), fmt, ##__VA_ARGS__); \
-    return parrot_false; \
+#define PARROT_RETURN_FAIL(error) { \
+    parrot_last_error = (error); \
+    return (error); \
     }
 
 c_string parrot_get_last_error() {
+    const char *text = parrot_last_error == kParrotOk ? "" : parrot_strerror(parrot_last_error);
     const c_string ret = {
-        .data = parrot_error_data,
-        .length = parrot_error_len
+        .data = (char *) text,
+        .length = (uint32_t) strlen(text)
     };
 
     return ret;
 }
 
-typedef struct parrot_parse_buf {
-    const uint8_t *bytes;
-    uint16_t pos;
-    uint16_t len;
-} parrot_parse_buf;
-
-static parrot_bool parrot_parse_buf_get_byte(parrot_parse_buf *buf, uint8_t *out_value_ptr) {
-    if (buf->pos >= buf->len) {
-        return parrot_false;
-    }
-
-    *out_value_ptr = buf->bytes[buf->pos++];
-    return parrot_true;
-}
-
-static parrot_bool parrot_parse_buf_get_uint32(parrot_parse_buf *buf, uint32_t *out_value_ptr) {
-    if (buf->pos + 4 > buf->len) {
-        return parrot_false;
-    }
-
-    *out_value_ptr = ntohl(*((uint32_t *) (buf->bytes + buf->pos)));
-    buf->pos += 4;
-    return parrot_true;
-}
-
-static parrot_bool parrot_parse_buf_get_uint16(parrot_parse_buf *buf, uint16_t *out_value_ptr) {
-    if (buf->pos + 2 > buf->len) {
-        return parrot_false;
-    }
-    *out_value_ptr = ntohs(*((uint16_t *) (buf->bytes + buf->pos)));
-    buf->pos += 2;
-    return parrot_true;
-}
-
-static parrot_bool parrot_parse_buf_get_varint(parrot_parse_buf *buf, uint16_t *out_value_ptr) {
-    if (buf->pos + 1 > buf->len) {
-        return parrot_false;
-    }
-    const uint8_t lower_byte = buf->bytes[buf->pos++];
-    *out_value_ptr = lower_byte & 0x7F;
-    if (lower_byte & 0x80) {
-        if (buf->pos + 1 > buf->len) {
-            return parrot_false;
-        }
-
-        const uint8_t higher_byte = buf->bytes[buf->pos++];
-        *out_value_ptr |= higher_byte << 7;
-    }
-    return parrot_true;
-}
-
-
-parrot_bool parrot_message_parse(parrot_message *msg, const void *data, const uint16_t length) {
-    parrot_parse_buf buf = {
-        .bytes = data,
-        .pos = 0,
-        .len = length
-    };
-
-    memset(msg, 0, sizeof(parrot_message));
-
-    uint8_t magic = 0;
-    if (!parrot_parse_buf_get_byte(&buf, &magic)) PARROT_RETURN_FAIL("data too short")
-
-    if (magic != 0xFF) PARROT_RETURN_FAIL("bad invalid magic");
-
-    uint8_t flags = 0;
-    if (!parrot_parse_buf_get_byte(&buf, &flags)) PARROT_RETURN_FAIL("data too short");
-
+/**
+ * @brief Validate one message and locate its fields, without touching the error state.
+ *        Shared by parrot_message_parse() and parrot_message_parse_batch().
+ * @param out [out] header fields, set as far as parsing got
+ */
+static inline parrot_error parrot_message_scan(const uint8_t *bytes, const uint16_t length,
+                                                      parrot_message_header *out) {
+    uint32_t pos = 0;
+
+    if (length < 1) return kParrotTooShort;
+    if (bytes[0] != 0xFF) return kParrotBadMagic;
+    if (length < 2) return kParrotTooShort;
+
+    const uint8_t flags = bytes[1];
+    pos = 2;
     // version flags
-    if (flags >> 6 != 1) PARROT_RETURN_FAIL("bad version number");
-
-    // device
-    const uint8_t device_flag = flags & 0x20;
-    const uint8_t command_flag = flags & 0x10;
-    const uint8_t serial_flag = flags & 0x08;
-    const uint8_t payload_flag = flags & 0x04;
-    const uint8_t checksum_flag = flags & 0x02;
-    const uint8_t reserved_flag = flags & 0x01;
-    if (reserved_flag != 0) PARROT_RETURN_FAIL("bad reserved flag");
-
-    if (device_flag != 0) {
-        if (!parrot_parse_buf_get_uint32(&buf, &msg->device)) PARROT_RETURN_FAIL("data too short");
+    if (flags >> 6 != 1) return kParrotBadVersion;
+    if (flags & 0x01) return kParrotBadReserved;
+
+    if (flags & 0x20) {
+        if (pos + 4 > length) return kParrotTooShort;
+        uint32_t device_be;
+        memcpy(&device_be, bytes + pos, sizeof(device_be));
+        out->device = ntohl(device_be);
+        pos += 4;
     }
 
-#define PARSE_OPTIONAL_VARINT(option_flag, msg_field) if (option_flag != 0) { \
-        REQUIRE_MORE_BYTES(1) \
-        const uint8_t lower_byte = bytes[pos++]; \
-        msg->msg_field = lower_byte & 0x7F; \
-        if (lower_byte & 0x80) { \
-            REQUIRE_MORE_BYTES(1) \
-            const uint8_t higher_byte = bytes[pos++]; \
-            msg->msg_field |= higher_byte << 7; \
-        } \
+    // command, serial and payload length varints, in flag order
+    uint16_t *const fields[3] = {&out->command, &out->serial, &out->payload_len};
+    for (int i = 0; i < 3; i++) {
+        if ((flags & (0x10 >> i)) == 0) {
+            continue;
+        }
+        if (pos >= length) return kParrotTooShort;
+        const uint32_t n = parrot_varint2_decode(bytes + pos, length - pos, fields[i]);
+        if (n == 0) return kParrotTooShort;
+        pos += n;
     }
 
-    if (command_flag) {
-        if (!parrot_parse_buf_get_varint(&buf, &msg->command)) PARROT_RETURN_FAIL("data too short");
-    }
+    out->payload_offset = (uint16_t) pos;
+    if (pos + out->payload_len > length) return kParrotTooShort;
+    pos += out->payload_len;
 
-    if (serial_flag) {
-        if (!parrot_parse_buf_get_varint(&buf, &msg->serial)) PARROT_RETURN_FAIL("data too short");
+    if (flags & 0x02) {
+        if (pos + 2 > length) return kParrotTooShort;
+        uint16_t checksum_be;
+        memcpy(&checksum_be, bytes + pos, sizeof(checksum_be));
+        if (ntohs(checksum_be) != parrot_checksum(bytes, pos)) return kParrotChecksumMismatch;
+        pos += 2;
     }
 
-    if (payload_flag) {
-        if (!parrot_parse_buf_get_varint(&buf, &msg->payload_len)) PARROT_RETURN_FAIL("data too short");
-    }
+    if (pos < length) return kParrotTooLong;
+    return kParrotOk;
+}
 
-    if (msg->payload_len != 0) {
-        if (buf.pos + msg->payload_len > buf.len) PARROT_RETURN_FAIL("data too short");
+const char *parrot_strerror(const parrot_error error) {
+    switch (error) {
+        case kParrotOk:
+            return "ok";
+        case kParrotTooShort:
+            return "data too short";
+        case kParrotBadMagic:
+            return "bad invalid magic";
+        case kParrotBadVersion:
+            return "bad version number";
+        case kParrotBadReserved:
+            return "bad reserved flag";
+        case kParrotChecksumMismatch:
+            return "checksum mismatch";
+        case kParrotTooLong:
+            return "data too long";
+        case kParrotPayloadTooLong:
+            return "msg payload too long";
+        case kParrotBufferTooSmall:
+            return "buffer too small";
+    }
+    return "unknown";
+}
 
-        msg->payload_data = (void*) (buf.bytes + buf.pos);
-        buf.pos += msg->payload_len;
-    } else {
+parrot_error parrot_message_parse(parrot_message *msg, const void *data, const uint16_t length) {
+    parrot_message_header header;
+    memset(&header, 0, sizeof(header));
+
+    const parrot_error error = parrot_message_scan(data, length, &header);
+    msg->device = header.device;
+    msg->command = header.command;
+    msg->serial = header.serial;
+    if (error != kParrotOk) {
+        // the payload length may have been read from a message too short to hold it
+        msg->payload_len = 0;
         msg->payload_data = "";
+        PARROT_RETURN_FAIL(error)
     }
 
-    if (checksum_flag != 0) {
-        uint16_t checksum = 0;
-        if (!parrot_parse_buf_get_uint16(&buf, &checksum)) PARROT_RETURN_FAIL("data too short");
-
-        uint16_t actual_checksum = 0;
-        for (uint16_t i = 0; i < buf.pos - 2; i++) {
-            actual_checksum += buf.bytes[i];
-        }
-
-        if (checksum != actual_checksum) PARROT_RETURN_FAIL("checksum mismatch. expected %02x, actual %02x", checksum,
-                                                            actual_checksum);
-    }
-
-    if (buf.pos < length) PARROT_RETURN_FAIL("data too long");
+    msg->payload_len = header.payload_len;
+    msg->payload_data = header.payload_len != 0 ? (const void *) ((const uint8_t *) data + header.payload_offset) : "";
 
-    return parrot_true;
+    return kParrotOk;
 }
 
-static uint16_t var_int2_size(const uint16_t value) {
-    if (value == 0)
-        return 0;
-    if (value < 128)
-        return 1;
-    return 2;
+int parrot_message_batch_init(parrot_message_batch *batch, const uint32_t capacity) {
+    memset(batch, 0, sizeof(*batch));
+    batch->device = calloc(capacity, sizeof(uint32_t));
+    batch->command = calloc(capacity, sizeof(uint16_t));
+    batch->serial = calloc(capacity, sizeof(uint16_t));
+    batch->payload_offset = calloc(capacity, sizeof(uint16_t));
+    batch->payload_len = calloc(capacity, sizeof(uint16_t));
+    batch->status = calloc(capacity, sizeof(uint8_t));
+    if (batch->device == NULL || batch->command == NULL || batch->serial == NULL || batch->payload_offset == NULL
+        || batch->payload_len == NULL || batch->status == NULL) {
+        parrot_message_batch_destroy(batch);
+        return -1;
+    }
+
+    batch->capacity = capacity;
+    return 0;
 }
 
-static uint16_t device_size(const uint32_t device_id) {
-    return device_id ? 4 : 0;
+void parrot_message_batch_destroy(parrot_message_batch *batch) {
+    free(batch->device);
+    free(batch->command);
+    free(batch->serial);
+    free(batch->payload_offset);
+    free(batch->payload_len);
+    free(batch->status);
+    memset(batch, 0, sizeof(*batch));
 }
 
-static uint16_t checksum_size(const parrot_bool add_checksum) {
-    return add_checksum ? 2 : 0;
-}
-
-
-static uint16_t serialize_varint(uint8_t *buffer, const uint16_t value) {
-    if (value == 0) {
-        return 0;
+uint32_t parrot_message_parse_batch(const void *const bufs[], const uint16_t lens[], uint32_t n,
+                                    parrot_message_batch *out) {
+    if (n > out->capacity) {
+        n = out->capacity;
     }
 
-    buffer[0] = value & 0x7F;
-    if (value > 127) {
-        buffer[0] |= 0x80;
-        buffer[1] = value >> 7;
-        return 2;
+    uint32_t ok = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        parrot_message_header header = {0, 0, 0, 0, 0};
+        const parrot_error error = parrot_message_scan(bufs[i], lens[i], &header);
+        const parrot_bool valid = error == kParrotOk;
+
+        // failed messages have all fields cleared, so filters over the arrays can ignore status
+        out->device[i] = valid ? header.device : 0;
+        out->command[i] = valid ? header.command : 0;
+        out->serial[i] = valid ? header.serial : 0;
+        out->payload_offset[i] = valid ? header.payload_offset : 0;
+        out->payload_len[i] = valid ? header.payload_len : 0;
+        out->status[i] = (uint8_t) error;
+        ok += valid;
     }
 
-    buffer[0] = value;
-    return 1;
+    out->count = n;
+    return ok;
 }
 
-uint16_t parrot_message_serialize(void *buf, uint16_t size, const parrot_message *msg,
-                                  const parrot_bool add_checksum) {
-    uint16_t pos = 0;
-    uint8_t *bytes = buf;
-
-    if (msg->payload_len > 500) PARROT_RETURN_FAIL("msg payload too long")
-
-    const uint16_t required_size = 2 // magic + flags
-        + device_size(msg->device) // device
-        + var_int2_size(msg->command)
-        + var_int2_size(msg->serial)
-        + var_int2_size(msg->payload_len)
-        + checksum_size(add_checksum)
-        + msg->payload_len;
-    if (size < required_size) PARROT_RETURN_FAIL("buffer too small")
-
-    memset(buf, 0, size);
-    bytes[pos++] = 0xFF;
-    bytes[pos] |= 0x01 << 6; // version
-    if (msg->device) bytes[pos] |= 0x20;
-    if (msg->command) bytes[pos] |= 0x10;
-    if (msg->serial) bytes[pos] |= 0x08;
-    if (msg->payload_len) bytes[pos] |= 0x04;
-    if (add_checksum) bytes[pos] |= 0x02;
-
-    ++pos;
-    if (msg->device) {
-        uint32_t *device_ptr = (uint32_t*) (bytes + pos);
-        *device_ptr = htonl(msg->device);
-        pos += 4;
-    }
-
-    pos += serialize_varint(bytes + pos, msg->command);
-    pos += serialize_varint(bytes + pos, msg->serial);
-    pos += serialize_varint(bytes + pos, msg->payload_len);
+parrot_error parrot_message_serialize(void *buf, const uint16_t size, const parrot_message *msg,
+                                      const parrot_bool add_checksum, uint16_t *length) {
+    *length = 0;
+    if (msg->payload_len > 500) PARROT_RETURN_FAIL(kParrotPayloadTooLong)
 
+    parrot_builder builder;
+    parrot_builder_begin(&builder, buf, size, msg->device, msg->command, msg->serial);
     if (msg->payload_len) {
-        memcpy(bytes + pos, msg->payload_data, msg->payload_len);
-        pos += msg->payload_len;
+        parrot_builder_put_payload(&builder, msg->payload_data, msg->payload_len);
     }
 
-    if (add_checksum) {
-        uint16_t checksum = 0;
-        for (uint16_t i = 0; i < pos; i++) {
-            checksum += bytes[i];
-        }
-
-        uint16_t *checksum_ptr = (uint16_t*) (bytes + pos);
-        *checksum_ptr = htons(checksum);
-
-        pos += 2;
-    }
-    return pos;
+    *length = parrot_builder_finish(&builder, add_checksum);
+    if (*length == 0) PARROT_RETURN_FAIL(kParrotBufferTooSmall)
+    return kParrotOk;
 }
@@ -17,19 +17,99 @@ typedef struct parrot_message {
 } parrot_message;
 
 /**
+ * @brief Header fields of a message, with the payload as an offset into the message
+ */
+typedef struct parrot_message_header {
+    uint32_t device;
+    uint16_t command;
+    uint16_t serial;
+    uint16_t payload_offset;
+    uint16_t payload_len;
+} parrot_message_header;
+
+/**
+ * @brief Result of parsing or serializing a message
+ */
+typedef enum parrot_error {
+    kParrotOk = 0,
+    kParrotTooShort,
+    kParrotBadMagic,
+    kParrotBadVersion,
+    kParrotBadReserved,
+    kParrotChecksumMismatch,
+    kParrotTooLong,
+    kParrotPayloadTooLong,
+    kParrotBufferTooSmall,
+} parrot_error;
+
+/**
+ * @brief Parse results of a batch of messages, as parallel arrays indexed by message
  *
- * @return last error (message)
+ * Messages that failed to parse have status != kParrotOk and all other fields 0.
+ */
+typedef struct parrot_message_batch {
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t *device;
+    uint16_t *command;
+    uint16_t *serial;
+    uint16_t *payload_offset;   // from the start of the message
+    uint16_t *payload_len;
+    uint8_t *status;            // parrot_error
+} parrot_message_batch;
+
+/**
+ * @return Short description of an error code
+ */
+const char *parrot_strerror(parrot_error error);
+
+/**
+ * @brief Description of the last parse or serialize failure of the calling thread
+ *
+ * Kept for older callers; prefer the error code returned by the call.
+ *
+ * @return last error (message), valid until the program exits
  */
 c_string parrot_get_last_error();
 
 /**
  * @brief Parse one message (array bytes)
- * @param msg [out] message structure
+ *
+ * Reentrant: nothing is formatted, and the only shared state written is the
+ * calling thread's last error code.
+ *
+ * @param msg [out] message structure, with an empty payload on failure
  * @param data [in] message data pointer
  * @param length [in] message data length
- * @return parrot_true (0x01) for success. parrot_false (0x00) for failure.
+ * @return kParrotOk for success, otherwise why the message is invalid
+ */
+parrot_error parrot_message_parse(parrot_message *msg, const void *data, uint16_t length);
+
+/**
+ * @brief Allocate result arrays for batches of up to capacity messages
+ * @return 0 for success, -1 for failure
+ */
+int parrot_message_batch_init(parrot_message_batch *batch, uint32_t capacity);
+
+/**
+ * @brief Release result arrays
+ */
+void parrot_message_batch_destroy(parrot_message_batch *batch);
+
+/**
+ * @brief Parse several messages, e.g. the datagrams of one recvmmsg()
+ *
+ * Validation is the same as parrot_message_parse(), per message; the last
+ * error is not set.
+ *
+ * @param bufs [in] message data pointers
+ * @param lens [in] message lengths
+ * @param n [in] number of messages, at most batch capacity (more are ignored)
+ * @param out [out] results, out->count set to the number of messages parsed
+ * @return Number of valid messages
  */
-parrot_bool parrot_message_parse(parrot_message *msg, const void *data, uint16_t length);
+uint32_t parrot_message_parse_batch(const void *const bufs[], const uint16_t lens[], uint32_t n,
+                                    parrot_message_batch *out);
 
 /**
  * Serialize message to byte array
@@ -37,9 +117,11 @@ parrot_bool parrot_message_parse(parrot_message *msg, const void *data, uint16_t
  * @param size [out] output buffer length
  * @param msg [in] message to be serialized
  * @param add_checksum [in] whether add optional checksum to serialized message (0: No, 1: Yes)
- * @return Length of serialized message in bytes
+ * @param length [out] length of serialized message in bytes
+ * @return kParrotOk for success, kParrotPayloadTooLong or kParrotBufferTooSmall for failure
  */
-uint16_t parrot_message_serialize(void *buf, uint16_t size, const parrot_message *msg, parrot_bool add_checksum);
+parrot_error parrot_message_serialize(void *buf, uint16_t size, const parrot_message *msg, parrot_bool add_checksum,
+                                      uint16_t *length);
 
 #if __cplusplus
 }
@@ -1,52 +1,32 @@
 #include "parrot_payload.h"
+#include "parrot_varint.h"
 #include <string.h>
 
-typedef enum meta_type {
-    kPositiveInt,
-    kNegativeInt,
-    kFixedString,
-} meta_type;
 
+uint32_t parrot_payload_field_header(uint8_t *out, const uint8_t field_index, const meta_type type,
+                                     const uint64_t value) {
+    if (field_index > 63) {
+        return 0;
+    }
 
-static void parrot_payload_put_varint(c_string *payload, uint64_t value) {
-    do {
-        uint8_t byte = value & 0x7F;
-        value >>= 7;
-
-        if (value != 0) {
-            byte |= 0x80;
-        }
-
-        c_string_add_char(payload, (char) byte);
-    } while (value != 0);
+    out[0] = (uint8_t) (type << 6 | field_index);
+    return 1 + parrot_varint_encode(out + 1, value);
 }
 
-parrot_bool parrot_payload_put_integer(c_string *payload, const uint8_t field_index, int64_t value) {
-    if (field_index > 63)
+parrot_bool parrot_payload_put_integer(c_string *payload, const uint8_t field_index, const int64_t value) {
+    uint8_t header[PARROT_FIELD_HEADER_MAX];
+    const uint32_t n = value < 0
+                       ? parrot_payload_field_header(header, field_index, kNegativeInt, -(uint64_t) value)
+                       : parrot_payload_field_header(header, field_index, kPositiveInt, (uint64_t) value);
+    if (n == 0) {
         return parrot_false;
-
-    uint8_t meta = 0;
-    // field type
-    if (value < 0) {
-        meta |= kNegativeInt << 6;
-        value = -value;
-    } else {
-        meta |= kPositiveInt << 6;
     }
 
-    // field index
-    meta |= field_index & 0x3F;
-
-    // put meta byte
-    c_string_add_char(payload, (char) meta);
-
-    // put value
-    parrot_payload_put_varint(payload, value);
-    return parrot_true;
+    return c_string_append_raw(payload, header, n);
 }
 
 parrot_bool parrot_payload_put_string(c_string *payload, const uint8_t field_index, const char *data, int16_t length) {
-    if (field_index > 63 || data == NULL)
+    if (data == NULL)
         return parrot_false;
 
     if (length < 0) {
@@ -57,22 +37,19 @@ parrot_bool parrot_payload_put_string(c_string *payload, const uint8_t field_ind
         return parrot_false;
     }
 
-    uint8_t meta = 0;
-    // field type
-    meta |= kFixedString << 6;
-
-    // field index
-    meta |= field_index & 0x3F;
-
-    // put meta byte
-    c_string_add_char(payload, (char) meta);
-
-    // put length
-    parrot_payload_put_varint(payload, length);
+    uint8_t header[PARROT_FIELD_HEADER_MAX];
+    const uint32_t n = parrot_payload_field_header(header, field_index, kFixedString, (uint64_t) length);
+    if (n == 0) {
+        return parrot_false;
+    }
 
-    // put data
-    c_string_append(payload, data, length);
-    return parrot_true;
+    // one capacity check for the whole field
+    if ((uint64_t) payload->length + n + (uint32_t) length > payload->capacity
+        && !c_string_reserve(payload, payload->length + n + (uint32_t) length)) {
+        return parrot_false;
+    }
+    c_string_append_raw(payload, header, n);
+    return c_string_append_raw(payload, data, (uint32_t) length);
 }
 
 
@@ -82,66 +59,103 @@ void parrot_payload_parse_init(payload_parse *parse, const void *data, const uin
     parse->length = len;
 }
 
-uint16_t parrot_payload_parse_entry(payload_entry *out, payload_parse *parse) {
-    memset(out, 0, sizeof(*out));
-    if (parse->pos >= parse->length)
-        return 0;
+static uint16_t parrot_payload_parse_fail(payload_entry *out, payload_parse *parse) {
+    out->key = 0;
+    out->is_string = 0;
+    parse->pos = parse->length;
+    return 0;
+}
 
+uint16_t parrot_payload_parse_entry(payload_entry *out, payload_parse *parse) {
     const uint16_t start = parse->pos;
+    parrot_payload_field field;
+    if (parrot_payload_next(parse->data, parse->length, &parse->pos, &field) != 1) {
+        return parrot_payload_parse_fail(out, parse);
+    }
 
-    const uint8_t *bytes = parse->data;
-    // read meta type
-    const uint8_t meta = bytes[parse->pos];
-    const uint8_t meta_type = meta >> 6;
-    if (meta_type != kPositiveInt && meta_type != kNegativeInt && meta_type != kFixedString) {
-        return parse->pos - start;
+    out->key = field.key;
+    if (field.type != kFixedString) {
+        out->is_string = 0;
+        out->value.i64 = parrot_payload_field_integer(&field);
+    } else {
+        out->is_string = 1;
+        out->value.str.data = (char *) parse->data + field.offset;
+        out->value.str.length = (uint32_t) field.value;
+        out->value.str.capacity = 0;
+        out->value.str.storage = kStringNone;
     }
-    const uint8_t field_index = meta & 0x3F;
-
-    // read varint
-    ++parse->pos;
-    int64_t value = 0;
-    uint8_t var_byte;
-    uint8_t bit_offset = 0;
-    if (parse->pos >= parse->length) return parse->pos - start;
-    do {
-        if (bit_offset == 63) return parse->pos - start;
-
-        var_byte = bytes[parse->pos];
-        value |= (int64_t) (var_byte & 0x7F) << bit_offset;
-        bit_offset += 7;
-        ++parse->pos;
-    } while ((var_byte & 0x80) != 0);
-
-    switch (meta_type) {
-        case kPositiveInt:
-            out->key = field_index;
-            out->value.i64 = value;
-            out->is_string = 0;
-            return parse->pos - start;
-        case kNegativeInt:
-            out->key = field_index;
-            out->value.i64 = -value;
-            out->is_string = 0;
-            return parse->pos - start;
-        case kFixedString:
-            if (value > 512) {
-                parse->pos = parse->length;
-                return 0;
+
+    return (uint16_t) (parse->pos - start);
+}
+
+parrot_bool parrot_payload_visit(const void *data, const uint16_t len, const uint64_t field_mask,
+                                 const parrot_payload_callbacks *callbacks, void *user_data) {
+    uint16_t pos = 0;
+    parrot_payload_field field;
+    int next;
+
+    while ((next = parrot_payload_next(data, len, &pos, &field)) > 0) {
+        if ((field_mask & PARROT_FIELD(field.key)) == 0) {
+            continue;
+        }
+
+        if (field.type == kFixedString) {
+            if (callbacks->on_string_field == NULL) {
+                continue;
             }
-            if (parse->pos + value > parse->length) {
-                parse->pos = parse->length;
-                return 0;
+            callbacks->on_string_field(user_data, field.key, (const char *) data + field.offset,
+                                       (int16_t) field.value);
+        } else {
+            if (callbacks->on_integer_field == NULL) {
+                continue;
             }
+            callbacks->on_integer_field(user_data, field.key, parrot_payload_field_integer(&field));
+        }
 
-            out->key = field_index;
-            out->is_string = 1;
-            out->value.str.data = (void*) bytes + parse->pos;
-            out->value.str.length = value;
-            parse->pos += value;
-            return parse->pos - start;
-        default:
-            parse->pos = parse->length;
-            return 0;
+        if (callbacks->is_done != NULL && callbacks->is_done(user_data)) {
+            return parrot_true;
+        }
     }
+
+    return next == 0;
+}
+
+parrot_bool parrot_payload_index_build(payload_index *index, const void *data, const uint16_t len) {
+    uint8_t last[64];   // last entry of each present key, for chaining repeats
+    uint16_t pos = 0;
+    parrot_payload_field field;
+    int next;
+
+    index->data = data;
+    index->present = 0;
+    index->count = 0;
+
+    while ((next = parrot_payload_next(data, len, &pos, &field)) > 0) {
+        if (index->count == PAYLOAD_INDEX_MAX_ENTRIES) {
+            return parrot_false;
+        }
+
+        const uint8_t id = index->count++;
+        payload_index_entry *entry = &index->entries[id];
+        entry->next = PAYLOAD_INDEX_END;
+        if (field.type == kFixedString) {
+            entry->is_string = 1;
+            entry->value.string.offset = field.offset;
+            entry->value.string.length = (uint16_t) field.value;
+        } else {
+            entry->is_string = 0;
+            entry->value.integer = parrot_payload_field_integer(&field);
+        }
+
+        const uint8_t key = field.key;
+        if (index->present & PARROT_FIELD(key)) {
+            index->entries[last[key]].next = id;
+        } else {
+            index->present |= PARROT_FIELD(key);
+            index->first[key] = id;
+        }
+        last[key] = id;
+    }
+
+    return next == 0;
 }
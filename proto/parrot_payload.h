@@ -3,19 +3,127 @@
 #if __cplusplus
 extern "C" {
 #endif
+#include <stddef.h>
 #include <stdint.h>
 
 #include "parrot_message.h"
+#include "parrot_varint.h"
+
+/**
+ * @brief Field type, the top 2 bits of a field's meta byte (the low 6 bits are the key)
+ */
+typedef enum meta_type {
+    kPositiveInt,
+    kNegativeInt,
+    kFixedString,
+} meta_type;
+
+#define PARROT_FIELD_HEADER_MAX 11  // meta byte and a 64-bit varint
+#define PARROT_STRING_MAX 512       // longest string field a payload may carry
+
+/**
+ * @brief Encode the meta byte and varint (integer value or string length) of a field
+ * @param out [out] at least PARROT_FIELD_HEADER_MAX bytes
+ * @return Header length in bytes, 0 if field_index is over 63
+ */
+uint32_t parrot_payload_field_header(uint8_t *out, uint8_t field_index, meta_type type, uint64_t value);
 
 parrot_bool parrot_payload_put_integer(c_string *, uint8_t field_index, int64_t value);
 parrot_bool parrot_payload_put_string(c_string *, uint8_t field_index, const char *data, int16_t length);
 
+#define PARROT_FIELD(key) (1ull << (key))     // bit of a key in a mask of fields
+#define PARROT_ALL_FIELDS (~0ull)
 
+/**
+ * @brief Field handlers for parrot_payload_visit(). Any of them may be NULL.
+ */
 typedef struct {
     void (*on_integer_field)(void *user_data, uint8_t field_index, int64_t value);
     void (*on_string_field)(void *user_data, uint8_t field_index, const char *data, int16_t length);
+    parrot_bool (*is_done)(void *user_data);    // asked after each field handled, parrot_true ends the visit
 } parrot_payload_callbacks;
 
+/**
+ * @brief A field read by parrot_payload_next()
+ */
+typedef struct parrot_payload_field {
+    uint8_t key;
+    uint8_t type;           // meta_type
+    uint16_t offset;        // of a string's bytes, from the start of the payload
+    uint64_t value;         // integer magnitude, or string length
+} parrot_payload_field;
+
+/**
+ * @brief Read the field at *pos and step *pos past it.
+ *
+ * This is the one walk over payload fields: the entry parser, the visitor,
+ * the schema decoder and the field index are built on it, so the bounds
+ * checks and the PARROT_STRING_MAX limit live here only.
+ *
+ * @param bytes [in] payload data
+ * @param len [in] payload length
+ * @param pos [in,out] offset of the field, 0 for the first one
+ * @param field [out] field read
+ * @return 1 for a field, 0 at the end of the payload, -1 if the payload is malformed
+ */
+static inline int parrot_payload_next(const uint8_t *bytes, const uint16_t len, uint16_t *pos,
+                                      parrot_payload_field *field) {
+    if (*pos >= len) {
+        return 0;
+    }
+
+    const uint8_t meta = bytes[*pos];
+    const uint8_t type = meta >> 6;
+    if (type > kFixedString) {
+        return -1;
+    }
+
+    uint64_t value = 0;
+    uint32_t next = *pos + 1u;
+    const uint32_t varint_len = parrot_varint_decode(bytes + next, len - next, &value);
+    if (varint_len == 0) {
+        return -1;
+    }
+    next += varint_len;
+
+    if (type == kFixedString) {
+        if (value > PARROT_STRING_MAX || value > len - next) {
+            return -1;
+        }
+        field->offset = (uint16_t) next;
+        next += (uint32_t) value;
+    }
+
+    field->key = meta & 0x3F;
+    field->type = type;
+    field->value = value;
+    *pos = (uint16_t) next;
+    return 1;
+}
+
+/**
+ * @return Value of an integer field read by parrot_payload_next()
+ */
+static inline int64_t parrot_payload_field_integer(const parrot_payload_field *field) {
+    return field->type == kNegativeInt ? -(int64_t) field->value : (int64_t) field->value;
+}
+
+/**
+ * @brief Walk a payload once, calling back for each field whose key is in field_mask.
+ *
+ * Fields outside the mask are stepped over: their integers and strings are
+ * not materialized. Strings are passed as pointers into the payload.
+ *
+ * @param data [in] payload data
+ * @param len [in] payload length
+ * @param field_mask [in] PARROT_FIELD(key) bits of the wanted keys, PARROT_ALL_FIELDS for all
+ * @param callbacks [in] field handlers
+ * @param user_data [in] passed to the handlers
+ * @return parrot_true if the payload was well-formed up to where the visit ended, parrot_false otherwise
+ */
+parrot_bool parrot_payload_visit(const void *data, uint16_t len, uint64_t field_mask,
+                                 const parrot_payload_callbacks *callbacks, void *user_data);
+
 typedef struct payload_entry {
     uint8_t key;
     uint8_t is_string;
@@ -36,6 +144,94 @@ void parrot_payload_parse_init(payload_parse *parse, const void *data, uint16_t
 
 uint16_t parrot_payload_parse_entry(payload_entry *out, payload_parse *parse);
 
+#define PAYLOAD_INDEX_MAX_ENTRIES 64
+#define PAYLOAD_INDEX_END 0xFF
+
+typedef struct payload_index_entry {
+    union {
+        int64_t integer;
+        struct {
+            uint16_t offset;    // from the start of the payload
+            uint16_t length;
+        } string;
+    } value;
+    uint8_t is_string;
+    uint8_t next;               // next entry with the same key, PAYLOAD_INDEX_END if none
+} payload_index_entry;
+
+/**
+ * @brief Random access to the fields of one payload, built by a single scan.
+ *
+ * present has a PARROT_FIELD(key) bit for each key in the payload; first[key]
+ * is its first entry (valid only for present keys), and entries of a key that
+ * repeats are chained on next in payload order. Integers are decoded once,
+ * strings are offsets into the payload, which must outlive the index.
+ */
+typedef struct payload_index {
+    const uint8_t *data;
+    uint64_t present;
+    uint8_t count;
+    uint8_t first[64];
+    payload_index_entry entries[PAYLOAD_INDEX_MAX_ENTRIES];
+} payload_index;
+
+/**
+ * @brief Scan a payload once and index its fields
+ * @param index [out] index to build
+ * @param data [in] payload data
+ * @param len [in] payload length
+ * @return parrot_true for success, parrot_false if the payload is malformed or
+ *         has more than PAYLOAD_INDEX_MAX_ENTRIES fields
+ */
+parrot_bool parrot_payload_index_build(payload_index *index, const void *data, uint16_t len);
+
+/**
+ * @return First entry of a key, NULL if the key is absent
+ */
+static inline const payload_index_entry *parrot_payload_index_find(const payload_index *index, const uint8_t key) {
+    if (key > 63 || (index->present & PARROT_FIELD(key)) == 0) {
+        return NULL;
+    }
+    return &index->entries[index->first[key]];
+}
+
+/**
+ * @return Next entry with the same key as entry, NULL after the last one
+ */
+static inline const payload_index_entry *parrot_payload_index_next(const payload_index *index,
+                                                                   const payload_index_entry *entry) {
+    return entry->next == PAYLOAD_INDEX_END ? NULL : &index->entries[entry->next];
+}
+
+/**
+ * @brief Get the first integer field with a key
+ * @return parrot_true if found, parrot_false if the key is absent or its first field is a string
+ */
+static inline parrot_bool parrot_payload_index_integer(const payload_index *index, const uint8_t key,
+                                                       int64_t *value) {
+    const payload_index_entry *entry = parrot_payload_index_find(index, key);
+    if (entry == NULL || entry->is_string) {
+        return parrot_false;
+    }
+    *value = entry->value.integer;
+    return parrot_true;
+}
+
+/**
+ * @brief Get the first string field with a key, pointing into the payload
+ * @return parrot_true if found, parrot_false if the key is absent or its first field is an integer
+ */
+static inline parrot_bool parrot_payload_index_string(const payload_index *index, const uint8_t key,
+                                                      const char **data, uint16_t *length) {
+    const payload_index_entry *entry = parrot_payload_index_find(index, key);
+    if (entry == NULL || !entry->is_string) {
+        return parrot_false;
+    }
+    *data = (const char *) index->data + entry->value.string.offset;
+    *length = entry->value.string.length;
+    return parrot_true;
+}
+
 #if __cplusplus
 }
 #endif
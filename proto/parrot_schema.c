@@ -0,0 +1,234 @@
+#include "parrot_schema.h"
+
+#define SCHEMA_KEY_LIMIT(fields) ((uint8_t) (sizeof(fields) / sizeof((fields)[0])))
+
+static const parrot_field register_req_fields[] = {
+    [1] = PARROT_STRING_FIELD(parrot_register_req, client_ip, kFieldOptional),
+    [2] = PARROT_STRING_FIELD(parrot_register_req, client_version, kFieldOptional),
+    [3] = PARROT_INTEGER_FIELD(parrot_register_req, ao_volume, kFieldOptional),
+};
+
+static const parrot_field register_res_fields[] = {
+    [1] = PARROT_INTEGER_FIELD(parrot_register_res, result, kFieldOptional),
+    [2] = PARROT_STRING_FIELD(parrot_register_res, message, kFieldOptional),
+};
+
+static const parrot_field status_notify_fields[] = {
+    [1] = PARROT_INTEGER_FIELD(parrot_status_notify, status, kFieldRequired),
+    [2] = PARROT_STRING_FIELD(parrot_status_notify, message, kFieldRequired),
+};
+
+static const parrot_field audio_notify_fields[] = {
+    [1] = PARROT_REPEATED_STRING_FIELD(parrot_audio_notify, frames, frame_count),
+    [PARROT_AUDIO_SENT_AT_KEY] = PARROT_INTEGER_FIELD(parrot_audio_notify, sent_at_us, kFieldOptional),
+};
+
+static const parrot_field volume_fields[] = {
+    [1] = PARROT_INTEGER_FIELD(parrot_volume, audio_dev_id, kFieldRequired),
+    [2] = PARROT_INTEGER_FIELD(parrot_volume, volume, kFieldRequired),
+};
+
+const parrot_schema parrot_schema_register_req = {
+    0x01, "register request", SCHEMA_KEY_LIMIT(register_req_fields), register_req_fields, 0, 0
+};
+const parrot_schema parrot_schema_register_res = {
+    0x02, "register response", SCHEMA_KEY_LIMIT(register_res_fields), register_res_fields, 0, 0
+};
+const parrot_schema parrot_schema_keep_alive_req = {0x03, "keep-alive request", 0, NULL, 0, 0};
+const parrot_schema parrot_schema_keep_alive_res = {0x04, "keep-alive response", 0, NULL, 0, 0};
+const parrot_schema parrot_schema_unregister_req = {0x05, "unregister request", 0, NULL, 0, 0};
+const parrot_schema parrot_schema_unregister_res = {0x06, "unregister response", 0, NULL, 0, 0};
+const parrot_schema parrot_schema_status_notify = {
+    0x40, "online status notify", SCHEMA_KEY_LIMIT(status_notify_fields), status_notify_fields,
+    PARROT_FIELD(1) | PARROT_FIELD(2), 0
+};
+// frame_data is required and repeats, one per 20 ms frame
+const parrot_schema parrot_schema_audio_notify = {
+    0x41, "audio data notify", SCHEMA_KEY_LIMIT(audio_notify_fields), audio_notify_fields,
+    PARROT_FIELD(1), PARROT_FIELD(1)
+};
+const parrot_schema parrot_schema_start_play = {0x42, "start play notify", 0, NULL, 0, 0};
+const parrot_schema parrot_schema_stop_play = {0x43, "stop play notify", 0, NULL, 0, 0};
+const parrot_schema parrot_schema_volume_notify = {
+    0x44, "volume notify", SCHEMA_KEY_LIMIT(volume_fields), volume_fields, PARROT_FIELD(1) | PARROT_FIELD(2), 0
+};
+const parrot_schema parrot_schema_volume_report = {
+    0x45, "volume report", SCHEMA_KEY_LIMIT(volume_fields), volume_fields, PARROT_FIELD(1) | PARROT_FIELD(2), 0
+};
+
+static const parrot_schema *const request_schemas[] = {
+    NULL,
+    &parrot_schema_register_req,
+    &parrot_schema_register_res,
+    &parrot_schema_keep_alive_req,
+    &parrot_schema_keep_alive_res,
+    &parrot_schema_unregister_req,
+    &parrot_schema_unregister_res,
+};
+
+static const parrot_schema *const notify_schemas[] = {
+    &parrot_schema_status_notify,
+    &parrot_schema_audio_notify,
+    &parrot_schema_start_play,
+    &parrot_schema_stop_play,
+    &parrot_schema_volume_notify,
+    &parrot_schema_volume_report,
+};
+
+const parrot_schema *parrot_schema_find(const uint16_t command) {
+    if (command < sizeof(request_schemas) / sizeof(request_schemas[0])) {
+        return request_schemas[command];
+    }
+    if (command >= 0x40 && command - 0x40 < (int) (sizeof(notify_schemas) / sizeof(notify_schemas[0]))) {
+        return notify_schemas[command - 0x40];
+    }
+    return NULL;
+}
+
+parrot_schema_result parrot_schema_decode(const parrot_schema *schema, const void *data, const uint16_t len,
+                                          void *target, uint64_t *present) {
+    const uint8_t *bytes = data;
+    uint8_t *base = target;
+    uint64_t seen = 0;
+
+    for (uint64_t repeated = schema->repeated; repeated != 0; repeated &= repeated - 1) {
+        base[schema->fields[__builtin_ctzll(repeated)].count_offset] = 0;
+    }
+
+    uint16_t pos = 0;
+    parrot_payload_field entry;
+    int next;
+    while ((next = parrot_payload_next(bytes, len, &pos, &entry)) > 0) {
+        const uint8_t key = entry.key;
+
+        // unknown keys are skipped: newer peers may add fields
+        if (key >= schema->key_limit || schema->fields[key].type == kFieldNone) {
+            continue;
+        }
+
+        const parrot_field *field = &schema->fields[key];
+        if ((field->type == kFieldString) != (entry.type == kFixedString)) {
+            return kSchemaWrongType;
+        }
+
+        uint8_t *member = base + field->offset;
+        if (field->presence == kFieldRepeated) {
+            uint8_t *count = base + field->count_offset;
+            if (*count >= field->capacity) {
+                return kSchemaTooMany;
+            }
+            member += *count * (field->type == kFieldString ? sizeof(parrot_string_ref) : sizeof(int64_t));
+            ++*count;
+        } else if (seen & PARROT_FIELD(key)) {
+            return kSchemaDuplicate;
+        }
+        seen |= PARROT_FIELD(key);
+
+        if (entry.type == kFixedString) {
+            parrot_string_ref *ref = (parrot_string_ref *) member;
+            ref->data = (const char *) bytes + entry.offset;
+            ref->length = (int16_t) entry.value;
+        } else {
+            *(int64_t *) member = parrot_payload_field_integer(&entry);
+        }
+    }
+    if (next < 0) {
+        return kSchemaMalformed;
+    }
+
+    if (present != NULL) {
+        *present = seen;
+    }
+    return (schema->required & ~seen) == 0 ? kSchemaOk : kSchemaMissing;
+}
+
+/**
+ * @brief Where encoded fields go: a payload string, or a message being built if builder is set
+ */
+typedef struct schema_sink {
+    c_string *payload;
+    parrot_builder *builder;
+} schema_sink;
+
+static parrot_bool schema_put_value(const schema_sink *sink, const uint8_t key, const uint8_t type,
+                                    const uint8_t *member) {
+    if (type == kFieldString) {
+        const parrot_string_ref *ref = (const parrot_string_ref *) member;
+        return sink->builder != NULL
+               ? parrot_builder_put_string(sink->builder, key, ref->data, ref->length)
+               : parrot_payload_put_string(sink->payload, key, ref->data, ref->length);
+    }
+
+    const int64_t value = *(const int64_t *) member;
+    return sink->builder != NULL
+           ? parrot_builder_put_integer(sink->builder, key, value)
+           : parrot_payload_put_integer(sink->payload, key, value);
+}
+
+static parrot_schema_result schema_encode(const parrot_schema *schema, const void *source, const uint64_t present,
+                                          const schema_sink *sink) {
+    const uint8_t *base = source;
+    if ((schema->required & ~present) != 0) {
+        return kSchemaMissing;
+    }
+
+    for (uint8_t key = 0; key < schema->key_limit; key++) {
+        const parrot_field *field = &schema->fields[key];
+        if (field->type == kFieldNone || (present & PARROT_FIELD(key)) == 0) {
+            continue;
+        }
+
+        if (field->presence != kFieldRepeated) {
+            if (!schema_put_value(sink, key, field->type, base + field->offset)) {
+                return kSchemaMalformed;
+            }
+            continue;
+        }
+
+        const uint8_t count = base[field->count_offset];
+        const size_t size = field->type == kFieldString ? sizeof(parrot_string_ref) : sizeof(int64_t);
+        if (count > field->capacity) {
+            return kSchemaTooMany;
+        }
+        if (count == 0 && (schema->required & PARROT_FIELD(key))) {
+            return kSchemaMissing;
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            if (!schema_put_value(sink, key, field->type, base + field->offset + i * size)) {
+                return kSchemaMalformed;
+            }
+        }
+    }
+
+    return kSchemaOk;
+}
+
+parrot_schema_result parrot_schema_encode(const parrot_schema *schema, const void *source, const uint64_t present,
+                                          c_string *payload) {
+    const schema_sink sink = {payload, NULL};
+    return schema_encode(schema, source, present, &sink);
+}
+
+parrot_schema_result parrot_schema_build(const parrot_schema *schema, const void *source, const uint64_t present,
+                                         parrot_builder *builder) {
+    const schema_sink sink = {NULL, builder};
+    return schema_encode(schema, source, present, &sink);
+}
+
+const char *parrot_schema_result_name(const parrot_schema_result result) {
+    switch (result) {
+        case kSchemaOk:
+            return "ok";
+        case kSchemaMalformed:
+            return "malformed payload";
+        case kSchemaWrongType:
+            return "field of the wrong type";
+        case kSchemaDuplicate:
+            return "duplicate field";
+        case kSchemaTooMany:
+            return "too many values of a repeated field";
+        case kSchemaMissing:
+            return "required field missing";
+    }
+    return "unknown";
+}
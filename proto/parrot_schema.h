@@ -0,0 +1,185 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parrot_builder.h"
+#include "parrot_payload.h"
+
+#define PARROT_AUDIO_MAX_FRAMES 16
+#define PARROT_AUDIO_SENT_AT_KEY 63     // test-only send time, see parrot_audio_notify
+
+typedef enum parrot_field_type {
+    kFieldNone = 0,     // no field has this key
+    kFieldInteger,      // int64_t member
+    kFieldString,       // parrot_string_ref member
+} parrot_field_type;
+
+typedef enum parrot_field_presence {
+    kFieldOptional = 0,
+    kFieldRequired,
+    kFieldRepeated,     // array member with a uint8_t count member, may be absent
+} parrot_field_presence;
+
+typedef enum parrot_schema_result {
+    kSchemaOk = 0,
+    kSchemaMalformed,       // not a well-formed payload
+    kSchemaWrongType,       // a known key with the other field type
+    kSchemaDuplicate,       // a non-repeated key seen twice
+    kSchemaTooMany,         // more values of a repeated key than its array holds
+    kSchemaMissing,         // a required key absent
+} parrot_schema_result;
+
+/**
+ * @brief A string field: points into the decoded payload, not NUL-terminated.
+ *        For encoding, a length of -1 takes the length of a NUL-terminated string.
+ */
+typedef struct parrot_string_ref {
+    const char *data;
+    int16_t length;
+} parrot_string_ref;
+
+/**
+ * @brief Where a field goes in the command's struct. Descriptors are indexed by key.
+ */
+typedef struct parrot_field {
+    uint8_t type;           // parrot_field_type
+    uint8_t presence;       // parrot_field_presence
+    uint8_t capacity;       // repeated: array length
+    uint16_t offset;        // offset of the member (the array, for repeated fields)
+    uint16_t count_offset;  // repeated: offset of the uint8_t count member
+} parrot_field;
+
+/**
+ * @brief Payload layout of one command.
+ *
+ * fields[key] describes the field with that key, for keys below key_limit;
+ * keys without a field are kFieldNone. The decoder jumps straight to the
+ * descriptor of each key it reads; unknown keys are skipped.
+ */
+typedef struct parrot_schema {
+    uint16_t command;
+    const char *name;
+    uint8_t key_limit;
+    const parrot_field *fields;
+    uint64_t required;      // PARROT_FIELD(key) bits of the required keys
+    uint64_t repeated;      // PARROT_FIELD(key) bits of the repeated keys
+} parrot_schema;
+
+#define PARROT_INTEGER_FIELD(type, member, presence) {kFieldInteger, presence, 0, offsetof(type, member), 0}
+#define PARROT_STRING_FIELD(type, member, presence) {kFieldString, presence, 0, offsetof(type, member), 0}
+#define PARROT_REPEATED_STRING_FIELD(type, member, count) \
+    {kFieldString, kFieldRepeated, sizeof(((type *) 0)->member) / sizeof(parrot_string_ref), \
+     offsetof(type, member), offsetof(type, count)}
+
+/**
+ * @brief 0x01 Register request: #1 client_ip, #2 client_version, #3 ao_volume, all optional
+ */
+typedef struct parrot_register_req {
+    parrot_string_ref client_ip;
+    parrot_string_ref client_version;
+    int64_t ao_volume;
+} parrot_register_req;
+
+/**
+ * @brief 0x02 Register response: #1 result (0 if absent), #2 message, both optional
+ */
+typedef struct parrot_register_res {
+    int64_t result;
+    parrot_string_ref message;
+} parrot_register_res;
+
+/**
+ * @brief 0x40 Online status notify: #1 status, #2 message, both required
+ */
+typedef struct parrot_status_notify {
+    int64_t status;
+    parrot_string_ref message;
+} parrot_status_notify;
+
+/**
+ * @brief 0x41 Audio data notify: #1 opus frame, one or more
+ *
+ * #63 is not part of the protocol: parrot-sim sends its CLOCK_MONOTONIC
+ * time in microseconds there, so that a client on the same host can
+ * measure one-way latency. Other peers skip it as an unknown key.
+ */
+typedef struct parrot_audio_notify {
+    uint8_t frame_count;
+    parrot_string_ref frames[PARROT_AUDIO_MAX_FRAMES];
+    int64_t sent_at_us;
+} parrot_audio_notify;
+
+/**
+ * @brief 0x44 Volume notify and 0x45 volume report: #1 audio device id (1 for playback), #2 volume, both required
+ */
+typedef struct parrot_volume {
+    int64_t audio_dev_id;
+    int64_t volume;
+} parrot_volume;
+
+extern const parrot_schema parrot_schema_register_req;      // 0x01
+extern const parrot_schema parrot_schema_register_res;      // 0x02
+extern const parrot_schema parrot_schema_keep_alive_req;    // 0x03
+extern const parrot_schema parrot_schema_keep_alive_res;    // 0x04
+extern const parrot_schema parrot_schema_unregister_req;    // 0x05
+extern const parrot_schema parrot_schema_unregister_res;    // 0x06
+extern const parrot_schema parrot_schema_status_notify;     // 0x40
+extern const parrot_schema parrot_schema_audio_notify;      // 0x41
+extern const parrot_schema parrot_schema_start_play;        // 0x42
+extern const parrot_schema parrot_schema_stop_play;         // 0x43
+extern const parrot_schema parrot_schema_volume_notify;     // 0x44
+extern const parrot_schema parrot_schema_volume_report;     // 0x45
+
+/**
+ * @return Schema of a command, NULL for unknown commands
+ */
+const parrot_schema *parrot_schema_find(uint16_t command);
+
+/**
+ * @brief Decode a payload into the command's struct in one pass.
+ *
+ * Only members of fields present in the payload are written (and the counts
+ * of repeated fields, which are reset first), so the caller sets defaults
+ * for optional fields beforehand. Strings point into the payload.
+ *
+ * @param schema [in] command schema
+ * @param data [in] payload data
+ * @param len [in] payload length
+ * @param target [out] struct of the command, may be NULL for commands without fields
+ * @param present [out] PARROT_FIELD(key) bits of the known keys seen, may be NULL
+ * @return kSchemaOk for success, the first problem found otherwise
+ */
+parrot_schema_result parrot_schema_decode(const parrot_schema *schema, const void *data, uint16_t len,
+                                          void *target, uint64_t *present);
+
+/**
+ * @brief Append the fields of a command's struct to a payload, in key order
+ * @param schema [in] command schema
+ * @param source [in] struct of the command
+ * @param present [in] PARROT_FIELD(key) bits of the fields to put; repeated fields put their count of values
+ * @param payload [out] payload to append to
+ * @return kSchemaOk for success, kSchemaMissing if a required field is not in present,
+ *         kSchemaMalformed if a value cannot be encoded (e.g. an empty string)
+ */
+parrot_schema_result parrot_schema_encode(const parrot_schema *schema, const void *source, uint64_t present,
+                                          c_string *payload);
+
+/**
+ * @brief Like parrot_schema_encode(), but encode the fields straight into a message being built
+ * @return As parrot_schema_encode(); fields that don't fit also give kSchemaMalformed and fail the builder
+ */
+parrot_schema_result parrot_schema_build(const parrot_schema *schema, const void *source, uint64_t present,
+                                         parrot_builder *builder);
+
+/**
+ * @return Short description of a result
+ */
+const char *parrot_schema_result_name(parrot_schema_result result);
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,111 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#define PARROT_VARINT_MAX_BYTES 9   // 63 bits
+
+/**
+ * @brief Gather the 7-bit groups of up to 8 little-endian varint bytes into one value
+ * @param word [in] varint bytes, continuation bits included, bytes past the varint cleared
+ */
+static inline uint64_t parrot_varint_compact(uint64_t word) {
+#if defined(__BMI2__)
+    return _pext_u64(word, 0x7F7F7F7F7F7F7F7Full);
+#else
+    word &= 0x7F7F7F7F7F7F7F7Full;
+    word = (word & 0x007F007F007F007Full) | ((word & 0x7F007F007F007F00ull) >> 1);
+    word = (word & 0x00003FFF00003FFFull) | ((word & 0x3FFF00003FFF0000ull) >> 2);
+    word = (word & 0x000000000FFFFFFFull) | ((word & 0x0FFFFFFF00000000ull) >> 4);
+    return word;
+#endif
+}
+
+/**
+ * @brief Decode a payload varint (LEB128, 7 bits per byte, at most PARROT_VARINT_MAX_BYTES bytes)
+ *
+ * With 8 or more bytes available, one unaligned load finds the last byte of
+ * the varint: the lowest clear continuation bit, by count-trailing-zeros.
+ * Near the end of the buffer, and for varints longer than 8 bytes, bytes
+ * are read one at a time with bounds checks.
+ *
+ * @param bytes [in] first byte of the varint
+ * @param available [in] bytes readable from bytes
+ * @param value [out] decoded value
+ * @return Length of the varint in bytes, 0 if it's truncated or too long
+ */
+static inline uint32_t parrot_varint_decode(const uint8_t *bytes, const uint32_t available, uint64_t *value) {
+    // most varints (keys, small integers, string lengths < 128) are one byte
+    if (available != 0 && (bytes[0] & 0x80) == 0) {
+        *value = bytes[0];
+        return 1;
+    }
+
+    if (available >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        const uint64_t stops = ~word & 0x8080808080808080ull;
+        if (stops != 0) {
+            // keep the bytes up to and including the first one without continuation bit
+            const uint64_t keep = stops ^ (stops - 1);
+            *value = parrot_varint_compact(word & keep);
+            return (uint32_t) (__builtin_ctzll(stops) >> 3) + 1;
+        }
+    }
+
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < available && i < PARROT_VARINT_MAX_BYTES; i++) {
+        result |= (uint64_t) (bytes[i] & 0x7F) << (7 * i);
+        if ((bytes[i] & 0x80) == 0) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Encode a payload varint (LEB128)
+ * @param bytes [out] room for the varint, 10 bytes for any 64-bit value
+ * @return Length of the varint in bytes
+ */
+static inline uint32_t parrot_varint_encode(uint8_t *bytes, uint64_t value) {
+    uint32_t n = 0;
+    while (value >= 0x80) {
+        bytes[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    bytes[n++] = (uint8_t) value;
+    return n;
+}
+
+/**
+ * @brief Decode a message header varint: 7 bits, then if the top bit is set, 8 more bits (at most 15 bits)
+ * @param available [in] bytes readable from bytes, at least 1
+ * @param value [out] decoded value
+ * @return Length of the varint in bytes, 0 if it's truncated
+ */
+static inline uint32_t parrot_varint2_decode(const uint8_t *bytes, const uint32_t available, uint16_t *value) {
+    const uint32_t more = bytes[0] >> 7;
+    if (more > available - 1) {
+        return 0;
+    }
+
+    const uint32_t high = more ? bytes[1] : 0;
+    *value = (uint16_t) ((bytes[0] & 0x7Fu) | (high << 7));
+    return 1 + more;
+}
+
+#if __cplusplus
+}
+#endif
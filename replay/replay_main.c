@@ -0,0 +1,176 @@
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../proto/parrot_message.h"
+#include "../net/event_loop.h"
+#include "../net/spsc_queue.h"
+#include "../net/udp_trace.h"
+#include "../client/client_worker.h"
+#include "../client/device_table.h"
+#include "../client/jitter_buffer.h"
+
+static double speed = 0;
+static uint32_t repeat = 1;
+static const char *devices_path = NULL;
+
+static udp_trace_reader trace;
+static client_worker w;
+
+static void usage(const char *program) {
+    printf("Usage: %s [options] <trace>\n", program);
+    printf("Feeds the datagrams received in a parrot-lite --capture trace through the client's parse and dispatch\n");
+    printf("path, without a network. The summary is a JSON line on stderr; the client's own output goes to stdout.\n");
+    printf("  --speed FACTOR   replay at FACTOR times the recorded speed, e.g. 1 (default 0: as fast as possible)\n");
+    printf("  --repeat N       replay the trace N times (default 1)\n");
+    printf("  --devices FILE   host the devices listed in FILE (default: the devices found in the trace)\n");
+}
+
+static uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static void sleep_until_ns(const uint64_t deadline) {
+    const struct timespec ts = {(time_t) (deadline / 1000000000u), (long) (deadline % 1000000000u)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/**
+ * @brief Host every device that sent or was sent a message in the trace
+ */
+static int load_trace_devices(device_table *devices) {
+    for (uint64_t i = 0; i < trace.count; i++) {
+        const udp_trace_record *record = udp_trace_reader_at(&trace, i);
+        parrot_message msg;
+        if (parrot_message_parse(&msg, udp_trace_record_data(record), record->length) != kParrotOk
+            || msg.device == 0 || device_table_find(devices, msg.device) != NULL) {
+            continue;
+        }
+        if (device_table_insert(devices, msg.device) == NULL) {
+            return -1;
+        }
+    }
+    return (int) devices->count;
+}
+
+/**
+ * @brief Throw away the played out frames: there's no playback thread
+ */
+static void drain_audio_queue(void) {
+    while (spsc_queue_front(&w.audio_queue) != NULL) {
+        spsc_queue_pop(&w.audio_queue);
+    }
+}
+
+int main(const int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"speed", required_argument, NULL, 's'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"devices", required_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:r:d:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                speed = strtod(optarg, NULL);
+                break;
+            case 'r':
+                repeat = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                devices_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (speed < 0) speed = 0;
+    if (repeat == 0) repeat = 1;
+
+    if (udp_trace_reader_open(&trace, argv[optind]) != 0) {
+        return 1;
+    }
+
+    client_worker_reset(&w);
+    int loaded = -1;
+    if (device_table_init(&w.devices, 1) == 0) {
+        loaded = devices_path != NULL ? device_table_load(&w.devices, devices_path) : load_trace_devices(&w.devices);
+    }
+    const client_worker_options worker_options = {NULL, 0, kUdpIoBatch, NULL};
+    if (loaded <= 0 || client_worker_init(&w, 0, &worker_options) != 0) {
+        fprintf(stderr, "Failed to set up a client for %d devices\n", loaded);
+        client_worker_destroy(&w);
+        udp_trace_reader_close(&trace);
+        return 1;
+    }
+
+    // the worker's clock follows the trace, so that jitter buffers see the recorded arrival times
+    const uint64_t duration_ns = trace.count != 0 ? udp_trace_reader_at(&trace, trace.count - 1)->time_ns : 0;
+    const uint64_t pass_ns = duration_ns + AUDIO_FRAME_MS * 1000000ull;
+    const uint64_t base_ms = event_loop_now_ms(&w.loop);
+    uint64_t next_playout_ms = base_ms + AUDIO_FRAME_MS;
+    uint64_t replayed = 0;
+    uint64_t skipped = 0;
+
+    const uint64_t start = clock_ns();
+    for (uint32_t pass = 0; pass < repeat; pass++) {
+        for (uint64_t i = 0; i < trace.count; i++) {
+            const udp_trace_record *record = udp_trace_reader_at(&trace, i);
+            if (record->direction != kUdpTraceRx || record->length == 0) {
+                ++skipped;
+                continue;
+            }
+
+            const uint64_t time_ns = pass * pass_ns + record->time_ns;
+            if (speed > 0) {
+                sleep_until_ns(start + (uint64_t) ((double) time_ns / speed));
+            }
+
+            w.loop.now_ms = base_ms + time_ns / 1000000u;
+            while (next_playout_ms <= w.loop.now_ms) {
+                client_worker_playout(&w);
+                drain_audio_queue();
+                next_playout_ms += AUDIO_FRAME_MS;
+            }
+
+            client_worker_handle_datagram(&w, udp_trace_record_data(record), record->length);
+            ++replayed;
+        }
+
+        // serials start over with the next pass
+        for (uint32_t j = 0; j < w.playing_count; j++) {
+            jitter_buffer_reset(w.playing[j]);
+        }
+    }
+    const double seconds = (double) (clock_ns() - start) / 1e9;
+    fflush(stdout);
+
+    fprintf(stderr, "{\"kind\": \"replay\", \"records\": %llu, \"passes\": %u, \"devices\": %u, \"replayed\": %llu, "
+                    "\"skipped\": %llu, \"trace_seconds\": %.3f, \"seconds\": %.3f, \"datagrams_per_s\": %.0f, "
+                    "\"ns_per_datagram\": %.1f, \"handle_p50_ns\": %llu, \"handle_p99_ns\": %llu}\n",
+            (unsigned long long) trace.count, repeat, w.devices.count, (unsigned long long) replayed,
+            (unsigned long long) skipped, (double) duration_ns / 1e9, seconds,
+            seconds > 0 ? (double) replayed / seconds : 0, replayed != 0 ? seconds * 1e9 / (double) replayed : 0,
+            (unsigned long long) metrics_histogram_quantile(&w.metrics.handle_ns, 0.50),
+            (unsigned long long) metrics_histogram_quantile(&w.metrics.handle_ns, 0.99));
+
+    client_worker_destroy(&w);
+    udp_trace_reader_close(&trace);
+    return 0;
+}
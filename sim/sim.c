@@ -0,0 +1,222 @@
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../proto/parrot_builder.h"
+#include "../proto/parrot_schema.h"
+
+#define SIM_SESSION_TIMEOUT_MS (90 * 1000)
+#define SIM_MAX_TICK_MS 20
+
+static uint64_t sim_random(sim *s) {
+    // xorshift64*
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    return s->rng * 0x2545F4914F6CDD1Dull;
+}
+
+static parrot_bool sim_chance(sim *s, const double probability) {
+    return probability > 0 && (double) (sim_random(s) >> 11) * 0x1.0p-53 < probability;
+}
+
+static int64_t sim_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sim_queue(sim *s, const uint32_t id, const void *data, const uint16_t length) {
+    uint16_t size = 0;
+    void *slot = udp_io_slot(&s->server.io, &size);
+    if (size < length) {
+        udp_io_commit(&s->server.io, 0, NULL);
+        return;
+    }
+
+    memcpy(slot, data, length);
+    udp_io_commit(&s->server.io, length, &s->server.sessions.addr[id]);
+    s->stats.sent++;
+    s->stats.bytes += length;
+}
+
+static uint16_t sim_build_audio(const sim *s, uint8_t *message, const uint32_t device, const uint16_t serial,
+                                const int64_t now_us) {
+    parrot_builder b;
+    parrot_builder_begin(&b, message, SIM_MESSAGE_SIZE, device, 0x41, serial);
+    for (uint8_t i = 0; i < s->options.frames_per_message; i++) {
+        parrot_builder_put_string(&b, 1, (const char *) s->frame, (int16_t) s->options.frame_bytes);
+    }
+    parrot_builder_put_integer(&b, PARROT_AUDIO_SENT_AT_KEY, now_us);
+    return parrot_builder_finish(&b, s->options.checksum);
+}
+
+/**
+ * @brief Generate the next audio message of a session and put it through the impairments
+ */
+static void sim_send_audio(sim *s, const uint32_t id, const int64_t now_us) {
+    session_table *sessions = &s->server.sessions;
+    const sim_options *o = &s->options;
+
+    if (s->device[id] != sessions->device[id]) {
+        // a new session on a reused id
+        s->device[id] = sessions->device[id];
+        s->loss_left[id] = 0;
+        s->held_length[id] = 0;
+    }
+
+    sessions->serial[id] = (uint16_t) (sessions->serial[id] % 0x7FFF + 1);
+    s->stats.messages++;
+    s->stats.frames += o->frames_per_message;
+
+    if (s->loss_left[id] != 0 || sim_chance(s, o->loss)) {
+        if (s->loss_left[id] == 0) {
+            s->loss_left[id] = o->loss_burst;
+        }
+        s->loss_left[id]--;
+        s->stats.lost++;
+        return;
+    }
+
+    uint8_t message[SIM_MESSAGE_SIZE];
+    const uint16_t length = sim_build_audio(s, message, sessions->device[id], sessions->serial[id], now_us);
+    if (length == 0) {
+        return;
+    }
+
+    // held back, to go out after the next message of the device
+    if (s->held_length[id] == 0 && sim_chance(s, o->reorder)) {
+        memcpy(s->held + (size_t) id * SIM_MESSAGE_SIZE, message, length);
+        s->held_length[id] = length;
+        s->stats.reordered++;
+        return;
+    }
+
+    sim_queue(s, id, message, length);
+    if (sim_chance(s, o->duplicate)) {
+        sim_queue(s, id, message, length);
+        s->stats.duplicated++;
+    }
+    if (s->held_length[id] != 0) {
+        sim_queue(s, id, s->held + (size_t) id * SIM_MESSAGE_SIZE, s->held_length[id]);
+        s->held_length[id] = 0;
+    }
+}
+
+/**
+ * @return Rounds due by now_ms: one at the start, then options.rate per second of "on" time
+ */
+static uint64_t sim_rounds_due(const sim *s, const uint64_t now_ms) {
+    const sim_options *o = &s->options;
+    uint64_t elapsed = now_ms - s->start_ms;
+    if (o->burst_on_ms != 0) {
+        const uint64_t cycle = (uint64_t) o->burst_on_ms + o->burst_off_ms;
+        const uint64_t phase = elapsed % cycle;
+        elapsed = elapsed / cycle * o->burst_on_ms + (phase < o->burst_on_ms ? phase : o->burst_on_ms);
+    }
+    return elapsed * o->rate / 1000 + 1;
+}
+
+static void sim_on_stream_timer(event_loop *loop, void *user_data) {
+    sim *s = user_data;
+    const uint64_t now_ms = event_loop_now_ms(loop);
+
+    if (s->start_ms == 0) {
+        if (s->server.sessions.count == 0 || s->server.sessions.count < s->options.wait_devices) {
+            return;
+        }
+        s->start_ms = now_ms;
+    }
+
+    const uint64_t due = sim_rounds_due(s, now_ms);
+    if (due - s->rounds > s->options.rate) {
+        // stalled for over a second: resume in real time instead of flooding the devices
+        s->rounds = due - 1;
+    }
+
+    const session_table *sessions = &s->server.sessions;
+    while (s->rounds < due) {
+        const int64_t now_us = sim_clock_us();
+        for (uint32_t id = session_table_first(sessions); id != SESSION_NONE; id = session_table_next(sessions, id)) {
+            sim_send_audio(s, id, now_us);
+        }
+        s->rounds++;
+    }
+    // the adapter flushes its queue at the end of the loop iteration
+}
+
+int sim_init(sim *s, event_loop *loop, const int sock, const udp_io_backend backend, const uint32_t max_devices,
+             const sim_options *options) {
+    memset(s, 0, sizeof(*s));
+    s->options = *options;
+    s->stream_timer = -1;
+    s->rng = options->seed != 0 ? options->seed : 0x9E3779B97F4A7C15ull;
+    if (s->options.rate == 0) s->options.rate = 1;
+    if (s->options.loss_burst == 0) s->options.loss_burst = 1;
+
+    s->frame = malloc(options->frame_bytes != 0 ? options->frame_bytes : 1);
+    s->device = calloc(max_devices, sizeof(uint32_t));
+    s->loss_left = calloc(max_devices, sizeof(uint32_t));
+    s->held_length = calloc(max_devices, sizeof(uint16_t));
+    s->held = malloc((size_t) max_devices * SIM_MESSAGE_SIZE);
+    if (s->frame == NULL || s->device == NULL || s->loss_left == NULL || s->held_length == NULL
+        || s->held == NULL) {
+        fprintf(stderr, "Failed to allocate %u devices\n", max_devices);
+        sim_destroy(s);
+        return -1;
+    }
+    for (uint16_t i = 0; i < options->frame_bytes; i++) {
+        s->frame[i] = (uint8_t) sim_random(s);
+    }
+
+    // the send time has the same varint length for days
+    uint8_t probe[SIM_MESSAGE_SIZE];
+    if (sim_build_audio(s, probe, SESSION_NONE, 0x7FFF, sim_clock_us()) == 0) {
+        fprintf(stderr, "%u frames of %u bytes don't fit a message\n", options->frames_per_message,
+                options->frame_bytes);
+        sim_destroy(s);
+        return -1;
+    }
+
+    if (adapter_init(&s->server, loop, sock, backend, max_devices, SIM_SESSION_TIMEOUT_MS) != 0) {
+        // the adapter cleaned up after itself
+        memset(&s->server, 0, sizeof(s->server));
+        sim_destroy(s);
+        return -1;
+    }
+
+    uint32_t tick_ms = 1000 / s->options.rate;
+    if (tick_ms < 1) tick_ms = 1;
+    if (tick_ms > SIM_MAX_TICK_MS) tick_ms = SIM_MAX_TICK_MS;
+    s->stream_timer = event_loop_add_timer(loop, sim_on_stream_timer, s);
+    if (s->stream_timer < 0) {
+        sim_destroy(s);
+        return -1;
+    }
+    event_loop_set_timer(loop, s->stream_timer, tick_ms, tick_ms);
+    return 0;
+}
+
+void sim_destroy(sim *s) {
+    if (s->server.loop != NULL) {
+        if (s->stream_timer >= 0) {
+            event_loop_del_timer(s->server.loop, s->stream_timer);
+        }
+        adapter_destroy(&s->server);
+    }
+    s->stream_timer = -1;
+
+    free(s->frame);
+    free(s->device);
+    free(s->loss_left);
+    free(s->held_length);
+    free(s->held);
+    s->frame = NULL;
+    s->device = NULL;
+    s->loss_left = NULL;
+    s->held_length = NULL;
+    s->held = NULL;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+
+#include "../adapter/adapter.h"
+#include "../proto/c_string.h"
+
+#define SIM_MESSAGE_SIZE 600
+
+/**
+ * @brief Audio stream and network impairments of the simulator
+ */
+typedef struct sim_options {
+    uint32_t rate;                  // audio messages per second and device
+    uint8_t frames_per_message;     // opus frames in each 0x41 message
+    uint16_t frame_bytes;
+    double loss;                    // probability that a message starts a loss burst
+    uint32_t loss_burst;            // messages lost per burst
+    double reorder;                 // probability that a message is held back behind the next one
+    double duplicate;               // probability that a message is sent twice
+    uint32_t burst_on_ms;           // stream for this long, then pause for burst_off_ms; 0 to stream continuously
+    uint32_t burst_off_ms;
+    uint32_t wait_devices;          // start streaming once this many devices are registered
+    parrot_bool checksum;
+    uint64_t seed;
+} sim_options;
+
+typedef struct sim_stats {
+    uint64_t messages;      // audio messages generated, including lost ones
+    uint64_t frames;
+    uint64_t sent;          // datagrams sent, including duplicates
+    uint64_t bytes;         // bytes of the datagrams sent
+    uint64_t lost;
+    uint64_t reordered;
+    uint64_t duplicated;
+} sim_stats;
+
+/**
+ * @brief Parrot server simulator: the adapter's request handling plus a synthetic audio stream.
+ *
+ * Devices register and keep alive with the embedded adapter. Every
+ * registered device gets 0x41 audio notifications at options.rate, each
+ * stamped with the send time (PARROT_AUDIO_SENT_AT_KEY), and the stream
+ * goes through loss, reordering and duplication before it is sent.
+ *
+ * Per-device stream state is indexed by session id, like the session table.
+ */
+typedef struct sim {
+    adapter server;
+    sim_options options;
+    uint8_t *frame;             // synthetic opus frame
+    uint64_t rng;
+    int stream_timer;
+    uint64_t start_ms;          // streaming started, 0 until then
+    uint64_t rounds;            // audio messages sent to each device so far
+    uint32_t *device;           // device each session's stream state belongs to
+    uint32_t *loss_left;        // messages still to lose in the current burst
+    uint16_t *held_length;      // message held back for reordering, 0 if none
+    uint8_t *held;              // SIM_MESSAGE_SIZE bytes per session
+    sim_stats stats;
+} sim;
+
+/**
+ * @brief Set up the simulator on a bound UDP socket and register it with an event loop
+ * @return 0 for success, -1 for failure
+ */
+int sim_init(sim *s, event_loop *loop, int sock, udp_io_backend backend, uint32_t max_devices,
+             const sim_options *options);
+
+/**
+ * @brief Unregister from the event loop and release resources. The socket is not closed.
+ */
+void sim_destroy(sim *s);
+
+/**
+ * @return Whether streaming has started
+ */
+static inline parrot_bool sim_streaming(const sim *s) {
+    return s->start_ms != 0;
+}
+
+#if __cplusplus
+}
+#endif
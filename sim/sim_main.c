@@ -0,0 +1,275 @@
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../proto/parrot_schema.h"
+#include "../net/event_loop.h"
+#include "../net/udp_io.h"
+#include "../net/udp_socket.h"
+#include "sim.h"
+
+#define SIM_SOCKET_BUFFER (8 * 1024 * 1024)
+#define SIM_DEVICE_BASE 0x30000001u
+
+static uint16_t port = 18029;
+static uint32_t max_devices = 4096;
+static udp_io_backend io_backend = kUdpIoBatch;
+static uint32_t duration_s = 0;
+static uint32_t report_ms = 1000;
+static const char *devices_path = NULL;
+static sim_options options = {50, 1, 80, 0, 1, 0, 0, 0, 0, 0, parrot_true, 0};
+
+static event_loop loop;
+static sim simulator;
+static sim_stats last_stats;
+static uint64_t last_report_ms = 0;
+static uint64_t first_report_ms = 0;
+
+void on_interrupt(const int sig) {
+    (void)sig;
+
+    event_loop_stop(&loop);
+}
+
+static void usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Simulates a Parrot server for parrot-lite: answers register and keep-alive requests and streams\n");
+    printf("synthetic 0x41 audio to every registered device. Reports are JSON lines on stdout.\n");
+    printf("  --port PORT            UDP port (default 18029)\n");
+    printf("  --max-devices N        maximum number of registered devices (default 4096)\n");
+    printf("  --devices N            start streaming once N devices are registered (default: at the first)\n");
+    printf("  --devices-file FILE    write the codes of N devices to FILE, for parrot-lite --devices\n");
+    printf("  --rate N               audio messages per second and device (default 50, one per 20 ms)\n");
+    printf("  --frames N             opus frames per message, 1-%d (default 1)\n", PARROT_AUDIO_MAX_FRAMES);
+    printf("  --frame-bytes N        bytes per opus frame (default 80)\n");
+    printf("  --loss RATIO           probability that a message starts a loss burst, e.g. 0.01\n");
+    printf("  --loss-burst N         messages lost per burst (default 1)\n");
+    printf("  --reorder RATIO        probability that a message is sent after the next one\n");
+    printf("  --duplicate RATIO      probability that a message is sent twice\n");
+    printf("  --burst ON_MS,OFF_MS   stream for ON_MS, pause for OFF_MS, repeat (default: continuous)\n");
+    printf("  --no-checksum          send audio without the optional checksum\n");
+    printf("  --seed N               seed of the impairment generator\n");
+    printf("  --duration SECONDS     stop after this long (default: until interrupted)\n");
+    printf("  --report-ms MS         report interval (default 1000)\n");
+    printf("  --io-uring             receive and send with io_uring (falls back to recvmmsg/sendmmsg)\n");
+}
+
+static int write_devices_file(const char *path, const uint32_t count) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(file, "# %u devices for parrot-sim\n", count);
+    for (uint32_t i = 0; i < count; i++) {
+        fprintf(file, "0x%08x\n", SIM_DEVICE_BASE + i);
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static void print_report(const char *kind, const uint64_t now_ms, const uint64_t since_ms, const sim_stats *since) {
+    const sim_stats *stats = &simulator.stats;
+    const adapter_stats *server = &simulator.server.stats;
+    const double seconds = now_ms > since_ms ? (double) (now_ms - since_ms) / 1000.0 : 0;
+    const double per_s = seconds > 0 ? 1.0 / seconds : 0;
+
+    printf("{\"kind\": \"%s\", \"seconds\": %.3f, \"devices\": %u, \"streaming\": %s, "
+           "\"messages_per_s\": %.0f, \"frames_per_s\": %.0f, \"datagrams_per_s\": %.0f, \"mbit_per_s\": %.3f, "
+           "\"messages\": %llu, \"sent\": %llu, \"lost\": %llu, \"reordered\": %llu, \"duplicated\": %llu, "
+           "\"registered\": %llu, \"expired\": %llu, \"unknown\": %llu, \"corrupted\": %llu}\n",
+           kind, seconds, simulator.server.sessions.count, sim_streaming(&simulator) ? "true" : "false",
+           (double) (stats->messages - since->messages) * per_s, (double) (stats->frames - since->frames) * per_s,
+           (double) (stats->sent - since->sent) * per_s, (double) (stats->bytes - since->bytes) * 8e-6 * per_s,
+           (unsigned long long) stats->messages, (unsigned long long) stats->sent,
+           (unsigned long long) stats->lost, (unsigned long long) stats->reordered,
+           (unsigned long long) stats->duplicated, (unsigned long long) server->registered,
+           (unsigned long long) server->expired, (unsigned long long) server->unknown,
+           (unsigned long long) server->corrupted);
+    fflush(stdout);
+}
+
+static void on_report_timer(event_loop *l, void *user_data) {
+    (void) user_data;
+
+    const uint64_t now = event_loop_now_ms(l);
+    print_report("interval", now, last_report_ms, &last_stats);
+    last_stats = simulator.stats;
+    last_report_ms = now;
+}
+
+static void on_duration_timer(event_loop *l, void *user_data) {
+    (void) user_data;
+
+    event_loop_stop(l);
+}
+
+static int parse_ratio(const char *text, double *out) {
+    char *end = NULL;
+    const double value = strtod(text, &end);
+    if (end == text || *end != '\0' || value < 0 || value > 1) {
+        fprintf(stderr, "bad ratio: %s\n", text);
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+int main(const int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"port", required_argument, NULL, 'p'},
+        {"max-devices", required_argument, NULL, 'm'},
+        {"devices", required_argument, NULL, 'n'},
+        {"devices-file", required_argument, NULL, 'F'},
+        {"rate", required_argument, NULL, 'r'},
+        {"frames", required_argument, NULL, 'f'},
+        {"frame-bytes", required_argument, NULL, 'b'},
+        {"loss", required_argument, NULL, 'l'},
+        {"loss-burst", required_argument, NULL, 'B'},
+        {"reorder", required_argument, NULL, 'o'},
+        {"duplicate", required_argument, NULL, 'd'},
+        {"burst", required_argument, NULL, 'x'},
+        {"no-checksum", no_argument, NULL, 'C'},
+        {"seed", required_argument, NULL, 's'},
+        {"duration", required_argument, NULL, 't'},
+        {"report-ms", required_argument, NULL, 'R'},
+        {"io-uring", no_argument, NULL, 'u'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:m:n:F:r:f:b:l:B:o:d:x:Cs:t:R:uh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'p':
+                port = (uint16_t) strtol(optarg, NULL, 10);
+                break;
+            case 'm':
+                max_devices = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                options.wait_devices = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'F':
+                devices_path = optarg;
+                break;
+            case 'r':
+                options.rate = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                options.frames_per_message = (uint8_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.frame_bytes = (uint16_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                if (parse_ratio(optarg, &options.loss) != 0) return 1;
+                break;
+            case 'B':
+                options.loss_burst = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                if (parse_ratio(optarg, &options.reorder) != 0) return 1;
+                break;
+            case 'd':
+                if (parse_ratio(optarg, &options.duplicate) != 0) return 1;
+                break;
+            case 'x':
+                if (sscanf(optarg, "%u,%u", &options.burst_on_ms, &options.burst_off_ms) != 2) {
+                    fprintf(stderr, "bad burst pattern: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'C':
+                options.checksum = parrot_false;
+                break;
+            case 's':
+                options.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 't':
+                duration_s = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'R':
+                report_ms = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'u':
+                io_backend = kUdpIoUring;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (options.frames_per_message == 0 || options.frames_per_message > PARROT_AUDIO_MAX_FRAMES
+        || options.frame_bytes == 0 || options.frame_bytes > 512) {
+        fprintf(stderr, "frames must be 1-%d, of 1-512 bytes\n", PARROT_AUDIO_MAX_FRAMES);
+        return 1;
+    }
+    if (options.wait_devices > max_devices) max_devices = options.wait_devices;
+    if (report_ms == 0) report_ms = 1000;
+
+    if (devices_path != NULL) {
+        if (options.wait_devices == 0) {
+            fprintf(stderr, "--devices-file needs --devices\n");
+            return 1;
+        }
+        if (write_devices_file(devices_path, options.wait_devices) != 0) {
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+    signal(SIGPIPE, SIG_IGN);
+
+    const int sock = udp_socket_bind(port, SIM_SOCKET_BUFFER, 0);
+    if (sock < 0) {
+        fprintf(stderr, "Failed to create UDP socket\n");
+        return 1;
+    }
+
+    if (event_loop_init(&loop) != 0) {
+        fprintf(stderr, "Failed to create event loop\n");
+        return 1;
+    }
+
+    if (sim_init(&simulator, &loop, sock, io_backend, max_devices, &options) != 0) {
+        fprintf(stderr, "Failed to set up the simulator\n");
+        event_loop_destroy(&loop);
+        return 1;
+    }
+
+    const int report_timer = event_loop_add_timer(&loop, on_report_timer, NULL);
+    const int duration_timer = duration_s != 0 ? event_loop_add_timer(&loop, on_duration_timer, NULL) : -1;
+    if (report_timer < 0 || (duration_s != 0 && duration_timer < 0)) {
+        fprintf(stderr, "Failed to set up event loop\n");
+        sim_destroy(&simulator);
+        event_loop_destroy(&loop);
+        return 1;
+    }
+    event_loop_set_timer(&loop, report_timer, report_ms, report_ms);
+    if (duration_timer >= 0) {
+        event_loop_set_timer(&loop, duration_timer, duration_s * 1000, 0);
+    }
+
+    fprintf(stderr, "parrot-sim serving on udp port %u (%s), %u messages/s per device, %u x %u-byte frames\n", port,
+            udp_io_backend_name(&simulator.server.io), options.rate, options.frames_per_message,
+            options.frame_bytes);
+
+    first_report_ms = event_loop_clock_ms();
+    last_report_ms = first_report_ms;
+    event_loop_run(&loop);
+
+    const sim_stats none = {0, 0, 0, 0, 0, 0, 0};
+    // rates of the summary are over the streaming time
+    print_report("summary", event_loop_clock_ms(), sim_streaming(&simulator) ? simulator.start_ms : first_report_ms,
+                 &none);
+
+    sim_destroy(&simulator);
+    event_loop_destroy(&loop);
+    return 0;
+}
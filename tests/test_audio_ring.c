@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../client/audio_ring.h"
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+#define TEST_CAPACITY 4096
+
+static int open_pair(audio_ring *producer, audio_ring *consumer) {
+    char name[64];
+    snprintf(name, sizeof(name), "/parrot-test-ring-%d", (int) getpid());
+    if (audio_ring_create(producer, name, TEST_CAPACITY) != 0) {
+        return -1;
+    }
+    if (audio_ring_open(consumer, name) != 0) {
+        audio_ring_close(producer);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Take the oldest record and check it
+ */
+static void expect_record(audio_ring *consumer, const uint8_t type, const uint32_t device, const uint16_t serial,
+                          const char *payload) {
+    const audio_ring_record *record = audio_ring_peek(consumer);
+    EXPECT(record != NULL);
+    if (record == NULL) {
+        return;
+    }
+
+    const uint16_t length = (uint16_t) strlen(payload);
+    EXPECT(record->type == type && record->device == device && record->serial == serial);
+    EXPECT(record->length == length && memcmp(record->payload, payload, length) == 0);
+    EXPECT(record->size % 8 == 0 && record->size >= (uint32_t) AUDIO_RING_RECORD_HEADER_SIZE + length);
+    audio_ring_consume(consumer, record);
+}
+
+static void test_records(void) {
+    audio_ring producer, consumer;
+    if (open_pair(&producer, &consumer) != 0) {
+        ++failures;
+        return;
+    }
+    EXPECT(consumer.capacity == TEST_CAPACITY);
+    EXPECT(audio_ring_peek(&consumer) == NULL);
+
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_START, 7, 1, NULL, 0) == 0);
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_FRAME, 7, 2, "opus frame", 10) == 0);
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_LOST, 7, 3, NULL, 0) == 0);
+
+    // reserve and publish write in place
+    char *payload = audio_ring_reserve(&producer, AUDIO_RING_FRAME, 9, 4, 3);
+    EXPECT(payload != NULL);
+    if (payload != NULL) {
+        memcpy(payload, "abc", 3);
+        audio_ring_publish(&producer);
+    }
+
+    expect_record(&consumer, AUDIO_RING_START, 7, 1, "");
+    expect_record(&consumer, AUDIO_RING_FRAME, 7, 2, "opus frame");
+    expect_record(&consumer, AUDIO_RING_LOST, 7, 3, "");
+    expect_record(&consumer, AUDIO_RING_FRAME, 9, 4, "abc");
+    EXPECT(audio_ring_peek(&consumer) == NULL);
+
+    audio_ring_close(&consumer);
+    audio_ring_close(&producer);
+}
+
+static void test_full(void) {
+    audio_ring producer, consumer;
+    if (open_pair(&producer, &consumer) != 0) {
+        ++failures;
+        return;
+    }
+
+    // a full ring drops records and counts them, and takes them again once some are read
+    uint32_t written = 0;
+    while (audio_ring_write(&producer, AUDIO_RING_FRAME, 1, (uint16_t) written, "0123456789", 10) == 0) {
+        ++written;
+    }
+    EXPECT(written == TEST_CAPACITY / 32 && producer.header->dropped == 1);
+    expect_record(&consumer, AUDIO_RING_FRAME, 1, 0, "0123456789");
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_FRAME, 1, 1000, "0123456789", 10) == 0);
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_FRAME, 1, 1001, "0123456789", 10) != 0);
+    EXPECT(producer.header->dropped == 2);
+
+    audio_ring_close(&consumer);
+    audio_ring_close(&producer);
+}
+
+static void test_wrap(const uint32_t tail_room) {
+    audio_ring producer, consumer;
+    if (open_pair(&producer, &consumer) != 0) {
+        ++failures;
+        return;
+    }
+
+    // fill up to tail_room bytes before the end of the data area, with 16-byte records and one larger one
+    const uint32_t fill = TEST_CAPACITY - tail_room;
+    const uint32_t small = fill / 16 - 2;
+    for (uint32_t i = 0; i < small; i++) {
+        EXPECT(audio_ring_write(&producer, AUDIO_RING_LOST, 2, (uint16_t) i, NULL, 0) == 0);
+        expect_record(&consumer, AUDIO_RING_LOST, 2, (uint16_t) i, "");
+    }
+    char filler[64];
+    memset(filler, 'x', sizeof(filler));
+    const uint16_t last = (uint16_t) (fill - small * 16 - AUDIO_RING_RECORD_HEADER_SIZE);
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_FRAME, 2, 0xFFF, filler, last) == 0);
+    EXPECT(consumer.position + audio_ring_peek(&consumer)->size == fill);
+    audio_ring_consume(&consumer, audio_ring_peek(&consumer));
+
+    // a canary past the data area: the mapping's last page has room beyond it
+    memset(producer.data + TEST_CAPACITY, 0xA5, 16);
+
+    // the next record doesn't fit: a pad of tail_room bytes, then the record at offset 0
+    char wrapped[64];
+    memset(wrapped, 'w', sizeof(wrapped));
+    wrapped[tail_room] = '\0';
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_FRAME, 3, 5, wrapped, (uint16_t) tail_room) == 0);
+    const audio_ring_record *pad = (const audio_ring_record *) (producer.data + fill);
+    EXPECT(pad->size == tail_room && pad->type == AUDIO_RING_PAD);
+    for (uint32_t i = 0; i < 16; i++) {
+        EXPECT(producer.data[TEST_CAPACITY + i] == 0xA5);
+    }
+    expect_record(&consumer, AUDIO_RING_FRAME, 3, 5, wrapped);
+    EXPECT(consumer.position == (uint64_t) TEST_CAPACITY + AUDIO_RING_RECORD_HEADER_SIZE + tail_room);
+    EXPECT(audio_ring_peek(&consumer) == NULL);
+
+    audio_ring_close(&consumer);
+    audio_ring_close(&producer);
+}
+
+static void *wait_for_record(void *arg) {
+    audio_ring *consumer = arg;
+    return (void *) (intptr_t) audio_ring_wait(consumer, 5000);
+}
+
+static void test_wait(void) {
+    audio_ring producer, consumer;
+    if (open_pair(&producer, &consumer) != 0) {
+        ++failures;
+        return;
+    }
+
+    // nothing published: the wait times out
+    EXPECT(audio_ring_wait(&consumer, 10) == 0);
+    EXPECT(consumer.header->waiting == 0);
+
+    // a sleeping consumer is woken by the producer
+    pthread_t thread;
+    EXPECT(pthread_create(&thread, NULL, wait_for_record, &consumer) == 0);
+    const struct timespec delay = {0, 50 * 1000000L};
+    nanosleep(&delay, NULL);
+    const uint32_t seq = producer.header->wake_seq;
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_STOP, 4, 6, NULL, 0) == 0);
+    void *woken = NULL;
+    pthread_join(thread, &woken);
+    EXPECT((intptr_t) woken == 1);
+    EXPECT(producer.header->wake_seq == seq + 1 && producer.header->waiting == 0);
+    expect_record(&consumer, AUDIO_RING_STOP, 4, 6, "");
+
+    // records already published: no sleep
+    EXPECT(audio_ring_write(&producer, AUDIO_RING_START, 4, 7, NULL, 0) == 0);
+    EXPECT(audio_ring_wait(&consumer, -1) == 1);
+
+    audio_ring_close(&consumer);
+    audio_ring_close(&producer);
+}
+
+int main(void) {
+    test_records();
+    test_full();
+    test_wrap(8);       // the pad has just its size and type
+    test_wrap(16);
+    test_wrap(40);
+    test_wait();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../proto/parrot_checksum.h"
+
+#define TEST_MAX_LENGTH 600
+#define TEST_MAX_OFFSET 64
+#define TEST_ROUNDS 20000
+
+static uint64_t test_random = 0x9E3779B97F4A7C15ull;
+
+static uint32_t next_random(void) {
+    // xorshift64*
+    test_random ^= test_random >> 12;
+    test_random ^= test_random << 25;
+    test_random ^= test_random >> 27;
+    return (uint32_t) ((test_random * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/**
+ * @brief Compare an implementation with the scalar reference on one input
+ * @return 0 if they agree, -1 otherwise
+ */
+static int check(const parrot_checksum_impl *impl, const uint8_t *data, const size_t length) {
+    const uint16_t expected = parrot_checksum_scalar(data, length);
+    const uint16_t actual = impl->fn(data, length);
+    if (actual != expected) {
+        fprintf(stderr, "%s: length %zu at alignment %u: 0x%04x, expected 0x%04x\n", impl->name, length,
+                (unsigned) ((uintptr_t) data & (TEST_MAX_OFFSET - 1)), actual, expected);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void) {
+    // 64-byte aligned, so that offset i starts i bytes past a vector boundary
+    static uint8_t buffer[TEST_MAX_OFFSET + 70000] __attribute__((aligned(64)));
+
+    const parrot_checksum_impl *impls = NULL;
+    const uint32_t count = parrot_checksum_impls(&impls);
+    int failures = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int impl_failures = 0;
+
+        // every length and offset, on bytes of all 1s: the largest sums the vector lanes accumulate
+        memset(buffer, 0xFF, sizeof(buffer));
+        for (size_t length = 0; length <= TEST_MAX_LENGTH; length++) {
+            for (uint32_t offset = 0; offset < TEST_MAX_OFFSET; offset++) {
+                impl_failures += check(&impls[i], buffer + offset, length) != 0;
+            }
+        }
+
+        // random bytes, lengths and offsets
+        for (size_t j = 0; j < sizeof(buffer); j++) {
+            buffer[j] = (uint8_t) next_random();
+        }
+        for (uint32_t round = 0; round < TEST_ROUNDS; round++) {
+            const size_t length = next_random() % (TEST_MAX_LENGTH + 1);
+            impl_failures += check(&impls[i], buffer + next_random() % TEST_MAX_OFFSET, length) != 0;
+        }
+
+        // sums that wrap 16 bits many times over
+        impl_failures += check(&impls[i], buffer + 1, sizeof(buffer) - TEST_MAX_OFFSET) != 0;
+
+        printf("%s: %s\n", impls[i].name, impl_failures == 0 ? "ok" : "FAILED");
+        failures += impl_failures;
+    }
+
+    // the dispatched implementation is one of the list
+    failures += parrot_checksum(buffer + 3, 517) != parrot_checksum_scalar(buffer + 3, 517);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../client/jitter_buffer.h"
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+static const char *const frames[] = {"first", "second frame", "3rd"};
+
+/**
+ * @brief Put the frames of a message, as the client does for one audio notify
+ */
+static void put_message(jitter_buffer *jb, const uint16_t serial, const uint32_t count, const uint64_t now_ms) {
+    for (uint32_t i = 0; i < count; i++) {
+        jitter_buffer_put(jb, serial, (uint8_t) i, frames[i], (uint16_t) strlen(frames[i]), now_ms);
+    }
+}
+
+static void expect_frame(jitter_buffer *jb, const uint16_t serial, const char *frame) {
+    uint16_t popped_serial = 0;
+    const uint8_t *data = NULL;
+    uint16_t length = 0;
+    EXPECT(jitter_buffer_pop(jb, &popped_serial, &data, &length) == kJitterFrame);
+    EXPECT(popped_serial == serial);
+    EXPECT(data != NULL && length == strlen(frame) && memcmp(data, frame, length) == 0);
+}
+
+static void test_multi_frame_message(void) {
+    jitter_buffer *jb = jitter_buffer_create(1);
+
+    // every frame of the message is kept and plays in order, one per tick
+    put_message(jb, 100, 3, 0);
+    EXPECT(jb->count == 3 && jb->stats.received == 3 && jb->stats.duplicate == 0);
+    for (uint32_t i = 0; i < 3; i++) {
+        expect_frame(jb, 100, frames[i]);
+    }
+    EXPECT(jb->stats.played == 3 && jb->count == 0);
+
+    uint16_t serial = 0;
+    const uint8_t *data = NULL;
+    uint16_t length = 0;
+    EXPECT(jitter_buffer_pop(jb, &serial, &data, &length) == kJitterWait);
+    EXPECT(jb->stats.underruns == 1);
+    jitter_buffer_destroy(jb);
+}
+
+static void test_duplicate_and_lost(void) {
+    jitter_buffer *jb = jitter_buffer_create(1);
+
+    // a repeated message is a duplicate, frame by frame
+    put_message(jb, 7, 3, 0);
+    put_message(jb, 7, 3, 0);
+    EXPECT(jb->stats.received == 3 && jb->stats.duplicate == 3);
+
+    // serial 8 is missing: it's concealed for as many ticks as a message lasts
+    put_message(jb, 9, 3, 120);
+    for (uint32_t i = 0; i < 3; i++) {
+        expect_frame(jb, 7, frames[i]);
+    }
+    uint16_t serial = 0;
+    const uint8_t *data = NULL;
+    uint16_t length = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+        EXPECT(jitter_buffer_pop(jb, &serial, &data, &length) == kJitterLost && serial == 8);
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        expect_frame(jb, 9, frames[i]);
+    }
+    EXPECT(jb->stats.lost == 3 && jb->stats.played == 6);
+
+    // late frames of a message already played out are dropped
+    put_message(jb, 8, 1, 130);
+    EXPECT(jb->stats.late == 1);
+    jitter_buffer_destroy(jb);
+}
+
+static void test_single_frame_messages(void) {
+    jitter_buffer *jb = jitter_buffer_create(1);
+
+    // reordered one-frame messages play in serial order
+    put_message(jb, 1, 1, 0);
+    put_message(jb, 3, 1, 40);
+    put_message(jb, 2, 1, 20);
+    for (uint16_t serial = 1; serial <= 3; serial++) {
+        expect_frame(jb, serial, frames[0]);
+    }
+    EXPECT(jb->stats.lost == 0 && jb->stats.late == 0);
+    jitter_buffer_destroy(jb);
+}
+
+int main(void) {
+    test_multi_frame_message();
+    test_duplicate_and_lost();
+    test_single_frame_messages();
+    return failures == 0 ? 0 : 1;
+}
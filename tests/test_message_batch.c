@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../proto/parrot_builder.h"
+#include "../proto/parrot_message.h"
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+#define TEST_MAX_MESSAGES 512
+#define TEST_MESSAGE_SIZE 600
+
+static uint8_t messages[TEST_MAX_MESSAGES][TEST_MESSAGE_SIZE];
+static const void *bufs[TEST_MAX_MESSAGES];
+static uint16_t lens[TEST_MAX_MESSAGES];
+static uint32_t message_count = 0;
+
+/**
+ * @brief Add a message to the batch
+ * @return Its bytes, to be altered
+ */
+static uint8_t *add_message(const void *data, const uint16_t length) {
+    uint8_t *bytes = messages[message_count];
+    memcpy(bytes, data, length);
+    bufs[message_count] = bytes;
+    lens[message_count++] = length;
+    return bytes;
+}
+
+static uint16_t build(uint8_t *buf, const uint32_t device, const uint16_t command, const uint16_t serial,
+                      const uint32_t payload_fields, const parrot_bool checksum) {
+    parrot_builder b;
+    parrot_builder_begin(&b, buf, TEST_MESSAGE_SIZE, device, command, serial);
+    for (uint32_t i = 0; i < payload_fields; i++) {
+        parrot_builder_put_string(&b, (uint8_t) (i % 64), "payload field", -1);
+    }
+    return parrot_builder_finish(&b, checksum);
+}
+
+/**
+ * @brief Compare each result of the batch with parrot_message_parse() of the same message
+ */
+static void expect_same_as_parse(const parrot_message_batch *batch, const uint32_t valid) {
+    EXPECT(batch->count == message_count);
+
+    uint32_t ok = 0;
+    for (uint32_t i = 0; i < message_count; i++) {
+        parrot_message msg;
+        const parrot_error error = parrot_message_parse(&msg, bufs[i], lens[i]);
+        EXPECT(batch->status[i] == (uint8_t) error);
+        if (error == kParrotOk) {
+            ++ok;
+            EXPECT(batch->device[i] == msg.device);
+            EXPECT(batch->command[i] == msg.command);
+            EXPECT(batch->serial[i] == msg.serial);
+            EXPECT(batch->payload_len[i] == msg.payload_len);
+            EXPECT(msg.payload_len == 0
+                   || (const uint8_t *) bufs[i] + batch->payload_offset[i] == (const uint8_t *) msg.payload_data);
+        } else {
+            EXPECT(batch->device[i] == 0 && batch->command[i] == 0 && batch->serial[i] == 0);
+            EXPECT(batch->payload_offset[i] == 0 && batch->payload_len[i] == 0);
+            EXPECT(msg.payload_len == 0);
+        }
+    }
+    EXPECT(ok == valid);
+}
+
+static void test_valid(parrot_message_batch *batch) {
+    uint8_t buf[TEST_MESSAGE_SIZE];
+    message_count = 0;
+
+    // every header layout, short and long payloads (one and two-byte lengths), with and without checksum
+    const uint32_t devices[] = {0, 0x12345678};
+    const uint16_t values[] = {0, 1, 127, 128, 0x7FFF};
+    const uint32_t fields[] = {0, 1, 9, 30};
+    for (uint32_t d = 0; d < 2; d++) {
+        for (uint32_t c = 0; c < 5; c++) {
+            for (uint32_t s = 0; s < 5; s++) {
+                for (uint32_t f = 0; f < 4; f++) {
+                    for (parrot_bool checksum = parrot_false; checksum <= parrot_true; checksum++) {
+                        const uint16_t length = build(buf, devices[d], values[c], values[(s + c) % 5], fields[f],
+                                                      checksum);
+                        EXPECT(length != 0);
+                        add_message(buf, length);
+                    }
+                }
+            }
+        }
+    }
+
+    const uint32_t count = message_count;
+    EXPECT(parrot_message_parse_batch(bufs, lens, message_count, batch) == count);
+    expect_same_as_parse(batch, count);
+}
+
+static void test_invalid(parrot_message_batch *batch) {
+    uint8_t buf[TEST_MESSAGE_SIZE];
+    memset(buf, 0, sizeof(buf));
+    message_count = 0;
+
+    // every truncation of a message with checksum
+    const uint16_t length = build(buf, 0xCAFE, 0x41, 300, 3, parrot_true);
+    for (uint16_t n = 0; n < length; n++) {
+        add_message(buf, n);
+    }
+
+    // a wrong checksum, a byte too many, a bad magic, version and reserved bit
+    add_message(buf, length)[length - 1] ^= 0x01;
+    add_message(buf, length)[5] ^= 0x40;
+    add_message(buf, (uint16_t) (length + 1));
+    add_message(buf, length)[0] = 0xFE;
+    add_message(buf, length)[1] ^= 0xC0;
+    add_message(buf, length)[1] |= 0x01;
+
+    EXPECT(parrot_message_parse_batch(bufs, lens, message_count, batch) == 0);
+    expect_same_as_parse(batch, 0);
+    EXPECT(batch->status[0] == kParrotTooShort && batch->status[length - 1] == kParrotTooShort);
+    EXPECT(batch->status[length] == kParrotChecksumMismatch && batch->status[length + 1] == kParrotChecksumMismatch);
+    EXPECT(batch->status[length + 2] == kParrotTooLong && batch->status[length + 3] == kParrotBadMagic);
+    EXPECT(batch->status[length + 4] == kParrotBadVersion && batch->status[length + 5] == kParrotBadReserved);
+}
+
+static void test_mixed(parrot_message_batch *batch) {
+    uint8_t buf[TEST_MESSAGE_SIZE];
+    message_count = 0;
+
+    // valid and invalid messages interleaved: no state leaks from one result to the next
+    uint32_t valid = 0;
+    for (uint32_t i = 0; i < 64; i++) {
+        const uint16_t length = build(buf, i * 0x01000001u, (uint16_t) (i + 1), (uint16_t) (i * 97 + 1), i % 5,
+                                      (parrot_bool) (i & 1));
+        uint8_t *bytes = add_message(buf, (uint16_t) (i % 3 == 2 ? length - 1 : length));
+        if (i % 7 == 3) {
+            bytes[0] = 0;
+        }
+        valid += i % 3 != 2 && i % 7 != 3;
+    }
+
+    EXPECT(parrot_message_parse_batch(bufs, lens, message_count, batch) == valid);
+    expect_same_as_parse(batch, valid);
+
+    // more messages than the capacity: the rest is ignored
+    parrot_message_batch small;
+    EXPECT(parrot_message_batch_init(&small, 10) == 0);
+    EXPECT(parrot_message_parse_batch(bufs, lens, message_count, &small) <= 10);
+    EXPECT(small.count == 10);
+    for (uint32_t i = 0; i < 10; i++) {
+        EXPECT(small.status[i] == batch->status[i] && small.serial[i] == batch->serial[i]);
+    }
+    parrot_message_batch_destroy(&small);
+}
+
+int main(void) {
+    parrot_message_batch batch;
+    if (parrot_message_batch_init(&batch, TEST_MAX_MESSAGES) != 0) {
+        return 1;
+    }
+
+    test_valid(&batch);
+    test_invalid(&batch);
+    test_mixed(&batch);
+    parrot_message_batch_destroy(&batch);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../proto/c_string.h"
+#include "../proto/parrot_payload.h"
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+static void test_repeated_keys(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+    parrot_payload_put_string(&payload, 1, "first", -1);
+    parrot_payload_put_integer(&payload, 2, -7);
+    parrot_payload_put_string(&payload, 1, "second", -1);
+    parrot_payload_put_integer(&payload, 63, 1ll << 40);
+    parrot_payload_put_integer(&payload, 1, 3);
+
+    payload_index index;
+    EXPECT(parrot_payload_index_build(&index, payload.data, (uint16_t) payload.length));
+    EXPECT(index.count == 5);
+    EXPECT(index.present == (PARROT_FIELD(1) | PARROT_FIELD(2) | PARROT_FIELD(63)));
+    EXPECT(parrot_payload_index_find(&index, 3) == NULL);
+    EXPECT(parrot_payload_index_find(&index, 64) == NULL);
+
+    // key 1 repeats, in payload order, with mixed types
+    const payload_index_entry *entry = parrot_payload_index_find(&index, 1);
+    EXPECT(entry != NULL && entry->is_string && entry->value.string.length == 5
+           && memcmp(payload.data + entry->value.string.offset, "first", 5) == 0);
+    entry = entry != NULL ? parrot_payload_index_next(&index, entry) : NULL;
+    EXPECT(entry != NULL && entry->is_string && entry->value.string.length == 6
+           && memcmp(payload.data + entry->value.string.offset, "second", 6) == 0);
+    entry = entry != NULL ? parrot_payload_index_next(&index, entry) : NULL;
+    EXPECT(entry != NULL && !entry->is_string && entry->value.integer == 3);
+    EXPECT(entry != NULL && parrot_payload_index_next(&index, entry) == NULL);
+
+    // the typed getters see the first field of a key
+    const char *data = NULL;
+    uint16_t length = 0;
+    int64_t value = 0;
+    EXPECT(parrot_payload_index_string(&index, 1, &data, &length) && length == 5 && memcmp(data, "first", 5) == 0);
+    EXPECT(!parrot_payload_index_integer(&index, 1, &value));
+    EXPECT(parrot_payload_index_integer(&index, 2, &value) && value == -7);
+    EXPECT(!parrot_payload_index_string(&index, 2, &data, &length));
+    EXPECT(parrot_payload_index_integer(&index, 63, &value) && value == 1ll << 40);
+
+    // an empty payload has no fields
+    EXPECT(parrot_payload_index_build(&index, payload.data, 0));
+    EXPECT(index.count == 0 && index.present == 0);
+    c_string_hard_clear(&payload);
+}
+
+static void test_truncated(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+    parrot_payload_put_integer(&payload, 1, 300);         // two-byte varint
+    parrot_payload_put_string(&payload, 2, "abcdef", -1);
+
+    // every strict prefix that cuts a field is malformed; the one between the fields is not
+    payload_index index;
+    for (uint16_t len = 1; len < payload.length; len++) {
+        EXPECT(parrot_payload_index_build(&index, payload.data, len) == (len == 3));
+    }
+    EXPECT(parrot_payload_index_build(&index, payload.data, (uint16_t) payload.length));
+
+    // a string over the length limit, and a meta byte of no type
+    const uint8_t too_long[] = {0x81, 0x81, 0x04};    // string of 513 bytes
+    EXPECT(!parrot_payload_index_build(&index, too_long, sizeof(too_long)));
+    const uint8_t bad_type[] = {0xC1, 0x00};
+    EXPECT(!parrot_payload_index_build(&index, bad_type, sizeof(bad_type)));
+    c_string_hard_clear(&payload);
+}
+
+static void test_entry_limit(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+    for (int i = 0; i < PAYLOAD_INDEX_MAX_ENTRIES; i++) {
+        parrot_payload_put_integer(&payload, (uint8_t) (i % 3), i);
+    }
+
+    payload_index index;
+    EXPECT(parrot_payload_index_build(&index, payload.data, (uint16_t) payload.length));
+    EXPECT(index.count == PAYLOAD_INDEX_MAX_ENTRIES);
+
+    // the chain of a key visits all its entries
+    int64_t expected = 2;
+    uint32_t chained = 0;
+    for (const payload_index_entry *entry = parrot_payload_index_find(&index, 2); entry != NULL;
+         entry = parrot_payload_index_next(&index, entry)) {
+        EXPECT(entry->value.integer == expected);
+        expected += 3;
+        ++chained;
+    }
+    EXPECT(chained == PAYLOAD_INDEX_MAX_ENTRIES / 3);
+
+    parrot_payload_put_integer(&payload, 5, 0);
+    EXPECT(!parrot_payload_index_build(&index, payload.data, (uint16_t) payload.length));
+    c_string_hard_clear(&payload);
+}
+
+int main(void) {
+    test_repeated_keys();
+    test_truncated();
+    test_entry_limit();
+    return failures == 0 ? 0 : 1;
+}
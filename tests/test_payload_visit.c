@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../proto/c_string.h"
+#include "../proto/parrot_payload.h"
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief Fields seen by a visit, in order
+ */
+typedef struct visit_log {
+    uint32_t count;
+    uint8_t keys[16];
+    int64_t integers[16];
+    char strings[16][16];
+    uint32_t stop_after;        // fields to see before is_done answers parrot_true, 0 for never
+} visit_log;
+
+static void on_integer(void *user_data, const uint8_t field_index, const int64_t value) {
+    visit_log *log = user_data;
+    log->keys[log->count] = field_index;
+    log->integers[log->count++] = value;
+}
+
+static void on_string(void *user_data, const uint8_t field_index, const char *data, const int16_t length) {
+    visit_log *log = user_data;
+    log->keys[log->count] = field_index;
+    snprintf(log->strings[log->count++], sizeof(log->strings[0]), "%.*s", (int) length, data);
+}
+
+static parrot_bool is_done(void *user_data) {
+    const visit_log *log = user_data;
+    return log->stop_after != 0 && log->count >= log->stop_after;
+}
+
+static const parrot_payload_callbacks callbacks = {on_integer, on_string, is_done};
+
+static void build(c_string *payload) {
+    memset(payload, 0, sizeof(*payload));
+    parrot_payload_put_integer(payload, 2, -7);
+    parrot_payload_put_string(payload, 1, "first", -1);
+    parrot_payload_put_integer(payload, 63, 1ll << 40);
+    parrot_payload_put_string(payload, 5, "skipped", -1);
+    parrot_payload_put_string(payload, 1, "second", -1);
+}
+
+static void test_all_fields(void) {
+    c_string payload;
+    build(&payload);
+
+    visit_log log;
+    memset(&log, 0, sizeof(log));
+    EXPECT(parrot_payload_visit(payload.data, (uint16_t) payload.length, PARROT_ALL_FIELDS, &callbacks, &log));
+    EXPECT(log.count == 5);
+    EXPECT(log.keys[0] == 2 && log.integers[0] == -7);
+    EXPECT(log.keys[1] == 1 && strcmp(log.strings[1], "first") == 0);
+    EXPECT(log.keys[2] == 63 && log.integers[2] == 1ll << 40);
+    EXPECT(log.keys[3] == 5 && strcmp(log.strings[3], "skipped") == 0);
+    EXPECT(log.keys[4] == 1 && strcmp(log.strings[4], "second") == 0);
+    c_string_hard_clear(&payload);
+}
+
+static void test_field_mask(void) {
+    c_string payload;
+    build(&payload);
+
+    // only the keys of the mask are handed over, repeats included
+    visit_log log;
+    memset(&log, 0, sizeof(log));
+    EXPECT(parrot_payload_visit(payload.data, (uint16_t) payload.length, PARROT_FIELD(1) | PARROT_FIELD(63),
+                                &callbacks, &log));
+    EXPECT(log.count == 3);
+    EXPECT(log.keys[0] == 1 && strcmp(log.strings[0], "first") == 0);
+    EXPECT(log.keys[1] == 63 && log.integers[1] == 1ll << 40);
+    EXPECT(log.keys[2] == 1 && strcmp(log.strings[2], "second") == 0);
+
+    // a NULL handler skips the fields of its type
+    const parrot_payload_callbacks integers_only = {on_integer, NULL, NULL};
+    memset(&log, 0, sizeof(log));
+    EXPECT(parrot_payload_visit(payload.data, (uint16_t) payload.length, PARROT_ALL_FIELDS, &integers_only, &log));
+    EXPECT(log.count == 2 && log.keys[0] == 2 && log.keys[1] == 63);
+
+    // fields outside the mask are still checked
+    memset(&log, 0, sizeof(log));
+    EXPECT(!parrot_payload_visit(payload.data, (uint16_t) payload.length - 1, PARROT_FIELD(2), &callbacks, &log));
+    EXPECT(log.count == 1);
+    c_string_hard_clear(&payload);
+}
+
+static void test_early_stop(void) {
+    c_string payload;
+    build(&payload);
+
+    // the visit ends at the first wanted field, before the malformed tail is reached
+    visit_log log;
+    memset(&log, 0, sizeof(log));
+    log.stop_after = 1;
+    EXPECT(parrot_payload_visit(payload.data, (uint16_t) payload.length - 1, PARROT_FIELD(1), &callbacks, &log));
+    EXPECT(log.count == 1 && log.keys[0] == 1 && strcmp(log.strings[0], "first") == 0);
+
+    memset(&log, 0, sizeof(log));
+    log.stop_after = 3;
+    EXPECT(parrot_payload_visit(payload.data, (uint16_t) payload.length, PARROT_ALL_FIELDS, &callbacks, &log));
+    EXPECT(log.count == 3 && log.keys[2] == 63);
+
+    // a malformed field before the stop fails the visit
+    const uint8_t bad_type[] = {0x02, 0x05, 0xC1, 0x00};
+    memset(&log, 0, sizeof(log));
+    log.stop_after = 2;
+    EXPECT(!parrot_payload_visit(bad_type, sizeof(bad_type), PARROT_ALL_FIELDS, &callbacks, &log));
+    EXPECT(log.count == 1);
+    c_string_hard_clear(&payload);
+}
+
+int main(void) {
+    test_all_fields();
+    test_field_mask();
+    test_early_stop();
+    return failures == 0 ? 0 : 1;
+}
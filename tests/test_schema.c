@@ -0,0 +1,200 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../proto/c_string.h"
+#include "../proto/parrot_schema.h"
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+static parrot_schema_result decode(const parrot_schema *schema, const c_string *payload, void *target,
+                                   uint64_t *present) {
+    return parrot_schema_decode(schema, payload->data, (uint16_t) payload->length, target, present);
+}
+
+static int string_is(const parrot_string_ref *ref, const char *text) {
+    return ref->length == (int16_t) strlen(text) && memcmp(ref->data, text, (size_t) ref->length) == 0;
+}
+
+static void test_required(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+
+    // both required fields, in either order, and unknown keys skipped
+    parrot_status_notify status;
+    uint64_t present = 0;
+    parrot_payload_put_string(&payload, 2, "online", -1);
+    parrot_payload_put_integer(&payload, 9, 12345);
+    parrot_payload_put_integer(&payload, 1, -2);
+    EXPECT(decode(&parrot_schema_status_notify, &payload, &status, &present) == kSchemaOk);
+    EXPECT(status.status == -2 && string_is(&status.message, "online"));
+    EXPECT(present == (PARROT_FIELD(1) | PARROT_FIELD(2)));
+
+    // either one missing
+    c_string_soft_clear(&payload);
+    parrot_payload_put_integer(&payload, 1, 1);
+    EXPECT(decode(&parrot_schema_status_notify, &payload, &status, &present) == kSchemaMissing);
+    c_string_soft_clear(&payload);
+    parrot_payload_put_string(&payload, 2, "message only", -1);
+    EXPECT(decode(&parrot_schema_status_notify, &payload, &status, &present) == kSchemaMissing);
+
+    // optional fields keep the caller's defaults when absent
+    parrot_register_res res = {7, {"default", 7}};
+    c_string_soft_clear(&payload);
+    EXPECT(decode(&parrot_schema_register_res, &payload, &res, &present) == kSchemaOk);
+    EXPECT(res.result == 7 && string_is(&res.message, "default") && present == 0);
+    parrot_payload_put_integer(&payload, 1, 0);
+    EXPECT(decode(&parrot_schema_register_res, &payload, &res, &present) == kSchemaOk);
+    EXPECT(res.result == 0 && string_is(&res.message, "default") && present == PARROT_FIELD(1));
+
+    // commands without fields take any well-formed payload
+    EXPECT(decode(&parrot_schema_keep_alive_res, &payload, NULL, &present) == kSchemaOk && present == 0);
+    c_string_hard_clear(&payload);
+}
+
+static void test_repeated_keys(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+
+    // a key that doesn't repeat may appear once only
+    parrot_volume volume;
+    parrot_payload_put_integer(&payload, 1, 1);
+    parrot_payload_put_integer(&payload, 2, 80);
+    parrot_payload_put_integer(&payload, 2, 90);
+    EXPECT(decode(&parrot_schema_volume_notify, &payload, &volume, NULL) == kSchemaDuplicate);
+
+    // frames repeat, in payload order, with other keys in between
+    parrot_audio_notify audio;
+    audio.sent_at_us = -1;
+    c_string_soft_clear(&payload);
+    parrot_payload_put_string(&payload, 1, "frame one", -1);
+    parrot_payload_put_integer(&payload, PARROT_AUDIO_SENT_AT_KEY, 1000);
+    parrot_payload_put_string(&payload, 1, "frame two", -1);
+    parrot_payload_put_string(&payload, 1, "frame three", -1);
+    uint64_t present = 0;
+    EXPECT(decode(&parrot_schema_audio_notify, &payload, &audio, &present) == kSchemaOk);
+    EXPECT(audio.frame_count == 3 && audio.sent_at_us == 1000);
+    EXPECT(string_is(&audio.frames[0], "frame one") && string_is(&audio.frames[1], "frame two")
+           && string_is(&audio.frames[2], "frame three"));
+    EXPECT(present == (PARROT_FIELD(1) | PARROT_FIELD(PARROT_AUDIO_SENT_AT_KEY)));
+
+    // the count restarts with each decode, and no frame is missing
+    c_string_soft_clear(&payload);
+    parrot_payload_put_string(&payload, 1, "again", -1);
+    EXPECT(decode(&parrot_schema_audio_notify, &payload, &audio, NULL) == kSchemaOk && audio.frame_count == 1);
+    c_string_soft_clear(&payload);
+    parrot_payload_put_integer(&payload, PARROT_AUDIO_SENT_AT_KEY, 1);
+    EXPECT(decode(&parrot_schema_audio_notify, &payload, &audio, NULL) == kSchemaMissing);
+    EXPECT(audio.frame_count == 0);
+    c_string_hard_clear(&payload);
+}
+
+static void test_frame_count(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+
+    // PARROT_AUDIO_MAX_FRAMES frames fit, one more doesn't
+    parrot_audio_notify audio;
+    for (int i = 0; i < PARROT_AUDIO_MAX_FRAMES; i++) {
+        parrot_payload_put_string(&payload, 1, "f", -1);
+    }
+    EXPECT(decode(&parrot_schema_audio_notify, &payload, &audio, NULL) == kSchemaOk);
+    EXPECT(audio.frame_count == PARROT_AUDIO_MAX_FRAMES);
+    parrot_payload_put_string(&payload, 1, "f", -1);
+    EXPECT(decode(&parrot_schema_audio_notify, &payload, &audio, NULL) == kSchemaTooMany);
+    EXPECT(audio.frame_count == PARROT_AUDIO_MAX_FRAMES);
+
+    // the encoder refuses more than the array holds
+    c_string_soft_clear(&payload);
+    audio.frame_count = PARROT_AUDIO_MAX_FRAMES + 1;
+    EXPECT(parrot_schema_encode(&parrot_schema_audio_notify, &audio, PARROT_FIELD(1), &payload) == kSchemaTooMany);
+    c_string_hard_clear(&payload);
+}
+
+static void test_wrong_type(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+
+    // an integer where a string goes, and the reverse
+    parrot_status_notify status;
+    parrot_payload_put_integer(&payload, 1, 1);
+    parrot_payload_put_integer(&payload, 2, 2);
+    EXPECT(decode(&parrot_schema_status_notify, &payload, &status, NULL) == kSchemaWrongType);
+    c_string_soft_clear(&payload);
+    parrot_payload_put_string(&payload, 1, "1", -1);
+    parrot_payload_put_string(&payload, 2, "online", -1);
+    EXPECT(decode(&parrot_schema_status_notify, &payload, &status, NULL) == kSchemaWrongType);
+
+    // a repeated string field given an integer
+    parrot_audio_notify audio;
+    c_string_soft_clear(&payload);
+    parrot_payload_put_integer(&payload, 1, 5);
+    EXPECT(decode(&parrot_schema_audio_notify, &payload, &audio, NULL) == kSchemaWrongType);
+
+    // an unknown key may have any type
+    c_string_soft_clear(&payload);
+    parrot_payload_put_string(&payload, 5, "extension", -1);
+    parrot_payload_put_integer(&payload, 1, 1);
+    parrot_payload_put_integer(&payload, 2, 50);
+    parrot_volume volume;
+    EXPECT(decode(&parrot_schema_volume_notify, &payload, &volume, NULL) == kSchemaOk);
+    EXPECT(volume.audio_dev_id == 1 && volume.volume == 50);
+    c_string_hard_clear(&payload);
+}
+
+static void test_malformed(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+    parrot_payload_put_integer(&payload, 1, 1);
+    parrot_payload_put_string(&payload, 2, "online", -1);
+
+    // a truncated field fails even when the required fields came before it
+    parrot_status_notify status;
+    for (uint16_t len = 1; len < payload.length; len++) {
+        const parrot_schema_result result = parrot_schema_decode(&parrot_schema_status_notify, payload.data, len,
+                                                                 &status, NULL);
+        EXPECT(result == (len == 2 ? kSchemaMissing : kSchemaMalformed));
+    }
+
+    const uint8_t bad_type[] = {0x01, 0x01, 0xC2, 0x00};
+    EXPECT(parrot_schema_decode(&parrot_schema_status_notify, bad_type, sizeof(bad_type), &status, NULL)
+           == kSchemaMalformed);
+    c_string_hard_clear(&payload);
+}
+
+static void test_round_trip(void) {
+    c_string payload;
+    memset(&payload, 0, sizeof(payload));
+
+    const parrot_register_req req = {{"192.168.124.130", -1}, {"1.2.3", -1}, -40};
+    EXPECT(parrot_schema_encode(&parrot_schema_register_req, &req, PARROT_FIELD(1) | PARROT_FIELD(2) | PARROT_FIELD(3),
+                                &payload) == kSchemaOk);
+    parrot_register_req decoded;
+    uint64_t present = 0;
+    EXPECT(decode(&parrot_schema_register_req, &payload, &decoded, &present) == kSchemaOk);
+    EXPECT(string_is(&decoded.client_ip, "192.168.124.130") && string_is(&decoded.client_version, "1.2.3"));
+    EXPECT(decoded.ao_volume == -40 && present == (PARROT_FIELD(1) | PARROT_FIELD(2) | PARROT_FIELD(3)));
+
+    // a required field left out of present isn't encoded
+    const parrot_volume volume = {1, 50};
+    EXPECT(parrot_schema_encode(&parrot_schema_volume_report, &volume, PARROT_FIELD(2), &payload) == kSchemaMissing);
+    c_string_hard_clear(&payload);
+}
+
+int main(void) {
+    test_required();
+    test_repeated_keys();
+    test_frame_count();
+    test_wrong_type();
+    test_malformed();
+    test_round_trip();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../proto/parrot_builder.h"
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                           \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+#define TEST_MESSAGE_SIZE 128
+
+/**
+ * @brief Layout of a templated request, as the client builds them
+ */
+typedef struct template_case {
+    const char *name;
+    uint32_t device;
+    uint16_t command;
+    const char *string;         // #1 of the payload, NULL for none
+    parrot_bool checksum;
+} template_case;
+
+static const template_case cases[] = {
+        {"keep-alive", 0x00C0FFEE, 0x03, NULL, parrot_true},
+        {"register", 0x00C0FFEE, 0x01, "192.168.124.130", parrot_true},
+        {"no checksum", 0x00C0FFEE, 0x01, "192.168.124.130", parrot_false},
+        {"no device", 0, 0x7F, NULL, parrot_true},
+        {"long command", 0x01000001, 0x1234, "x", parrot_true},
+};
+
+static void put_payload(parrot_builder *b, const template_case *c) {
+    if (c->string != NULL) {
+        parrot_builder_put_string(b, 1, c->string, -1);
+        parrot_builder_put_integer(b, 2, -300);
+    }
+}
+
+/**
+ * @brief Serialize the message with a fresh builder
+ */
+static uint16_t build(uint8_t *buf, const template_case *c, const uint16_t serial) {
+    parrot_builder b;
+    parrot_builder_begin(&b, buf, TEST_MESSAGE_SIZE, c->device, c->command, serial);
+    put_payload(&b, c);
+    return parrot_builder_finish(&b, c->checksum);
+}
+
+static void expect_emit(parrot_template *t, const template_case *c, const uint16_t serial) {
+    uint8_t expected[TEST_MESSAGE_SIZE];
+    uint8_t actual[TEST_MESSAGE_SIZE];
+    const uint16_t expected_length = build(expected, c, serial);
+    const uint16_t length = parrot_template_emit(t, actual, sizeof(actual), serial);
+    if (length == 0 || length != expected_length || memcmp(actual, expected, length) != 0) {
+        fprintf(stderr, "%s: serial %u: emitted %u bytes, built %u\n", c->name, serial, length, expected_length);
+        ++failures;
+    }
+}
+
+static void test_serials(const template_case *c) {
+    parrot_template t;
+    parrot_builder b;
+    parrot_template_begin(&t, &b, c->device, c->command);
+    put_payload(&b, c);
+    EXPECT(parrot_template_finish(&t, &b, c->checksum));
+
+    // across the one-byte / two-byte serial boundary both ways, and back to the placeholder's length
+    const uint16_t serials[] = {127, 128, 0x7FFF, 127, 1, 0x7FFF, 128, 129, 2, 127};
+    for (uint32_t i = 0; i < sizeof(serials) / sizeof(serials[0]); i++) {
+        expect_emit(&t, c, serials[i]);
+    }
+
+    // serials outside 1 - 0x7FFF aren't encodable: nothing is emitted, and the template is left intact
+    uint8_t buf[TEST_MESSAGE_SIZE];
+    EXPECT(parrot_template_emit(&t, buf, sizeof(buf), 0) == 0);
+    EXPECT(parrot_template_emit(&t, buf, sizeof(buf), 0xFFFF) == 0);
+    EXPECT(parrot_template_emit(&t, buf, sizeof(buf), 0x8000) == 0);
+    expect_emit(&t, c, 128);
+    expect_emit(&t, c, 5);
+
+    // a buffer one byte short gets nothing
+    const uint16_t length = build(buf, c, 0x7FFF);
+    EXPECT(parrot_template_emit(&t, buf, (uint16_t) (length - 1), 0x7FFF) == 0);
+    expect_emit(&t, c, 0x7FFF);
+}
+
+int main(void) {
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        test_serials(&cases[i]);
+    }
+
+    // every serial, checksum on
+    parrot_template t;
+    parrot_builder b;
+    parrot_template_begin(&t, &b, cases[1].device, cases[1].command);
+    put_payload(&b, &cases[1]);
+    EXPECT(parrot_template_finish(&t, &b, parrot_true));
+    for (uint32_t serial = 1; serial <= 0x7FFF; serial++) {
+        expect_emit(&t, &cases[1], (uint16_t) serial);
+    }
+
+    // an unbuilt template emits nothing
+    memset(&t, 0, sizeof(t));
+    uint8_t buf[TEST_MESSAGE_SIZE];
+    EXPECT(parrot_template_emit(&t, buf, sizeof(buf), 1) == 0);
+    return failures == 0 ? 0 : 1;
+}